@@ -27,6 +27,8 @@
 
 #define CONTROL_REGISTER0_PROTECTED_MODE_ENABLED (1 << 0)
 #define CONTROL_REGISTER0_EXTENSION_TYPE (1 << 4)
+#define CONTROL_REGISTER0_WRITE_PROTECT \
+  (1 << 16)  // Supervisor can't write to read only pages (for copy on write).
 #define CONTROL_REGISTER0_PAGE (1 << 31)
 
 #define KERNEL_CR0                                                     \
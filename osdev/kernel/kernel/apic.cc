@@ -23,6 +23,9 @@ constexpr uint32_t kEndOfInterruptOffset = 0xB0;
 constexpr uint32_t kICRHighOffset = 0x310;
 constexpr uint32_t kICRLowOffset = 0x300;
 
+constexpr uint32_t kICRDeliveryPending = (1 << 12);
+constexpr uint32_t kICRLevelAssert = (1 << 14);
+
 constexpr uint32_t kIOAPICInterruptMask = (1 << 16);
 
 }  // namespace
@@ -169,10 +172,40 @@ CPUContext* APICManager::CreateCPUSpecificInfo(uint32_t cpu_id) {
   cpu_context->cpu_id = cpu_id;
   cpu_context->self = reinterpret_cast<uint64_t>(cpu_context);
   cpu_context->ap_boot_done = false;
+  cpu_context->simd_ready = false;
+  cpu_context->simd_in_use = false;
 
   return cpu_context;
 }
 
+void APICManager::SendIPI(uint32_t cpu_id, uint8_t vector) {
+  // ICR high and low must be written together; do not let the interrupt
+  // handler on this core send another IPI in between.
+  bool interrupt_enabled = CPURegsAccessProvider::IsInterruptEnabled();
+  CPURegsAccessProvider::DisableInterrupt();
+
+  // Wait until the previous IPI is accepted.
+  while (ReadRegister(kICRLowOffset) & kICRDeliveryPending) {
+    asm volatile("pause");
+  }
+
+  // Fixed delivery to the physical APIC id (which is same as cpu id).
+  SetRegister(kICRHighOffset, cpu_id << 24);
+  SetRegister(kICRLowOffset, kICRLevelAssert | vector);
+
+  if (interrupt_enabled) {
+    CPURegsAccessProvider::EnableInterrupt();
+  }
+}
+
+void APICManager::SendRescheduleIPI(uint32_t cpu_id) {
+  SendIPI(cpu_id, kRescheduleIPIVector);
+}
+
+void APICManager::SendTLBShootdownIPI(uint32_t cpu_id) {
+  SendIPI(cpu_id, kTLBShootdownIPIVector);
+}
+
 void APICManager::SetEndOfInterrupt() { SetRegister(kEndOfInterruptOffset, 0); }
 
 void APICManager::InitIOAPIC() {
@@ -6,6 +6,10 @@
 
 namespace Kernel {
 
+// Vectors of the inter processor interrupts.
+constexpr uint8_t kRescheduleIPIVector = 0x31;
+constexpr uint8_t kTLBShootdownIPIVector = 0x32;
+
 class APICManager {
  public:
   static APICManager& GetAPICManager() {
@@ -35,9 +39,18 @@ class APICManager {
   // Redirect #irq to cpu_id.
   void RedirectIRQs(uint8_t irq, uint8_t cpu_id);
 
+  // Make cpu_id run the scheduler right away (e.g to run the thread that is
+  // just woken up).
+  void SendRescheduleIPI(uint32_t cpu_id);
+
+  // Make cpu_id flush its TLB.
+  void SendTLBShootdownIPI(uint32_t cpu_id);
+
  private:
   APICManager() = default;
 
+  void SendIPI(uint32_t cpu_id, uint8_t vector);
+
   uint64_t* apic_reg_addr_;
 
   // Kernel mapped ioapic base address.
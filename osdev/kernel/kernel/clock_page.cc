@@ -0,0 +1,54 @@
+#include "clock_page.h"
+
+#include "cpu.h"
+#include "frame_allocator.h"
+#include "paging.h"
+#include "zeroed_frame_pool.h"
+
+namespace Kernel {
+
+void ClockPage::Init() {
+  frame_ = ZeroedFramePool::GetZeroedFramePool().AllocateZeroedFrame();
+  data_ = static_cast<ClockPageData*>(
+      PageTableManager::GetPageTableManager().MapFrameToKernel(frame_));
+}
+
+void ClockPage::MapToProcess(uint64_t* user_pml4e_base_phys_addr) {
+  ASSERT(frame_ != nullptr);
+
+  // The page table takes its own reference.
+  UserFrameAllocator::GetPhysicalFrameAllocator().ShareFrame(frame_);
+  PageTableManager::GetPageTableManager().MapPage(
+      user_pml4e_base_phys_addr, kUserClockPageAddress, frame_,
+      /*writable=*/false);
+}
+
+void ClockPage::UpdateTick(uint64_t timer_tick) {
+  if (data_ == nullptr) {
+    return;
+  }
+
+  data_->sequence++;
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  data_->timer_tick = timer_tick;
+  data_->tsc_at_tick = CPURegsAccessProvider::ReadTimeStampCounter();
+
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  data_->sequence++;
+}
+
+void ClockPage::SetCalibration(uint64_t num_10nanosec_per_tick,
+                               uint64_t tsc_per_tick) {
+  if (data_ == nullptr) {
+    return;
+  }
+
+  data_->tsc_per_tick = tsc_per_tick;
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  // Readers check this one first.
+  data_->num_10nanosec_per_tick = num_10nanosec_per_tick;
+}
+
+}  // namespace Kernel
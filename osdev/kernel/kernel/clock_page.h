@@ -0,0 +1,60 @@
+#ifndef CLOCK_PAGE_H
+#define CLOCK_PAGE_H
+
+#include "../std/types.h"
+
+namespace Kernel {
+
+// Layout of the clock page. user/libc/syscall.h has the same struct.
+//
+// The writer makes sequence odd while updating the fields, so the reader
+// should retry if it sees an odd sequence or the sequence has changed while
+// reading.
+struct ClockPageData {
+  volatile uint64_t sequence;
+
+  // Timer tick of CPU 0 and the TSC when the tick happened.
+  volatile uint64_t timer_tick;
+  volatile uint64_t tsc_at_tick;
+
+  // Set once the timer is calibrated (0 before).
+  volatile uint64_t num_10nanosec_per_tick;
+  volatile uint64_t tsc_per_tick;
+};
+
+// Page that exposes the timer to the user processes. It is mapped read only to
+// every process at kUserClockPageAddress, so the process can read the time
+// without the syscall.
+class ClockPage {
+ public:
+  // Right below the stack area (See Process).
+  static constexpr uint64_t kUserClockPageAddress = 0x3F7FF000;
+
+  static ClockPage& GetClockPage() {
+    static ClockPage clock_page;
+    return clock_page;
+  }
+
+  void Init();
+
+  // Map the page to the page table of the new process.
+  void MapToProcess(uint64_t* user_pml4e_base_phys_addr);
+
+  // Called on every tick of CPU 0's timer (in the interrupt handler).
+  void UpdateTick(uint64_t timer_tick);
+
+  void SetCalibration(uint64_t num_10nanosec_per_tick, uint64_t tsc_per_tick);
+
+ private:
+  ClockPage() = default;
+
+  // The kernel holds a reference of the frame forever.
+  void* frame_ = nullptr;
+
+  // frame_ mapped to the kernel VM.
+  ClockPageData* data_ = nullptr;
+};
+
+}  // namespace Kernel
+
+#endif
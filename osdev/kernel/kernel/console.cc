@@ -1,11 +1,14 @@
 #include "console.h"
 
+#include "../std/algorithm.h"
 #include "../std/string_view.h"
 #include "./fs/ext2.h"
 #include "graphic.h"
 #include "process.h"
 #include "scheduler.h"
+#include "syscall.h"
 #include "string.h"
+#include "timer.h"
 #include "utf8.h"
 #include "vga_output.h"
 
@@ -61,7 +64,10 @@ KernelConsole::KernelConsole()
   term_output_buffer_ =
       reinterpret_cast<char*>(kmalloc(kTerminalOutputBufferSize));
   term_output_read_index_ = 0;
-  term_output_write_index_ = 0;
+  term_output_committed_index_ = 0;
+  term_output_reserved_index_ = 0;
+  term_output_flush_requested_ = false;
+  term_output_last_print_ms_ = 0;
   term_output_buffer_to_print_ =
       reinterpret_cast<char*>(kmalloc(kTerminalOutputBufferSize + 1));
 
@@ -138,6 +144,14 @@ void KernelConsole::Run() {
   QemuSerialLog::Logf("STart Kernel console!");
 
   while (true) {
+    // Make sure that the output of the process that just finished is printed
+    // before the prompt.
+    if (should_show_shell_prefix_ && HasPendingTermOutput()) {
+      FlushTerminal();
+      KernelThreadScheduler::GetKernelThreadScheduler().Yield();
+      continue;
+    }
+
     if (should_show_shell_prefix_) {
       char prefix[1024];
       sprintf(prefix, "root:%s# ", working_dir_.c_str());
@@ -275,10 +289,24 @@ void KernelConsole::DoParse() {
               process->CpuId(), process->GetStatusName(), name.c_str());
     }
     return;
+  } else if (input[0] == "syncbench") {
+    GraphicManager::GetGraphicManager().BenchmarkSync();
+    return;
+  } else if (input[0] == "fontbench") {
+    GraphicManager::GetGraphicManager().BenchmarkGlyphs();
+    return;
+  } else if (input[0] == "sysstat") {
+    // "sysstat reset" clears the statistics.
+    if (input.size() > 1 && input[1] == "reset") {
+      SyscallManager::GetSyscallManager().ResetStats();
+    } else {
+      SyscallManager::GetSyscallManager().PrintStats();
+    }
+    return;
   }
 
-  std::vector<KernelString> argv;
-  for (auto s : input) {
+  ProcessArgv argv;
+  for (const auto& s : input) {
     argv.push_back(s);
   }
 
@@ -336,46 +364,83 @@ void KernelConsole::SendInputBufferToFgProcess(int index) {
 }
 
 void KernelConsole::PrintToTerminal(char* data, int sz) {
-  for (int i = 0; i < sz; i++) {
-    size_t write_index =
-        __atomic_fetch_add(&term_output_write_index_, 1, __ATOMIC_RELAXED);
-    term_output_buffer_[write_index % kTerminalOutputBufferSize] = data[i];
+  // Write in chunks so that a large write does not need the whole ring.
+  constexpr int kMaxChunkSize = 4096;
+  bool has_newline = false;
+
+  while (sz > 0) {
+    int chunk = min(sz, kMaxChunkSize);
+
+    size_t start = __atomic_fetch_add(&term_output_reserved_index_, chunk,
+                                      __ATOMIC_RELAXED);
+    size_t end = start + chunk;
+
+    // Wait until the print thread makes the room.
+    while (end - __atomic_load_n(&term_output_read_index_, __ATOMIC_ACQUIRE) >
+           kTerminalOutputBufferSize) {
+      FlushTerminal();
+      KernelThreadScheduler::GetKernelThreadScheduler().Yield();
+    }
+
+    size_t offset = start % kTerminalOutputBufferSize;
+    size_t first = min(static_cast<size_t>(chunk),
+                       kTerminalOutputBufferSize - offset);
+    memcpy(term_output_buffer_ + offset, data, first);
+    memcpy(term_output_buffer_, data + first, chunk - first);
+
+    for (int i = 0; i < chunk && !has_newline; i++) {
+      has_newline = (data[i] == '\n');
+    }
+
+    // Publish in the order of the reservation; the earlier writer may not
+    // have finished copying yet.
+    while (__atomic_load_n(&term_output_committed_index_, __ATOMIC_ACQUIRE) !=
+           start) {
+      KernelThreadScheduler::GetKernelThreadScheduler().Yield();
+    }
+    __atomic_store_n(&term_output_committed_index_, end, __ATOMIC_RELEASE);
+
+    data += chunk;
+    sz -= chunk;
+  }
+
+  if (has_newline) {
+    FlushTerminal();
   }
 }
 
 void KernelConsole::PrintTermOutputBuffer() {
+  auto& timer = TimerManager::GetCurrentTimer();
   while (true) {
-    size_t write_index = term_output_write_index_ % kTerminalOutputBufferSize;
-    if (write_index == term_output_read_index_) {
+    size_t committed =
+        __atomic_load_n(&term_output_committed_index_, __ATOMIC_ACQUIRE);
+    if (committed == term_output_read_index_) {
       KernelThreadScheduler::GetKernelThreadScheduler().Yield();
       continue;
     }
 
-    int num_to_read = 0;
-    if (write_index > term_output_read_index_) {
-      num_to_read = write_index - term_output_read_index_;
-    } else {
-      num_to_read =
-          term_output_read_index_ - write_index + kTerminalOutputBufferSize;
+    // Coalesce the writes until the next refresh unless someone is waiting
+    // for it.
+    uint64_t now = timer.GetMsTick();
+    if (!__atomic_exchange_n(&term_output_flush_requested_, false,
+                             __ATOMIC_ACQ_REL) &&
+        now - term_output_last_print_ms_ < kTermRefreshIntervalMs) {
+      KernelThreadScheduler::GetKernelThreadScheduler().Yield();
+      continue;
     }
 
-    for (int i = 0; i < num_to_read; i++) {
-      if (i + term_output_read_index_ < kTerminalOutputBufferSize) {
-        term_output_buffer_to_print_[i] =
-            term_output_buffer_[i + term_output_read_index_];
-      } else {
-        term_output_buffer_to_print_[i] =
-            term_output_buffer_[i + term_output_read_index_ -
-                                kTerminalOutputBufferSize];
-      }
-    }
+    size_t num_to_read = committed - term_output_read_index_;
+    size_t offset = term_output_read_index_ % kTerminalOutputBufferSize;
+    size_t first = min(num_to_read, kTerminalOutputBufferSize - offset);
+    memcpy(term_output_buffer_to_print_, term_output_buffer_ + offset, first);
+    memcpy(term_output_buffer_to_print_ + first, term_output_buffer_,
+           num_to_read - first);
+
     // Add NULL terminator.
     term_output_buffer_to_print_[num_to_read] = 0;
 
-    term_output_read_index_ += num_to_read;
-    if (term_output_read_index_ >= kTerminalOutputBufferSize) {
-      term_output_read_index_ -= kTerminalOutputBufferSize;
-    }
+    __atomic_store_n(&term_output_read_index_, committed, __ATOMIC_RELEASE);
+    term_output_last_print_ms_ = now;
 
     /*
     VGAOutput::GetVGAOutput().PrintLock();
@@ -386,11 +451,12 @@ void KernelConsole::PrintTermOutputBuffer() {
     VGAOutput::GetVGAOutput().PrintUnlock();
     */
 
+    // Whole batch is drawn under a single lock, and the screen is marked dirty
+    // per line rather than per character.
     auto& gm = GraphicManager::GetGraphicManager();
     gm.PrintLock();
-    for (int i = 0; i < num_to_read; i++) {
-      gm.PutChar(term_output_buffer_to_print_[i]);
-    }
+    gm.PrintString(
+        std::string_view(term_output_buffer_to_print_, num_to_read));
     gm.PrintUnlock();
   }
 }
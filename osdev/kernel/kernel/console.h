@@ -45,9 +45,22 @@ class KernelConsole {
   // function.
   int ReadKeyStroke(std::vector<KeyStroke>* strokes);
 
+  // Append the data to the terminal output ring. It is printed by the print
+  // thread later (at most kTermRefreshIntervalMs later, or right away if the
+  // data has a newline).
   void PrintToTerminal(char* data, int sz);
   void PrintTermOutputBuffer();
 
+  // Ask the print thread to print everything in the ring now (e.g the process
+  // is about to block on read).
+  void FlushTerminal() {
+    __atomic_store_n(&term_output_flush_requested_, true, __ATOMIC_RELEASE);
+  }
+  bool HasPendingTermOutput() const {
+    return __atomic_load_n(&term_output_committed_index_, __ATOMIC_ACQUIRE) !=
+           term_output_read_index_;
+  }
+
   void ShowWelcome();
 
   Process* GetForegroundProcess() { return fg_process_; }
@@ -70,6 +83,10 @@ class KernelConsole {
   // 1 MB of the terminal output buffer.
   static constexpr int kTerminalOutputBufferSize = 1048576 - 1;
 
+  // The output is printed in batches at most this often (~60 fps) unless the
+  // flush is requested.
+  static constexpr uint64_t kTermRefreshIntervalMs = 16;
+
   KernelConsole();
 
   void FillInputBufferAndParse(int num_received);
@@ -99,10 +116,16 @@ class KernelConsole {
   bool should_show_shell_prefix_;
 
   // Anything that the process prints with "write" syscall to the stdout will be
-  // written here.
+  // written here. Indexes grow without wrapping around; [read, committed) is
+  // ready to be printed and [committed, reserved) is still being written.
   char* term_output_buffer_;
   size_t term_output_read_index_;
-  size_t term_output_write_index_;
+  size_t term_output_committed_index_;
+  size_t term_output_reserved_index_;
+
+  // Print without waiting for the next refresh.
+  bool term_output_flush_requested_;
+  uint64_t term_output_last_print_ms_;
 
   char* term_output_buffer_to_print_;
 
@@ -110,6 +110,21 @@ struct CPURegsAccessProvider {
     return cr2;
   }
 
+  static inline uint64_t ReadTimeStampCounter() {
+    uint32_t lo, hi;
+    asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return (static_cast<uint64_t>(hi) << 32) | lo;
+  }
+
+  static inline uint64_t ReadCR3() {
+    uint64_t cr3;
+    asm volatile(
+        "mov %%cr3, %%rax\n"
+        "mov %%rax, %0"
+        : "=m"(cr3)::"%rax");
+    return cr3;
+  }
+
   static inline void SetCR3(uint64_t cr3) {
     asm volatile(
         "movq %0, %%rax\n"
@@ -3,12 +3,17 @@
 
 #include "../std/types.h"
 #include "cpu.h"
+#include "kernel_util.h"
 #include "kmalloc.h"
 
 namespace Kernel {
 
 constexpr int kGSBaseMSR = 0xC0000101;
 
+// Max number of CPUs that CPUContextManager can keep track of. CPU ids are
+// used as a bit of the 64 bit mask (See TLBShootdownManager).
+constexpr uint32_t kMaxNumCPU = 64;
+
 // This is a per-cpu specific information (e.g stack address start location)
 // with some general info (e.g page table location).
 struct CPUContext {
@@ -23,11 +28,28 @@ struct CPUContext {
   // of the CPUContext. Hence, we need to copy teh addresss of 'self' to gs.
   uint64_t self;
   volatile bool ap_boot_done;
+
+  // Set once SSE is enabled on this CPU (See KernelSimdGuard).
+  bool simd_ready;
+  bool simd_in_use;
+
+  // Where the XMM registers are saved while the kernel is using them.
+  void* simd_save_region;
+
+  // Physical address of the page table that is in CR3 of this CPU. Kernel
+  // threads do not change CR3, so this is the page table of the user process
+  // that has run last on this CPU; its entries can still be in the TLB.
+  volatile uint64_t loaded_page_table;
 } __attribute__((packed));
 
 class CPUContextManager {
  public:
+  // Must be called on the CPU that owns cpu_context.
   void SetCPUContext(CPUContext* cpu_context) {
+    ASSERT(cpu_context->cpu_id < kMaxNumCPU);
+    cpu_context->loaded_page_table = CPURegsAccessProvider::ReadCR3();
+    cpu_contexts_[cpu_context->cpu_id] = cpu_context;
+
     uint64_t self_addr = reinterpret_cast<uint64_t>(&cpu_context->self);
     CPURegsAccessProvider::SetMSR(kGSBaseMSR, self_addr, self_addr >> 32);
   }
@@ -41,6 +63,8 @@ class CPUContextManager {
         reinterpret_cast<CPUContext*>(kmalloc(sizeof(CPUContext)));
     cpu_context->cpu_id = cpu_id;
     cpu_context->self = reinterpret_cast<uint64_t>(cpu_context);
+    cpu_context->simd_ready = false;
+    cpu_context->simd_in_use = false;
     SetCPUContext(cpu_context);
   }
 
@@ -50,6 +74,9 @@ class CPUContextManager {
     return cpu_context;
   }
 
+  // Returns nullptr if the CPU is not started yet.
+  CPUContext* GetCPUContext(uint32_t cpu_id) { return cpu_contexts_[cpu_id]; }
+
   static CPUContextManager& GetCPUContextManager() {
     static CPUContextManager m;
     return m;
@@ -57,6 +84,8 @@ class CPUContextManager {
 
  private:
   CPUContextManager() = default;
+
+  CPUContext* cpu_contexts_[kMaxNumCPU] = {};
 };
 
 }  // namespace Kernel
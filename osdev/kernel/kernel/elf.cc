@@ -17,12 +17,30 @@ ELFReader::ELFReader(const uint8_t* data, size_t file_size) {
   ASSERT(file_size >= 0x40);
 
   header_ = *reinterpret_cast<const ELFHeader*>(data);
+  if (!CheckHeader()) {
+    return;
+  }
+
+  ParseHeaderTables(data + header_.e_phoff, data + header_.e_shoff);
+}
 
+ELFReader::ELFReader(const ELFHeader& header,
+                     const uint8_t* program_header_table,
+                     const uint8_t* section_header_table)
+    : header_(header) {
+  if (!CheckHeader()) {
+    return;
+  }
+
+  ParseHeaderTables(program_header_table, section_header_table);
+}
+
+bool ELFReader::CheckHeader() {
   // First check the magic.
   if (header_.e_ident_magic != kELFMagic) {
     error_ = "ELF Magic does not match.";
     is_valid_ = false;
-    return;
+    return false;
   } else {
     is_valid_ = true;
   }
@@ -30,27 +48,31 @@ ELFReader::ELFReader(const uint8_t* data, size_t file_size) {
   if (header_.e_ident_class != kELFClass64Bit) {
     error_ = "Not a 64bit ELF file.";
     is_valid_ = false;
-    return;
+    return false;
   }
 
   if (header_.e_ident_data != kELFLittleEndian) {
     error_ = "Not a Little endian encoded file.";
     is_valid_ = false;
-    return;
+    return false;
   }
 
+  return true;
+}
+
+void ELFReader::ParseHeaderTables(const uint8_t* program_header_table,
+                                  const uint8_t* section_header_table) {
   program_headers_.reserve(header_.e_phnum);
   for (int ph_off = 0; ph_off < header_.e_phnum; ph_off++) {
     program_headers_.push_back(*reinterpret_cast<const ELFProgramHeader*>(
-        data + header_.e_phoff + ph_off * sizeof(ELFProgramHeader)));
+        program_header_table + ph_off * sizeof(ELFProgramHeader)));
   }
 
   section_headers_.reserve(header_.e_shnum);
   for (int sh_off = 0; sh_off < header_.e_shnum; sh_off++) {
     section_headers_.push_back(*reinterpret_cast<const ELFSectionHeader*>(
-        data + header_.e_shoff + sh_off * sizeof(ELFSectionHeader)));
+        section_header_table + sh_off * sizeof(ELFSectionHeader)));
   }
 }
 
 }  // namespace Kernel
-
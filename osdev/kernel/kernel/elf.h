@@ -41,6 +41,14 @@ struct ELFProgramHeader {
   uint64_t p_align;
 } __attribute__((packed));  // Must be 0x38 bytes.
 
+// Loadable segment (p_type).
+constexpr uint32_t kELFSegmentLoad = 0x1;
+
+// Segment permissions (p_flags).
+constexpr uint32_t kELFSegmentExecutable = 0x1;
+constexpr uint32_t kELFSegmentWritable = 0x2;
+constexpr uint32_t kELFSegmentReadable = 0x4;
+
 struct ELFSectionHeader {
   uint32_t sh_name;
   uint32_t sh_type;
@@ -58,6 +66,11 @@ class ELFReader {
  public:
   ELFReader(const uint8_t* data, size_t file_size);
 
+  // Parse from the separately read program header and section header tables
+  // (which are at e_phoff and e_shoff of the file).
+  ELFReader(const ELFHeader& header, const uint8_t* program_header_table,
+            const uint8_t* section_header_table);
+
   bool IsValid() const { return is_valid_; }
   KernelString Error() const { return error_; }
 
@@ -70,7 +83,20 @@ class ELFReader {
     return section_headers_;
   }
 
+  // Moves out the headers when the reader is not needed anymore.
+  std::vector<ELFProgramHeader> TakeProgramHeaders() {
+    return std::move(program_headers_);
+  }
+  std::vector<ELFSectionHeader> TakeSectionHeaders() {
+    return std::move(section_headers_);
+  }
+
  private:
+  // Returns false if the header is not supported.
+  bool CheckHeader();
+  void ParseHeaderTables(const uint8_t* program_header_table,
+                         const uint8_t* section_header_table);
+
   bool is_valid_;
   KernelString error_;
 
@@ -3,6 +3,7 @@
 
 #include "../std/map.h"
 #include "qemu_log.h"
+#include "sync.h"
 
 namespace Kernel {
 
@@ -27,13 +28,24 @@ class FileDescriptor {
     }
   }
 
+  // The kernel (e.g the I/O ring worker) holds the reference while it uses
+  // the descriptor outside of the table lock, so the descriptor must not be
+  // deleted until every reference is dropped.
+  void Ref() { __atomic_fetch_add(&num_refs_, 1, __ATOMIC_ACQ_REL); }
+  void Unref() { __atomic_fetch_sub(&num_refs_, 1, __ATOMIC_ACQ_REL); }
+
   virtual ~FileDescriptor() = default;
 
-  bool IsNotInUse() const { return processes_.size() == 0; }
+  bool IsNotInUse() const {
+    return processes_.size() == 0 &&
+           __atomic_load_n(&num_refs_, __ATOMIC_ACQUIRE) == 0;
+  }
 
  private:
   // List of proceses that has opened this descriptor.
   std::set<pid_t> processes_;
+
+  int num_refs_ = 0;
 };
 
 class FileDescriptorTable {
@@ -46,17 +58,22 @@ class FileDescriptorTable {
     fd_to_desc_[STDERR] = nullptr;
   }
 
+  // Copying the map copies the tree as is, so it is linear to the number of
+  // descriptors.
   FileDescriptorTable(const FileDescriptorTable& table) {
+    std::lock_guard<MultiCoreSpinLock> lk(table.table_lock_);
     fd_to_desc_ = table.fd_to_desc_;
   }
 
   FileDescriptorTable& operator=(const FileDescriptorTable& table) {
     QemuSerialLog::Logf("Copy table!");
+    std::lock_guard<MultiCoreSpinLock> lk(table.table_lock_);
     fd_to_desc_ = table.fd_to_desc_;
     return *this;
   }
 
   FileDescriptor* GetDescriptor(int fd) {
+    std::lock_guard<MultiCoreSpinLock> lk(table_lock_);
     auto itr = fd_to_desc_.find(fd);
     if (itr == fd_to_desc_.end()) {
       return nullptr;
@@ -64,7 +81,21 @@ class FileDescriptorTable {
     return (*itr).second;
   }
 
+  // Same as GetDescriptor() but takes the reference of the descriptor so that
+  // it stays alive even if the fd is closed (or replaced by dup2) meanwhile.
+  // The caller must call Unref() when it is done.
+  FileDescriptor* GetDescriptorRef(int fd) {
+    std::lock_guard<MultiCoreSpinLock> lk(table_lock_);
+    auto itr = fd_to_desc_.find(fd);
+    if (itr == fd_to_desc_.end() || (*itr).second == nullptr) {
+      return nullptr;
+    }
+    (*itr).second->Ref();
+    return (*itr).second;
+  }
+
   int AddDescriptor(FileDescriptor* desc) {
+    std::lock_guard<MultiCoreSpinLock> lk(table_lock_);
     int fd = fd_to_desc_.size();
     fd_to_desc_[fd] = desc;
     return fd;
@@ -72,6 +103,7 @@ class FileDescriptorTable {
 
   // Returns the previous descriptor if fd_to_desc[fd] already exists.
   FileDescriptor* SetDescriptor(int fd, FileDescriptor* desc) {
+    std::lock_guard<MultiCoreSpinLock> lk(table_lock_);
     auto itr = fd_to_desc_.find(fd);
     if (itr == fd_to_desc_.end()) {
       fd_to_desc_[fd] = desc;
@@ -102,6 +134,10 @@ class FileDescriptorTable {
 
  //private:
   std::map<int, FileDescriptor*> fd_to_desc_;
+
+  // The I/O ring worker looks up the descriptors while the process may be
+  // adding one.
+  mutable MultiCoreSpinLock table_lock_;
 };
 
 }  // namespace Kernel
@@ -3,6 +3,7 @@
 
 #include "../std/hash_map.h"
 #include "../std/stdint.h"
+#include "../std/vector.h"
 
 namespace Kernel {
 
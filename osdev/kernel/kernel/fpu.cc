@@ -1,5 +1,6 @@
 #include "fpu.h"
 
+#include "kernel_simd.h"
 #include "qemu_log.h"
 
 namespace Kernel {
@@ -14,16 +15,19 @@ void FPUManager::InitFPU() {
       "or $0x600, %%ax\n"  // Set both CR4.OSFXSR and CR4.OSXMMEXCPT
       "mov %%rax, %%cr4\n" ::
           :);
-  HasSSE();
+  if (HasSSE()) {
+    KernelSimdGuard::EnableForCurrentCPU();
+  }
 }
 
 bool FPUManager::HasSSE() {
   int zero_flag;
+  // CPUID.01H:EDX.SSE2[bit 26].
   asm volatile(
       "mov $0x1, %%eax\n"
       "cpuid\n"
-      "test $0x2000, %%edx\n"
-      : "=@ccz"(zero_flag)::);
+      "test $0x4000000, %%edx\n"
+      : "=@ccz"(zero_flag)::"rax", "rbx", "rcx", "rdx");
   QemuSerialLog::Logf("Has SSE support? %d", !zero_flag);
   return !zero_flag;
 }
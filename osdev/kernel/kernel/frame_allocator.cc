@@ -3,6 +3,7 @@
 #include "../std/algorithm.h"
 #include "../std/printf.h"
 #include "kernel_util.h"
+#include "sync.h"
 
 namespace Kernel {
 namespace {
@@ -368,40 +369,62 @@ void FrameDescriptor::Print() const {
 UserFrameAllocator::UserFrameAllocator()
     : physical_addr_boundary_(kAllocatablePhysicalAddrStart),
       spin_lock_("UserFrameAllocLock") {
+  AddAllocator();
+}
+
+void UserFrameAllocator::AddAllocator() {
   // Create 2^13 size buddy block allocator. This spans 2^25 == 32 MB bytes of
   // the physical address space.
   allocators_.push_back(
       BuddyBlockAllocator(reinterpret_cast<uint8_t*>(physical_addr_boundary_)));
+  ref_counts_.push_back(
+      std::vector<uint16_t>(kSingleAllocatorSize / (1 << 12), 0));
 
   physical_addr_boundary_ += kSingleAllocatorSize;
 }
 
+uint16_t& UserFrameAllocator::RefCount(void* frame) {
+  uint64_t offset =
+      reinterpret_cast<uint64_t>(frame) - kAllocatablePhysicalAddrStart;
+  size_t index = offset / kSingleAllocatorSize;
+  ASSERT(index < ref_counts_.size());
+
+  return ref_counts_[index][(offset % kSingleAllocatorSize) >> 12];
+}
+
 void* UserFrameAllocator::AllocateFrame(int order) {
   if (order > 13) {
     kprintf("Cannot allocate order of %d > 13 \n", order);
     return nullptr;
   }
 
-  spin_lock_.lock();
+  std::lock_guard<MultiCoreSpinLock> lk(spin_lock_);
   for (auto& allocator : allocators_) {
     void* addr = allocator.GetFrame(order);
     if (addr != nullptr) {
-      spin_lock_.unlock();
+      RefCount(addr) = 1;
       return addr;
     }
   }
 
   // If allocator pool is not large enough, then we should create a new one.
-  allocators_.push_back(
-      BuddyBlockAllocator(reinterpret_cast<uint8_t*>(physical_addr_boundary_)));
-  physical_addr_boundary_ += kSingleAllocatorSize;
+  AddAllocator();
 
   auto* frame = allocators_.back().GetFrame(order);
-  spin_lock_.unlock();
+  RefCount(frame) = 1;
 
   return frame;
 }
 
+void UserFrameAllocator::ShareFrame(void* frame) {
+  ASSERT(reinterpret_cast<uint64_t>(frame) < physical_addr_boundary_);
+
+  std::lock_guard<MultiCoreSpinLock> lk(spin_lock_);
+  uint16_t& ref_count = RefCount(frame);
+  ASSERT(ref_count > 0);
+  ref_count++;
+}
+
 void UserFrameAllocator::FreeFrame(void* frame) {
   ASSERT(reinterpret_cast<uint64_t>(frame) < physical_addr_boundary_);
   size_t index =
@@ -409,9 +432,17 @@ void UserFrameAllocator::FreeFrame(void* frame) {
       kSingleAllocatorSize;
   ASSERT(index < allocators_.size());
 
-  spin_lock_.lock();
-  allocators_[index].FreeFrame(frame);
-  spin_lock_.unlock();
+  std::lock_guard<MultiCoreSpinLock> lk(spin_lock_);
+  uint16_t& ref_count = RefCount(frame);
+  ASSERT(ref_count > 0);
+  if (--ref_count == 0) {
+    allocators_[index].FreeFrame(frame);
+  }
+}
+
+int UserFrameAllocator::GetRefCount(void* frame) {
+  std::lock_guard<MultiCoreSpinLock> lk(spin_lock_);
+  return RefCount(frame);
 }
 
 }  // namespace Kernel
@@ -104,16 +104,31 @@ class UserFrameAllocator {
     return user_frame_allocator;
   }
 
-  // Allocate a physical frame. Returns a physical address.
+  // Allocate a physical frame. Returns a physical address. The returned frame
+  // has the reference count of 1.
   void* AllocateFrame(int order);
 
-  // Free the physical frame. frame MUST be a physical address.
+  // Add a reference to the already allocated frame. Used when the same frame
+  // is mapped at more than one place (e.g page cache or copy on write pages).
+  void ShareFrame(void* frame);
+
+  // Drop a reference of the physical frame. The frame is actually freed when
+  // the last reference is dropped. frame MUST be a physical address returned
+  // by AllocateFrame.
   void FreeFrame(void* frame);
 
+  int GetRefCount(void* frame);
+
  private:
   UserFrameAllocator();
 
+  void AddAllocator();
+  uint16_t& RefCount(void* frame);
+
   std::vector<BuddyBlockAllocator> allocators_;
+
+  // Per 4KB frame reference count of each allocator.
+  std::vector<std::vector<uint16_t>> ref_counts_;
   uint64_t physical_addr_boundary_;
 
   MultiCoreSpinLock spin_lock_;
@@ -19,6 +19,13 @@ ActualFileDescriptor::ActualFileDescriptor(int inode_num, int modes)
 }
 
 size_t ActualFileDescriptor::Read(void* buf, int count) {
+  size_t num_read = ReadAt(buf, count, offset_);
+  offset_ += num_read;
+
+  return num_read;
+}
+
+size_t ActualFileDescriptor::ReadAt(void* buf, int count, size_t offset) {
   QemuSerialLog::Logf("Read file : %d \n", inode_num_);
   auto& ext2 = Ext2FileSystem::GetExt2FileSystem();
   if (inode_ == nullptr) {
@@ -26,11 +33,7 @@ size_t ActualFileDescriptor::Read(void* buf, int count) {
     *inode_ = ext2.ReadInode(inode_num_);
   }
 
-  size_t num_read =
-      ext2.ReadFile(inode_, reinterpret_cast<uint8_t*>(buf), count, offset_);
-  offset_ += num_read;
-
-  return num_read;
+  return ext2.ReadFile(inode_, reinterpret_cast<uint8_t*>(buf), count, offset);
 }
 
 size_t ActualFileDescriptor::Write(void* buf, int count) {
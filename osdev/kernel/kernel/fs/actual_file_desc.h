@@ -23,6 +23,10 @@ class ActualFileDescriptor : public FileDescriptor {
   DescriptorType GetDescriptorType() final { return ACTUAL_FILE; }
 
   size_t Read(void* buf, int count);
+
+  // Reads at the offset. Unlike Read(), the offset of the descriptor does not
+  // move.
+  size_t ReadAt(void* buf, int count, size_t offset);
   size_t Write(void* buf, int count);
 
   enum Whence { SEEK_SET, SEEK_CUR, SEEK_END };
@@ -11,6 +11,7 @@
 #include "../qemu_log.h"
 #include "ata.h"
 #include "block_iterator.h"
+#include "page_cache.h"
 
 namespace Kernel {
 namespace {
@@ -236,6 +237,10 @@ void Ext2FileSystem::WriteInode(size_t inode_addr, const Ext2Inode& inode) {
 
   block_with_inodes[index % 8] = inode;
   WriteFromBlockId(block_with_inodes.data(), block_containing_inode);
+
+  // Cached pages of the file are not valid anymore. Must be done after the
+  // write so that the concurrent read does not cache the old content again.
+  PageCache::GetPageCache().Invalidate(inode_addr);
 }
 
 size_t Ext2FileSystem::ReadFile(Ext2Inode* file_inode, uint8_t* buf,
@@ -325,6 +330,10 @@ void Ext2FileSystem::WriteFile(size_t inode_num, uint8_t* buf, size_t num_write,
     WriteFromBlockId(block.data(), iter.GetDataBlockID());
     ++iter;
   }
+
+  // Cached pages of the file are not valid anymore. Must be done after the
+  // write so that the concurrent read does not cache the old content again.
+  PageCache::GetPageCache().Invalidate(inode_num);
 }
 
 void Ext2FileSystem::ExpandFileSize(size_t inode_num,
@@ -534,12 +543,12 @@ bool Ext2FileSystem::CreateFile(std::string_view path, bool is_directory) {
   return true;
 }
 
-std::vector<Ext2Directory> Ext2FileSystem::ParseDirectory(Ext2Inode* dir) {
+Ext2DirectoryList Ext2FileSystem::ParseDirectory(Ext2Inode* dir) {
   // Read the entire directory.
   uint8_t* dir_data = reinterpret_cast<uint8_t*>(kmalloc(dir->size));
   ReadFile(dir, dir_data, dir->size);
 
-  std::vector<Ext2Directory> dir_info;
+  Ext2DirectoryList dir_info;
 
   size_t current = 0;
   uint8_t* current_read = dir_data;
@@ -563,21 +572,22 @@ std::vector<Ext2Directory> Ext2FileSystem::ParseDirectory(Ext2Inode* dir) {
     // Read type indicator.
     uint8_t file_type = ReadAndAdvance<uint8_t>(current_read);
 
-    KernelString file_name(reinterpret_cast<char*>(current_read), name_len);
     Ext2Directory dir_entry;
     dir_entry.inode = inode;
     dir_entry.file_type = file_type;
-    dir_entry.name = file_name;
+    dir_entry.name =
+        KernelString(reinterpret_cast<char*>(current_read), name_len);
     /*
     kprintf("Dir : %s inode (%lx) (%lx) (%lx) entry size(%lx)\n",
-            file_name.c_str(), inode, file_type, name_len, entry_size);
+            dir_entry.name.c_str(), inode, file_type, name_len, entry_size);
     */
-    dir_info.push_back(dir_entry);
+    dir_info.push_back(std::move(dir_entry));
 
     current_read = dir_start + entry_size;
     current += entry_size;
   }
 
+  kfree(dir_data);
   return dir_info;
 }
 
@@ -599,7 +609,9 @@ size_t Ext2FileSystem::GetEndOfDirectoryEntry(Ext2Inode* dir_inode) {
     // kprintf("Etnry size ; %d \n", entry_size);
     if (entry_size == 0) {
       current_read -= (sizeof(uint32_t) + sizeof(uint16_t));
-      return current_read - dir_data;
+      size_t end = current_read - dir_data;
+      kfree(dir_data);
+      return end;
     }
 
     // Read name length.
@@ -611,7 +623,9 @@ size_t Ext2FileSystem::GetEndOfDirectoryEntry(Ext2Inode* dir_inode) {
     current_read = dir_start + entry_size;
     current += entry_size;
   }
-  return current_read - dir_data;
+  size_t end = current_read - dir_data;
+  kfree(dir_data);
+  return end;
 }
 
 int Ext2FileSystem::GetInodeNumberFromPath(std::string_view path) {
@@ -628,7 +642,10 @@ int Ext2FileSystem::GetInodeNumberFromPath(std::string_view path) {
   }
 
   size_t current = 1;
-  std::vector<Ext2Directory> current_dir = root_dir_;
+
+  // Do not copy the root directory.
+  const Ext2DirectoryList* current_dir = &root_dir_;
+  Ext2DirectoryList parsed_dir;
 
   while (true) {
     size_t end = path.find_first_of('/', current);
@@ -636,7 +653,7 @@ int Ext2FileSystem::GetInodeNumberFromPath(std::string_view path) {
       std::string_view name = path.substr(current, end - current);
 
       bool found = false;
-      for (const auto& file : current_dir) {
+      for (const auto& file : *current_dir) {
         if (file.name == name) {
           // Case for /.../.../name/
           if (end == path.size() - 1) {
@@ -644,7 +661,8 @@ int Ext2FileSystem::GetInodeNumberFromPath(std::string_view path) {
           } else {
             // Case for /.../name/...
             Ext2Inode inode = ReadInode(file.inode);
-            current_dir = ParseDirectory(&inode);
+            parsed_dir = ParseDirectory(&inode);
+            current_dir = &parsed_dir;
             found = true;
             break;
           }
@@ -657,7 +675,7 @@ int Ext2FileSystem::GetInodeNumberFromPath(std::string_view path) {
     } else {
       // Case for /.../.../name
       std::string_view name = path.substr(current);
-      for (const auto& file : current_dir) {
+      for (const auto& file : *current_dir) {
         if (file.name == name) {
           return file.inode;
         }
@@ -700,7 +718,7 @@ KernelString Ext2FileSystem::GetCanonicalAbsolutePath(
     return "";
   }
 
-  std::vector<KernelString> paths;
+  std::InlinedVector<KernelString, 8> paths;
 
   size_t current = 1;
   while (current < absolute_path.size()) {
@@ -725,7 +743,7 @@ KernelString Ext2FileSystem::GetCanonicalAbsolutePath(
         paths.pop_back();
       }
     } else if (dir != "." && dir != "") {
-      paths.push_back(dir);
+      paths.push_back(std::move(dir));
     }
 
     if (dir_name_end == npos) {
@@ -736,7 +754,7 @@ KernelString Ext2FileSystem::GetCanonicalAbsolutePath(
   }
 
   KernelString path;
-  for (auto p : paths) {
+  for (const auto& p : paths) {
     path.append("/");
     path.append(p);
   }
@@ -2,6 +2,7 @@
 #define EXT2_H
 
 #include "../../std/bitmap.h"
+#include "../../std/inlined_vector.h"
 #include "../../std/string.h"
 #include "../../std/types.h"
 #include "../../std/vector.h"
@@ -455,6 +456,9 @@ struct Ext2Directory {
   KernelString name;
 };
 
+// Most of the directories only have a handful of entries.
+using Ext2DirectoryList = std::InlinedVector<Ext2Directory, 8>;
+
 struct linux_dirent {
   uint32_t d_ino;     /* Inode number */
   uint32_t d_off;     /* Offset to next linux_dirent */
@@ -544,7 +548,7 @@ class Ext2FileSystem {
 
   int GetInodeNumberFromPath(std::string_view path);
 
-  std::vector<Ext2Directory> ParseDirectory(Ext2Inode* dir);
+  Ext2DirectoryList ParseDirectory(Ext2Inode* dir);
 
  private:
   struct BitmapInfo {
@@ -569,7 +573,7 @@ class Ext2FileSystem {
   Ext2SuperBlock super_block_;
   Ext2Inode root_inode_;
 
-  std::vector<Ext2Directory> root_dir_;
+  Ext2DirectoryList root_dir_;
 
   Ext2BlockGroupDescriptor* block_descs_;
   size_t num_block_desc_;
@@ -0,0 +1,174 @@
+#include "page_cache.h"
+
+#include "../../std/algorithm.h"
+#include "../frame_allocator.h"
+#include "../kmalloc.h"
+#include "../paging.h"
+
+namespace Kernel {
+
+void* PageCache::GetPage(size_t inode_num, size_t page_offset) {
+  ASSERT(page_offset % kPageSize == 0);
+
+  auto& frame_allocator = UserFrameAllocator::GetPhysicalFrameAllocator();
+  auto& file_system = Ext2FileSystem::GetExt2FileSystem();
+
+  Ext2Inode inode;
+  bool has_inode = false;
+  uint64_t num_invalidates;
+  {
+    std::lock_guard<MultiCoreSpinLock> lk(lock_);
+    num_invalidates = num_invalidates_;
+    auto file_itr = files_.find(inode_num);
+    if (file_itr != files_.end()) {
+      CachedFile* file = (*file_itr).second;
+      auto page_itr = file->pages.find(page_offset);
+      if (page_itr != file->pages.end()) {
+        void* frame = (*page_itr).second;
+        frame_allocator.ShareFrame(frame);
+        return frame;
+      }
+
+      inode = file->inode;
+      has_inode = true;
+    }
+  }
+
+  // Disk access must be done without holding the lock.
+  if (!has_inode) {
+    inode = file_system.ReadInode(inode_num);
+  }
+
+  uint8_t* buf = static_cast<uint8_t*>(kmalloc(kPageSize));
+  memset(buf, 0, kPageSize);
+  if (page_offset < inode.size) {
+    file_system.ReadFile(&inode, buf, min(kPageSize, inode.size - page_offset),
+                         page_offset);
+  }
+
+  void* frame = frame_allocator.AllocateFrame(0);
+  auto& page_table_manager = PageTableManager::GetPageTableManager();
+  void* frame_addr = page_table_manager.MapFrameToKernel(frame);
+  memcpy(frame_addr, buf, kPageSize);
+  page_table_manager.UnmapFrameFromKernel(frame_addr);
+  kfree(buf);
+
+  std::lock_guard<MultiCoreSpinLock> lk(lock_);
+
+  // The file may have been modified while reading it. Do not cache what might
+  // be the old content; the caller owns the only reference.
+  if (num_invalidates != num_invalidates_) {
+    return frame;
+  }
+
+  auto file_itr = files_.find(inode_num);
+  CachedFile* file;
+  if (file_itr == files_.end()) {
+    file = new CachedFile();
+    file->inode = inode;
+    files_[inode_num] = file;
+  } else {
+    file = (*file_itr).second;
+  }
+
+  auto page_itr = file->pages.find(page_offset);
+  if (page_itr != file->pages.end()) {
+    // Someone else has read the same page in the mean time.
+    frame_allocator.FreeFrame(frame);
+    frame = (*page_itr).second;
+  } else {
+    file->pages[page_offset] = frame;
+    num_pages_++;
+  }
+
+  // Reference for the caller. Must be taken before the eviction so that the
+  // frame is not evicted.
+  frame_allocator.ShareFrame(frame);
+  if (num_pages_ > kMaxCachedPages) {
+    Evict();
+  }
+  return frame;
+}
+
+void PageCache::Read(size_t inode_num, void* buf, size_t num_read,
+                     size_t offset) {
+  auto& frame_allocator = UserFrameAllocator::GetPhysicalFrameAllocator();
+  auto& page_table_manager = PageTableManager::GetPageTableManager();
+
+  uint8_t* dest = static_cast<uint8_t*>(buf);
+  while (num_read > 0) {
+    size_t page_offset = offset - offset % kPageSize;
+    size_t num_copy = min(num_read, page_offset + kPageSize - offset);
+
+    void* frame = GetPage(inode_num, page_offset);
+    uint8_t* frame_addr =
+        static_cast<uint8_t*>(page_table_manager.MapFrameToKernel(frame));
+    memcpy(dest, frame_addr + (offset - page_offset), num_copy);
+    page_table_manager.UnmapFrameFromKernel(frame_addr);
+    frame_allocator.FreeFrame(frame);
+
+    dest += num_copy;
+    offset += num_copy;
+    num_read -= num_copy;
+  }
+}
+
+void PageCache::Invalidate(size_t inode_num) {
+  CachedFile* file = nullptr;
+  {
+    std::lock_guard<MultiCoreSpinLock> lk(lock_);
+    num_invalidates_++;
+    auto file_itr = files_.find(inode_num);
+    if (file_itr == files_.end()) {
+      return;
+    }
+
+    file = (*file_itr).second;
+    files_.erase(file_itr);
+    num_pages_ -= file->pages.size();
+  }
+
+  auto& frame_allocator = UserFrameAllocator::GetPhysicalFrameAllocator();
+  for (auto itr = file->pages.begin(); itr != file->pages.end(); ++itr) {
+    frame_allocator.FreeFrame((*itr).second);
+  }
+  delete file;
+}
+
+void PageCache::Evict() {
+  auto& frame_allocator = UserFrameAllocator::GetPhysicalFrameAllocator();
+
+  // Only the cache can hand out a new reference of the page (under the lock),
+  // so the page that has the reference count of 1 can be freed safely.
+  for (auto file_itr = files_.begin(); file_itr != files_.end();) {
+    CachedFile* file = (*file_itr).second;
+    for (auto page_itr = file->pages.begin(); page_itr != file->pages.end();) {
+      if (num_pages_ <= kMaxCachedPages / 4 * 3) {
+        return;
+      }
+
+      void* frame = (*page_itr).second;
+      if (frame_allocator.GetRefCount(frame) != 1) {
+        ++page_itr;
+        continue;
+      }
+
+      frame_allocator.FreeFrame(frame);
+      auto next_page_itr = page_itr;
+      ++next_page_itr;
+      file->pages.erase(page_itr);
+      page_itr = next_page_itr;
+      num_pages_--;
+    }
+
+    auto next_file_itr = file_itr;
+    ++next_file_itr;
+    if (file->pages.size() == 0) {
+      delete file;
+      files_.erase(file_itr);
+    }
+    file_itr = next_file_itr;
+  }
+}
+
+}  // namespace Kernel
@@ -0,0 +1,75 @@
+#ifndef FS_PAGE_CACHE_H
+#define FS_PAGE_CACHE_H
+
+#include "../../std/map.h"
+#include "../../std/types.h"
+#include "../sync.h"
+#include "ext2.h"
+
+namespace Kernel {
+
+// Caches the 4KB pages of the files in the user frames. Since the cached frame
+// can be directly mapped to the user process, processes that run the same
+// executable share its text pages instead of reading them from the disk
+// again.
+//
+// Every cached frame holds one reference that is owned by the cache. Mapping
+// a cached frame must take its own reference (which GetPage does).
+//
+// At most kMaxCachedPages pages are cached. When it is full, the pages that
+// only the cache refers to (i.e not mapped by any process) are evicted.
+class PageCache {
+ public:
+  static constexpr size_t kPageSize = 4096;
+
+  // 16 MB.
+  static constexpr size_t kMaxCachedPages = 4096;
+
+  static PageCache& GetPageCache() {
+    static PageCache page_cache;
+    return page_cache;
+  }
+
+  // Returns the physical frame that contains [page_offset, page_offset + 4KB)
+  // of the file. Bytes beyond the end of the file are filled with zero. The
+  // caller owns one reference of the returned frame and must release it with
+  // UserFrameAllocator::FreeFrame.
+  void* GetPage(size_t inode_num, size_t page_offset);
+
+  // Read the file content through the page cache.
+  void Read(size_t inode_num, void* buf, size_t num_read, size_t offset);
+
+  // Drop every cached page of the file. Must be called after the file is
+  // modified. Pages that are already mapped by the processes are not affected.
+  void Invalidate(size_t inode_num);
+
+ private:
+  PageCache() : lock_("PageCacheLock"), num_pages_(0), num_invalidates_(0) {}
+
+  // Evict the pages that are not used by anyone else until there are at most
+  // 3/4 of kMaxCachedPages pages. The lock must be held.
+  void Evict();
+
+  struct CachedFile {
+    Ext2Inode inode;
+
+    // Maps page aligned file offset to the physical frame.
+    std::map<size_t, void*> pages;
+  };
+
+  // Map inode number to the cached pages of the file.
+  std::map<size_t, CachedFile*> files_;
+
+  MultiCoreSpinLock lock_;
+
+  // Total number of the cached pages.
+  size_t num_pages_;
+
+  // Incremented by every Invalidate(). The page that is read from the disk
+  // while the file is being modified is not cached.
+  uint64_t num_invalidates_;
+};
+
+}  // namespace Kernel
+
+#endif
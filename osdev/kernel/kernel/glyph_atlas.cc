@@ -0,0 +1,93 @@
+#include "glyph_atlas.h"
+
+#include "fonts.h"
+#include "kmalloc.h"
+
+namespace Kernel {
+namespace {
+
+uint64_t TileKey(int c, uint32_t color) {
+  return (static_cast<uint64_t>(c) << 32) | color;
+}
+
+}  // namespace
+
+GlyphAtlas::GlyphAtlas() {
+  tiles_ = (uint32_t*)kmalloc(sizeof(uint32_t) * kTileWidth * kTileHeight *
+                              kNumTiles);
+  for (int i = 0; i < kNumTiles; i++) {
+    keys_[i] = kEmptyKey;
+    prev_[i] = i - 1;
+    next_[i] = (i + 1 < kNumTiles) ? i + 1 : -1;
+  }
+  head_ = 0;
+  tail_ = kNumTiles - 1;
+}
+
+const uint32_t* GlyphAtlas::GetTile(int c, uint32_t color) {
+  const uint64_t key = TileKey(c, color);
+  const int* cached = slots_.find(key);
+  if (cached != nullptr) {
+    int slot = *cached;
+    Unlink(slot);
+    PushFront(slot);
+    return tiles_ + slot * kTileWidth * kTileHeight;
+  }
+
+  char* font = FontManager::GetFontManager().GetFont(c);
+  if (font == nullptr) {
+    return nullptr;
+  }
+
+  // Replace the least recently used one.
+  int slot = tail_;
+  if (keys_[slot] != kEmptyKey) {
+    slots_.erase(keys_[slot]);
+  }
+  keys_[slot] = key;
+  slots_[key] = slot;
+  Unlink(slot);
+  PushFront(slot);
+
+  uint32_t* tile = tiles_ + slot * kTileWidth * kTileHeight;
+  ExpandGlyph(font, color, tile, kTileWidth);
+  return tile;
+}
+
+void GlyphAtlas::ExpandGlyph(const char* font, uint32_t color, uint32_t* dest,
+                             int pitch) {
+  for (int i = 0; i < kTileHeight; i++) {
+    for (int j = 0; j < kTileWidth; j++) {
+      // The most significant bit is the leftmost pixel.
+      dest[i * pitch + j] = (font[i] & (1 << (kTileWidth - 1 - j))) ? color : 0;
+    }
+  }
+}
+
+void GlyphAtlas::Unlink(int slot) {
+  if (prev_[slot] != -1) {
+    next_[prev_[slot]] = next_[slot];
+  } else {
+    head_ = next_[slot];
+  }
+
+  if (next_[slot] != -1) {
+    prev_[next_[slot]] = prev_[slot];
+  } else {
+    tail_ = prev_[slot];
+  }
+}
+
+void GlyphAtlas::PushFront(int slot) {
+  prev_[slot] = -1;
+  next_[slot] = head_;
+  if (head_ != -1) {
+    prev_[head_] = slot;
+  }
+  head_ = slot;
+  if (tail_ == -1) {
+    tail_ = slot;
+  }
+}
+
+}  // namespace Kernel
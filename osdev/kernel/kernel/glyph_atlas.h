@@ -0,0 +1,67 @@
+#ifndef GLYPH_ATLAS_H
+#define GLYPH_ATLAS_H
+
+#include "../std/hash_map.h"
+#include "../std/stdint.h"
+
+namespace Kernel {
+
+// Cache of the glyphs that are already expanded to the 32bpp tiles of a
+// certain color. Drawing a character then becomes copying each row of the
+// tile instead of testing every bit of the font. When the atlas is full, the
+// least recently used tile is replaced.
+//
+// NOTE This is not thread safe. It is used under the print lock of
+// GraphicManager.
+class GlyphAtlas {
+ public:
+  // Size of the console font (8 x 16 PSF).
+  static constexpr int kTileWidth = 8;
+  static constexpr int kTileHeight = 16;
+  static constexpr int kNumTiles = 256;
+
+  static GlyphAtlas& GetGlyphAtlas() {
+    static GlyphAtlas glyph_atlas;
+    return glyph_atlas;
+  }
+
+  // Returns the tile (kTileHeight rows of kTileWidth pixels) of the glyph c
+  // drawn with the color. Returns nullptr if there is no font for c. The tile
+  // is valid until the next GetTile().
+  const uint32_t* GetTile(int c, uint32_t color);
+
+  // Expand the font bitmap to the pixels. pitch is the number of pixels in
+  // the row of dest.
+  static void ExpandGlyph(const char* font, uint32_t color, uint32_t* dest,
+                          int pitch);
+
+ private:
+  GlyphAtlas();
+
+  // Remove the slot from the LRU list.
+  void Unlink(int slot);
+
+  // Put the slot at the front (most recently used) of the LRU list.
+  void PushFront(int slot);
+
+  static constexpr uint64_t kEmptyKey = ~0ULL;
+
+  // kNumTiles tiles of kTileWidth * kTileHeight pixels.
+  uint32_t* tiles_;
+
+  // (glyph, color) that each slot holds.
+  uint64_t keys_[kNumTiles];
+
+  // Doubly linked LRU list of the slots. head_ is the most recently used one.
+  int prev_[kNumTiles];
+  int next_[kNumTiles];
+  int head_;
+  int tail_;
+
+  // Maps (glyph, color) to the slot.
+  std::HashMap<uint64_t, int> slots_;
+};
+
+}  // namespace Kernel
+
+#endif
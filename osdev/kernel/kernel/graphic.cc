@@ -1,11 +1,21 @@
 #include "graphic.h"
 
 #include "../boot/multiboot2.h"
+#include "../std/algorithm.h"
+#include "../std/string.h"
+#include "cpu.h"
 #include "fonts.h"
+#include "frame_allocator.h"
+#include "glyph_atlas.h"
+#include "kernel_simd.h"
 #include "kmalloc.h"
 #include "paging.h"
+#include "process.h"
 #include "qemu_log.h"
 #include "scheduler.h"
+#include "timer.h"
+#include "vm_area.h"
+#include "zeroed_frame_pool.h"
 
 namespace Kernel {
 namespace {
@@ -18,6 +28,45 @@ uint64_t RoundUpToFourKB(uint64_t sz) {
   return (sz / kFourKB + 1) * kFourKB;
 }
 
+// KernelSimdGuard disables the interrupt, so large copies are split into
+// chunks of this many rows and the guard is taken for each chunk. Saving the
+// XMM registers for every (possibly very short) span would be too costly.
+constexpr int kRowsPerSimdGuard = 16;
+
+int Clamp(int v, int low, int high) {
+  if (v < low) {
+    return low;
+  } else if (v > high) {
+    return high;
+  }
+  return v;
+}
+
+void CompareAndCopy(const KernelSimdGuard& guard, uint32_t* dest,
+                    uint32_t* last, const uint32_t* src, size_t count) {
+  if (guard.CanUseSimd()) {
+    SimdCompareAndCopy32(dest, last, src, count);
+  } else {
+    KernelSimd::CompareAndCopy32Scalar(dest, last, src, count);
+  }
+}
+
+void Copy(const KernelSimdGuard& guard, void* dest, const void* src,
+          size_t bytes) {
+  if (guard.CanUseSimd()) {
+    SimdCopy(dest, src, bytes);
+  } else {
+    KernelSimd::CopyScalar(dest, src, bytes);
+  }
+}
+
+// Copy a row of the glyph tile. Too short to bother with SIMD.
+void CopyTileRow(uint32_t* dest, const uint32_t* tile_row) {
+  for (int i = 0; i < GlyphAtlas::kTileWidth; i++) {
+    dest[i] = tile_row[i];
+  }
+}
+
 }  // namespace
 
 void ParseMultibootInfo(void* multiboot_info) {
@@ -72,6 +121,19 @@ void GraphicManager::Init(int width, int height, int pixel_size,
 
   last_sync_ = (uint32_t*)kmalloc(width_ * height_ * (pixel_size_ / 8));
   buffer_ = (uint32_t*)kmalloc(width_ * height_ * (pixel_size_ / 8));
+  row_offset_ = 0;
+
+  DirtyRegion* regions[] = {&dirty_, &syncing_};
+  for (DirtyRegion* region : regions) {
+    region->col_begin = (int*)kmalloc(sizeof(int) * height_);
+    region->col_end = (int*)kmalloc(sizeof(int) * height_);
+    for (int i = 0; i < height_; i++) {
+      region->col_begin[i] = width_;
+      region->col_end[i] = 0;
+    }
+    region->row_begin = height_;
+    region->row_end = 0;
+  }
 
   KernelThread* sync_thread = new KernelThread([] {
     auto& m = GraphicManager::GetGraphicManager();
@@ -96,6 +158,11 @@ void GraphicManager::DrawAt(int row, int col, Color color) {
 }
 
 void GraphicManager::PutChar(int c, Color color) {
+  DrawChar(c, color);
+  FlushPendingSpan();
+}
+
+void GraphicManager::DrawChar(int c, Color color) {
   if (c == '\n') {
     cur_col_ = 0;
 
@@ -114,39 +181,35 @@ void GraphicManager::PutChar(int c, Color color) {
       }
     }
 
-    is_synced_ = false;
     return;
   }
 
-  char* font = FontManager::GetFontManager().GetFont(c);
-  if (font == nullptr) {
+  const uint32_t* tile = GlyphAtlas::GetGlyphAtlas().GetTile(c, color);
+  if (tile == nullptr) {
     MoveCursor();
     return;
   }
 
   for (int i = 0; i < font_height; i++) {
-    for (int j = 0; j < font_width; j++) {
-      GraphicManager::Color real_color = 0;
-      if (font[i] & (1 << j)) {
-        real_color = color;
-      }
-      buffer_[width_ * (i + cur_row_) + cur_col_ + 8 - j] = real_color;
-    }
+    CopyTileRow(BufferRow(i + cur_row_) + cur_col_ + 1,
+                tile + i * GlyphAtlas::kTileWidth);
   }
-  is_synced_ = false;
+  AddPendingSpan(cur_col_, font_width + font_margin_right);
   MoveCursor();
 }
 
 void GraphicManager::PrintString(std::string_view s, Color color) {
   for (size_t i = 0; i < s.size(); i++) {
-    PutChar(s[i], color);
+    DrawChar(s[i], color);
   }
+  FlushPendingSpan();
 }
 
 void GraphicManager::PrintAnchorString(std::string_view s, Color color) {
   for (size_t i = 0; i < s.size(); i++) {
-    PutChar(s[i], color);
+    DrawChar(s[i], color);
   }
+  FlushPendingSpan();
 
   anchor_col_ = cur_col_;
   anchor_row_ = cur_row_;
@@ -154,20 +217,21 @@ void GraphicManager::PrintAnchorString(std::string_view s, Color color) {
 }
 
 void GraphicManager::Scroll() {
+  // The span is at the row before the scroll.
+  FlushPendingSpan();
+
   const int scroll = font_height + font_margin_bottom;
-  // Scroll Everything up by (font_height + font_margin_bottom).
-  for (int i = scroll; i < height_; i++) {
-    for (int j = 0; j < width_; j++) {
-      buffer_[(i - scroll) * width_ + j] = buffer_[i * width_ + j];
-    }
-  }
 
-  // Fill the bottom as empty.
-  for (int i = height_ - scroll; i < height_; i++) {
-    for (int j = 0; j < width_; j++) {
-      buffer_[i * width_ + j] = 0;
-    }
+  // Scroll Everything up by (font_height + font_margin_bottom). The top rows
+  // of the ring become the bottom rows, so only those need to be cleared.
+  for (int i = 0; i < scroll; i++) {
+    memset(BufferRow(i), 0, width_ * sizeof(uint32_t));
   }
+  row_offset_ = (row_offset_ + scroll) % height_;
+
+  std::lock_guard<MultiCoreSpinLock> lk(dirty_lock_);
+  dirty_.is_scrolled = true;
+  is_synced_ = false;
 }
 
 void GraphicManager::MoveCursor() {
@@ -192,34 +256,349 @@ void GraphicManager::MoveCursor() {
   }
 }
 
+void GraphicManager::AddPendingSpan(int col, int width) {
+  if (pending_span_.col_begin < pending_span_.col_end &&
+      pending_span_.row != cur_row_) {
+    FlushPendingSpan();
+  }
+
+  if (pending_span_.col_begin >= pending_span_.col_end) {
+    pending_span_.row = cur_row_;
+    pending_span_.col_begin = col;
+    pending_span_.col_end = col + width;
+    return;
+  }
+  pending_span_.col_begin = min(pending_span_.col_begin, col);
+  pending_span_.col_end = max(pending_span_.col_end, col + width);
+}
+
+void GraphicManager::FlushPendingSpan() {
+  if (pending_span_.col_begin >= pending_span_.col_end) {
+    return;
+  }
+
+  MarkDirty(pending_span_.row, pending_span_.col_begin, font_height,
+            pending_span_.col_end - pending_span_.col_begin);
+  pending_span_.col_begin = 0;
+  pending_span_.col_end = 0;
+}
+
+void GraphicManager::MarkDirty(int row, int col, int height, int width) {
+  int row_end = Clamp(row + height, 0, height_);
+  int col_end = Clamp(col + width, 0, width_);
+  row = Clamp(row, 0, height_);
+  col = Clamp(col, 0, width_);
+  if (row >= row_end || col >= col_end) {
+    return;
+  }
+
+  std::lock_guard<MultiCoreSpinLock> lk(dirty_lock_);
+  for (int i = row; i < row_end; i++) {
+    dirty_.col_begin[i] = min(dirty_.col_begin[i], col);
+    dirty_.col_end[i] = max(dirty_.col_end[i], col_end);
+  }
+  dirty_.row_begin = min(dirty_.row_begin, row);
+  dirty_.row_end = max(dirty_.row_end, row_end);
+  is_synced_ = false;
+}
+
 void GraphicManager::SyncScreen() {
-  is_synced_ = true;
-
-  for (int i = 0; i < height_ * width_; i++) {
-    // We only copy the part that is different to last synced buffer.
-    // This is because reading video memory is super small and we don't want to
-    // copy entire buffer to video memory all the time.
-    if (last_sync_[i] != buffer_[i]) {
-      last_sync_[i] = buffer_[i];
-      video_mem_[i] = buffer_[i];
+  // Take the dirty region. Anything that is marked after this will be handled
+  // in the next sync.
+  {
+    std::lock_guard<MultiCoreSpinLock> lk(dirty_lock_);
+    DirtyRegion region = dirty_;
+    dirty_ = syncing_;
+    syncing_ = region;
+    is_synced_ = true;
+  }
+
+  if (syncing_.is_scrolled) {
+    // Compose the screen from the ring with two copies : rows after the
+    // offset go to the top and the rows before it go to the bottom.
+    int offset = row_offset_;
+    size_t top_size = (height_ - offset) * width_ * sizeof(uint32_t);
+    size_t bottom_size = offset * width_ * sizeof(uint32_t);
+    uint32_t* dests[] = {video_mem_, last_sync_};
+    for (uint32_t* dest : dests) {
+      memcpy(dest, buffer_ + offset * width_, top_size);
+      memcpy(dest + (height_ - offset) * width_, buffer_, bottom_size);
+    }
+  }
+
+  for (int chunk = syncing_.row_begin; chunk < syncing_.row_end;
+       chunk += kRowsPerSimdGuard) {
+    KernelSimdGuard guard;
+    int chunk_end = min(chunk + kRowsPerSimdGuard, syncing_.row_end);
+    for (int row = chunk; row < chunk_end; row++) {
+      int col_begin = syncing_.col_begin[row];
+      int col_end = syncing_.col_end[row];
+      if (!syncing_.is_scrolled && col_begin < col_end) {
+        // We only copy the part that is different to last synced buffer.
+        // This is because reading video memory is super small and we don't
+        // want to copy entire buffer to video memory all the time.
+        int i = row * width_ + col_begin;
+        CompareAndCopy(guard, video_mem_ + i, last_sync_ + i,
+                       BufferRow(row) + col_begin, col_end - col_begin);
+      }
+
+      syncing_.col_begin[row] = width_;
+      syncing_.col_end[row] = 0;
+    }
+  }
+  syncing_.row_begin = height_;
+  syncing_.row_end = 0;
+  syncing_.is_scrolled = false;
+
+  // Put the presented frame buffers on the screen. Those are the kernel
+  // memory so they can be read within the guard. Note that the process may be
+  // still drawing to it.
+  std::lock_guard<MultiCoreSpinLock> lk(shared_buffer_lock_);
+  for (auto itr = shared_buffers_.begin(); itr != shared_buffers_.end();
+       ++itr) {
+    SharedFrameBuffer* buffer = itr->second;
+    if (!buffer->is_presented) {
+      continue;
+    }
+    buffer->is_presented = false;
+
+    const FrameBufferInfo& info = buffer->info;
+    for (int chunk = 0; chunk < info.buffer_height;
+         chunk += kRowsPerSimdGuard) {
+      KernelSimdGuard guard;
+      int chunk_end = min(chunk + kRowsPerSimdGuard, info.buffer_height);
+      for (int i = chunk; i < chunk_end; i++) {
+        int screen_row = i + info.screen_row;
+        int screen_index = screen_row * width_ + info.screen_col;
+        const uint32_t* src = buffer->kernel_addr + i * info.buffer_width;
+        Copy(guard, BufferRow(screen_row) + info.screen_col, src,
+             info.buffer_width * sizeof(uint32_t));
+        CompareAndCopy(guard, video_mem_ + screen_index,
+                       last_sync_ + screen_index, src, info.buffer_width);
+      }
     }
   }
 }
 
 void GraphicManager::SyncScreenWith(uint32_t* buffer, FrameBufferInfo* info) {
+  // The user buffer can page fault, so it is first copied to buffer_ without
+  // SIMD. Then only the kernel memory is compared within the guard.
   for (int i = 0; i < info->buffer_height; i++) {
-    for (int j = 0; j < info->buffer_width; j++) {
-      int screen_index =
-          (i + info->screen_row) * width_ + (j + info->screen_col);
-      int buffer_index = i * info->buffer_width + j;
-      if (last_sync_[screen_index] != buffer[buffer_index]) {
-        buffer_[screen_index] = buffer[buffer_index];
-        last_sync_[screen_index] = buffer_[screen_index];
-        video_mem_[screen_index] = buffer_[screen_index];
+    memcpy(BufferRow(i + info->screen_row) + info->screen_col,
+           buffer + i * info->buffer_width,
+           info->buffer_width * sizeof(uint32_t));
+  }
+
+  for (int chunk = 0; chunk < info->buffer_height;
+       chunk += kRowsPerSimdGuard) {
+    KernelSimdGuard guard;
+    int chunk_end = min(chunk + kRowsPerSimdGuard, info->buffer_height);
+    for (int i = chunk; i < chunk_end; i++) {
+      int screen_row = i + info->screen_row;
+      int screen_index = screen_row * width_ + info->screen_col;
+      CompareAndCopy(guard, video_mem_ + screen_index,
+                     last_sync_ + screen_index,
+                     BufferRow(screen_row) + info->screen_col,
+                     info->buffer_width);
+    }
+  }
+
+  // Written through to the video memory already; no need to mark it dirty.
+}
+
+uint64_t GraphicManager::MapFrameBuffer(Process* process,
+                                        const FrameBufferInfo& info) {
+  if (info.buffer_width <= 0 || info.buffer_height <= 0 ||
+      info.screen_row < 0 || info.screen_col < 0 ||
+      info.screen_row + info.buffer_height > height_ ||
+      info.screen_col + info.buffer_width > width_) {
+    return 0;
+  }
+
+  {
+    std::lock_guard<MultiCoreSpinLock> lk(shared_buffer_lock_);
+    if (shared_buffers_.find(process->Id()) != shared_buffers_.end()) {
+      return 0;
+    }
+  }
+
+  constexpr uint64_t kFourKB = (1 << 12);
+  uint64_t size = RoundUpToFourKB(info.buffer_width * info.buffer_height *
+                                  sizeof(uint32_t));
+  VMAreaTree& vm_areas = process->GetVMAreaTree();
+  uint64_t start =
+      vm_areas.FindFreeRange(size, Process::kUserProcessMmapStartAddress,
+                             Process::kUserProcessMmapEndAddress);
+  if (start == 0) {
+    return 0;
+  }
+  if (!vm_areas.AddArea(VMArea{start, start + size, VMArea::FRAME_BUFFER,
+                               VMArea::kProtRead | VMArea::kProtWrite, 0,
+                               0})) {
+    return 0;
+  }
+
+  SharedFrameBuffer* buffer = new SharedFrameBuffer;
+  buffer->info = info;
+  buffer->is_presented = false;
+
+  auto& page_table_manager = PageTableManager::GetPageTableManager();
+  for (uint64_t offset = 0; offset < size; offset += kFourKB) {
+    void* frame = ZeroedFramePool::GetZeroedFramePool().AllocateZeroedFrame();
+
+    // One reference for the kernel and one for the page table.
+    UserFrameAllocator::GetPhysicalFrameAllocator().ShareFrame(frame);
+    page_table_manager.MapSharedPage(process->GetPageTableBaseAddress(),
+                                     start + offset, frame);
+    buffer->frames.push_back(frame);
+  }
+  buffer->kernel_addr =
+      static_cast<uint32_t*>(page_table_manager.MapFramesToKernel(
+          &buffer->frames[0], buffer->frames.size()));
+
+  std::lock_guard<MultiCoreSpinLock> lk(shared_buffer_lock_);
+  shared_buffers_[process->Id()] = buffer;
+
+  QemuSerialLog::Logf("[pid:%d] Frame buffer [%lx, %lx) \n", process->Id(),
+                      start, start + size);
+  return start;
+}
+
+bool GraphicManager::PresentFrameBuffer(int pid) {
+  {
+    std::lock_guard<MultiCoreSpinLock> lk(shared_buffer_lock_);
+    auto itr = shared_buffers_.find(pid);
+    if (itr == shared_buffers_.end()) {
+      return false;
+    }
+    itr->second->is_presented = true;
+  }
+
+  std::lock_guard<MultiCoreSpinLock> lk(dirty_lock_);
+  is_synced_ = false;
+  return true;
+}
+
+void GraphicManager::ReleaseFrameBuffer(int pid) {
+  SharedFrameBuffer* buffer = nullptr;
+  {
+    std::lock_guard<MultiCoreSpinLock> lk(shared_buffer_lock_);
+    auto itr = shared_buffers_.find(pid);
+    if (itr == shared_buffers_.end()) {
+      return;
+    }
+    buffer = itr->second;
+    shared_buffers_.erase(itr);
+  }
+
+  PageTableManager::GetPageTableManager().UnmapFrameFromKernel(
+      buffer->kernel_addr, buffer->frames.size() * (1 << 12));
+  for (void* frame : buffer->frames) {
+    UserFrameAllocator::GetPhysicalFrameAllocator().FreeFrame(frame);
+  }
+  delete buffer;
+}
+
+void GraphicManager::BenchmarkSync() {
+  const size_t num_pixels = width_ * height_;
+  uint32_t* src = (uint32_t*)kmalloc(num_pixels * sizeof(uint32_t));
+  uint32_t* last = (uint32_t*)kmalloc(num_pixels * sizeof(uint32_t));
+  uint32_t* dest = (uint32_t*)kmalloc(num_pixels * sizeof(uint32_t));
+  for (size_t i = 0; i < num_pixels; i++) {
+    src[i] = i;
+  }
+
+  // Full screen sync where every pixel is changed, and then where nothing is
+  // changed (which is what most of the screen looks like usually).
+  constexpr int kNumRun = 10;
+  for (int use_simd = 0; use_simd < 2; use_simd++) {
+    uint64_t changed_cycles = 0;
+    uint64_t unchanged_cycles = 0;
+    for (int run = 0; run < kNumRun; run++) {
+      KernelSimd::Fill32Scalar(last, 0xFFFFFFFF, num_pixels);
+
+      uint64_t start = CPURegsAccessProvider::ReadTimeStampCounter();
+      if (use_simd) {
+        KernelSimd::CompareAndCopy32(dest, last, src, num_pixels);
+      } else {
+        KernelSimd::CompareAndCopy32Scalar(dest, last, src, num_pixels);
+      }
+      uint64_t mid = CPURegsAccessProvider::ReadTimeStampCounter();
+      if (use_simd) {
+        KernelSimd::CompareAndCopy32(dest, last, src, num_pixels);
+      } else {
+        KernelSimd::CompareAndCopy32Scalar(dest, last, src, num_pixels);
+      }
+      uint64_t end = CPURegsAccessProvider::ReadTimeStampCounter();
+
+      changed_cycles += (mid - start);
+      unchanged_cycles += (end - mid);
+    }
+
+    kprintf("[%s] %dx%d sync : %lu cycles (all changed) %lu cycles (none)\n",
+            use_simd ? "SSE2" : "Scalar", width_, height_,
+            changed_cycles / kNumRun, unchanged_cycles / kNumRun);
+  }
+
+  kfree(src);
+  kfree(last);
+  kfree(dest);
+}
+
+void GraphicManager::BenchmarkGlyphs() {
+  // Draw glyphs over the scratch screen row, cycling through a few colors so
+  // that the atlas is exercised like the colored console output.
+  if (FontManager::GetFontManager().GetFont('!') == nullptr) {
+    kprintf("Font is not loaded\n");
+    return;
+  }
+
+  constexpr int kNumChars = 200000;
+  const Color colors[] = {0xFFFFFF, 0x00FF00, 0xFF00FF, 0x00FFFF};
+  const int chars_per_row = width_ / (font_width + font_margin_right);
+  uint32_t* scratch =
+      (uint32_t*)kmalloc(width_ * font_height * sizeof(uint32_t));
+
+  auto& timer = TimerManager::GetCurrentTimer();
+  for (int use_atlas = 0; use_atlas < 2; use_atlas++) {
+    // The atlas is shared with the console output, which uses it under the
+    // print lock.
+    if (use_atlas) {
+      PrintLock();
+    }
+
+    uint64_t start = timer.GetMsTick();
+    for (int n = 0; n < kNumChars; n++) {
+      int c = '!' + n % 94;
+      Color color = colors[(n / 94) % 4];
+      uint32_t* dest =
+          scratch + (n % chars_per_row) * (font_width + font_margin_right) + 1;
+
+      if (use_atlas) {
+        const uint32_t* tile = GlyphAtlas::GetGlyphAtlas().GetTile(c, color);
+        for (int i = 0; i < font_height; i++) {
+          CopyTileRow(dest + i * width_, tile + i * GlyphAtlas::kTileWidth);
+        }
+      } else {
+        char* font = FontManager::GetFontManager().GetFont(c);
+        GlyphAtlas::ExpandGlyph(font, color, dest, width_);
       }
     }
+    uint64_t elapsed = timer.GetMsTick() - start;
+    if (elapsed == 0) {
+      elapsed = 1;
+    }
+
+    if (use_atlas) {
+      PrintUnlock();
+    }
+
+    kprintf("[%s] %d chars in %lu ms : %lu chars/sec\n",
+            use_atlas ? "Atlas" : "Bitmap", kNumChars, elapsed,
+            kNumChars * 1000 / elapsed);
   }
-  is_synced_ = true;
+
+  kfree(scratch);
 }
 
 void GraphicManager::Backspace() {
@@ -245,10 +624,11 @@ void GraphicManager::Backspace() {
   // Erase Current line.
   for (int i = cur_row_; i < cur_row_ + font_height + font_margin_bottom; i++) {
     for (int j = cur_col_; j < cur_col_ + font_actual_width; j++) {
-      buffer_[i * width_ + j] = 0;
+      BufferRow(i)[j] = 0;
     }
   }
-  is_synced_ = false;
+  MarkDirty(cur_row_, cur_col_, font_height + font_margin_bottom,
+            font_actual_width);
 }
 
 void GraphicManager::PrintKeyStrokes(const std::vector<KeyStroke>& ks,
@@ -1,13 +1,17 @@
 #ifndef GRAPHIC_H
 #define GRAPHIC_H
 
+#include "../std/map.h"
 #include "../std/stdint.h"
 #include "../std/string_view.h"
+#include "../std/vector.h"
 #include "keyboard.h"
 #include "sync.h"
 
 namespace Kernel {
 
+class Process;
+
 void ParseMultibootInfo(void* multiboot_info);
 
 class GraphicManager {
@@ -47,6 +51,24 @@ class GraphicManager {
   void SyncScreenWith(uint32_t* buffer, FrameBufferInfo* info);
   void SyncScreen();
 
+  // Map the frame buffer that is shared with the kernel to the process. The
+  // process draws to it directly and PresentFrameBuffer() only asks the sync
+  // thread to put it on the screen, so there is no per frame copy from the
+  // user. Each process can have one. Returns the user address of the buffer
+  // or 0 on failure.
+  uint64_t MapFrameBuffer(Process* process, const FrameBufferInfo& info);
+  bool PresentFrameBuffer(int pid);
+
+  // Drop the kernel's reference of the frame buffer of the process (if any).
+  void ReleaseFrameBuffer(int pid);
+
+  // Measures the full screen compare-and-copy with and without SIMD.
+  void BenchmarkSync();
+
+  // Measures how many characters can be drawn per second with and without
+  // the glyph atlas.
+  void BenchmarkGlyphs();
+
   void PrintLock();
   void PrintUnlock();
 
@@ -62,10 +84,27 @@ class GraphicManager {
  private:
   GraphicManager() = default;
 
+  // Draw the character at the cursor without marking the screen dirty yet.
+  // FlushPendingSpan() must be called after.
+  void DrawChar(int c, Color color);
+
   void MoveCursor();
   void Scroll();
   void Backspace();
 
+  // Mark [row, row + height) x [col, col + width) of buffer_ as modified.
+  void MarkDirty(int row, int col, int height, int width);
+
+  // Characters drawn in the same line are collected in the pending span and
+  // marked dirty at once. Saves taking the dirty lock for every character.
+  void AddPendingSpan(int col, int width);
+  void FlushPendingSpan();
+
+  // Returns the start of the screen row in the ring buffer.
+  uint32_t* BufferRow(int row) const {
+    return buffer_ + ((row + row_offset_) % height_) * width_;
+  }
+
   bool is_ready_ = false;
 
   int width_;
@@ -81,8 +120,57 @@ class GraphicManager {
   uint32_t* last_sync_ = nullptr;
   bool is_synced_ = false;
 
-  // Current video buffer.
+  // Modified area of the buffer. Only this area is compared against
+  // last_sync_ when syncing.
+  struct DirtyRegion {
+    // Columns [col_begin[row], col_end[row]) of each row are dirty.
+    int* col_begin = nullptr;
+    int* col_end = nullptr;
+
+    // Only rows in [row_begin, row_end) can have the dirty columns.
+    int row_begin = 0;
+    int row_end = 0;
+
+    // Set when the screen is scrolled. Whole screen is copied from the ring.
+    bool is_scrolled = false;
+  };
+
+  // Region that is being marked by the printers, and the one that is being
+  // synced. Those are swapped at the start of the sync.
+  DirtyRegion dirty_;
+  DirtyRegion syncing_;
+  MultiCoreSpinLock dirty_lock_;
+
+  // [col_begin, col_end) of the text line at row that is drawn but not marked
+  // dirty yet.
+  struct PendingSpan {
+    int row = 0;
+    int col_begin = 0;
+    int col_end = 0;
+  };
+  PendingSpan pending_span_;
+
+  struct SharedFrameBuffer {
+    FrameBufferInfo info;
+
+    // Physical frames of the buffer. The kernel holds a reference of each.
+    std::vector<void*> frames;
+
+    // Frames mapped to the kernel VM.
+    uint32_t* kernel_addr;
+
+    // Set when the process presented the buffer and it is not synced yet.
+    bool is_presented;
+  };
+
+  // Maps pid to the shared frame buffer of the process.
+  std::map<int, SharedFrameBuffer*> shared_buffers_;
+  MultiCoreSpinLock shared_buffer_lock_;
+
+  // Current video buffer. This is a ring of rows; the screen row 0 is at the
+  // row_offset_ th row of the buffer. Scrolling just moves the offset.
   uint32_t* buffer_ = nullptr;
+  int row_offset_ = 0;
 
   // Location of the current cursor.
   int cur_row_;
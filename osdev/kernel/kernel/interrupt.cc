@@ -10,6 +10,7 @@
 #include "qemu_log.h"
 #include "scheduler.h"
 #include "timer.h"
+#include "tlb_shootdown.h"
 #include "vga_output.h"
 
 #define INTERRUPT_GATE_32_BIT (0b01110)
@@ -196,6 +197,15 @@ __attribute__((interrupt)) void ATAHandler(CPUInterruptHandlerArgs* args) {
   }
 }
 
+// Other core changed the page table that this core might be using.
+__attribute__((interrupt)) void TLBShootdownIPIHandler(
+    CPUInterruptHandlerArgs* args) {
+  UNUSED(args);
+
+  TLBShootdownManager::GetTLBShootdownManager().HandleShootdown();
+  APICManager::GetAPICManager().SetEndOfInterrupt();
+}
+
 __attribute__((interrupt)) void HPETInterruptHandler(
     CPUInterruptHandlerArgs* args) {
   UNUSED(args);
@@ -296,6 +306,12 @@ void IDTManager::InitializeCustomInterrupt() {
   // From 0x30 ~, we can use our own IRQs.
   InstallIDTEntry(CustomContextSwitchInterruptHandler,
                   {INTERRUPT_GATE_32_BIT, 0, 1}, 0x30);
+
+  // Inter processor interrupts.
+  InstallIDTEntry(RescheduleIPIHandler, {INTERRUPT_GATE_32_BIT, 0, 1},
+                  kRescheduleIPIVector);
+  InstallIDTEntry(TLBShootdownIPIHandler, {INTERRUPT_GATE_32_BIT, 0, 1},
+                  kTLBShootdownIPIVector);
 }
 
 void IDTManager::DisablePIC() {
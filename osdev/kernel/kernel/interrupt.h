@@ -72,6 +72,7 @@ struct InterruptHandlerSavedRegs {
 
 extern "C" void TimerInterruptHandler();
 extern "C" void CustomContextSwitchInterruptHandler();
+extern "C" void RescheduleIPIHandler();
 extern "C" void PageFaultInterruptHandler();
 
 #endif
@@ -0,0 +1,357 @@
+#include "io_ring.h"
+
+#include "./fs/actual_file_desc.h"
+#include "frame_allocator.h"
+#include "kthread.h"
+#include "paging.h"
+#include "pipe.h"
+#include "process.h"
+#include "qemu_log.h"
+#include "scheduler.h"
+#include "vm_area.h"
+#include "zeroed_frame_pool.h"
+
+namespace Kernel {
+namespace {
+
+constexpr uint64_t kFourKB = (1 << 12);
+
+uint64_t RoundUpToFourKB(uint64_t sz) {
+  return (sz + kFourKB - 1) & ~(kFourKB - 1);
+}
+
+uint32_t LoadIndex(const uint32_t* index) {
+  return __atomic_load_n(index, __ATOMIC_ACQUIRE);
+}
+
+void StoreIndex(uint32_t* index, uint32_t value) {
+  __atomic_store_n(index, value, __ATOMIC_RELEASE);
+}
+
+}  // namespace
+
+void IORingManager::Init() {
+  KernelThread* worker_thread =
+      new KernelThread([] { IORingManager::GetIORingManager().Run(); });
+  worker_thread->Start();
+}
+
+uint64_t IORingManager::Setup(Process* process, uint32_t num_entries,
+                              uint64_t buf_size) {
+  if (num_entries == 0 || num_entries > kMaxEntries ||
+      (num_entries & (num_entries - 1)) != 0 || buf_size > kMaxBufferSize) {
+    return 0;
+  }
+
+  {
+    std::lock_guard<MultiCoreSpinLock> lk(rings_lock_);
+    if (rings_.find(process->Id()) != rings_.end()) {
+      return 0;
+    }
+  }
+
+  // [Header][Submissions][Completions] ... [Buffer]
+  const uint32_t sq_offset = sizeof(IORingHeader);
+  const uint32_t cq_offset = sq_offset + sizeof(IORingSubmission) * num_entries;
+  const uint32_t buf_offset = RoundUpToFourKB(
+      cq_offset + sizeof(IORingCompletion) * num_entries);
+  buf_size = RoundUpToFourKB(buf_size);
+  const uint64_t size = buf_offset + buf_size;
+
+  VMAreaTree& vm_areas = process->GetVMAreaTree();
+  uint64_t start =
+      vm_areas.FindFreeRange(size, Process::kUserProcessMmapStartAddress,
+                             Process::kUserProcessMmapEndAddress);
+  if (start == 0) {
+    return 0;
+  }
+  if (!vm_areas.AddArea(VMArea{start, start + size, VMArea::IO_RING,
+                               VMArea::kProtRead | VMArea::kProtWrite, 0, 0})) {
+    return 0;
+  }
+
+  IORing* ring = new IORing;
+  ring->process = process;
+  ring->num_entries = num_entries;
+  ring->buf_size = buf_size;
+  ring->sq_head = 0;
+  ring->cq_tail = 0;
+  ring->num_pending = 0;
+  ring->in_use = false;
+  ring->waiting = false;
+
+  auto& page_table_manager = PageTableManager::GetPageTableManager();
+  for (uint64_t offset = 0; offset < size; offset += kFourKB) {
+    void* frame = ZeroedFramePool::GetZeroedFramePool().AllocateZeroedFrame();
+
+    // One reference for the kernel and one for the page table.
+    UserFrameAllocator::GetPhysicalFrameAllocator().ShareFrame(frame);
+    page_table_manager.MapSharedPage(process->GetPageTableBaseAddress(),
+                                     start + offset, frame);
+    ring->frames.push_back(frame);
+  }
+  ring->kernel_addr = page_table_manager.MapFramesToKernel(
+      &ring->frames[0], ring->frames.size());
+
+  char* base = static_cast<char*>(ring->kernel_addr);
+  ring->header = reinterpret_cast<IORingHeader*>(base);
+  ring->sq = reinterpret_cast<IORingSubmission*>(base + sq_offset);
+  ring->cq = reinterpret_cast<IORingCompletion*>(base + cq_offset);
+  ring->buf = base + buf_offset;
+
+  ring->header->num_entries = num_entries;
+  ring->header->sq_offset = sq_offset;
+  ring->header->cq_offset = cq_offset;
+  ring->header->buf_offset = buf_offset;
+  ring->header->buf_size = buf_size;
+
+  {
+    std::lock_guard<MultiCoreSpinLock> lk(rings_lock_);
+    rings_[process->Id()] = ring;
+  }
+  work_sema_.Up();
+
+  QemuSerialLog::Logf("[pid:%d] IO ring [%lx, %lx) \n", process->Id(), start,
+                      start + size);
+  return start;
+}
+
+int IORingManager::Wait(int pid, uint32_t min_complete) {
+  IORing* ring = nullptr;
+  {
+    std::lock_guard<MultiCoreSpinLock> lk(rings_lock_);
+    auto itr = rings_.find(pid);
+    if (itr == rings_.end()) {
+      return -1;
+    }
+    ring = itr->second;
+  }
+
+  // Let the worker pick up the new submissions.
+  work_sema_.Up();
+
+  // Only the process itself can release the ring, so it is safe to use it
+  // without the lock.
+  IORingHeader* header = ring->header;
+  while (true) {
+    // Mark before checking so that the worker that makes the progress after
+    // the check always wakes us up.
+    __atomic_store_n(&ring->waiting, true, __ATOMIC_SEQ_CST);
+
+    uint32_t num_ready =
+        LoadIndex(&ring->cq_tail) - LoadIndex(&header->cq_head);
+    if (num_ready >= min_complete) {
+      break;
+    }
+
+    // The worker consumes the submission only after it is completed (or
+    // becomes pending), so nothing is in flight if both are empty.
+    if (LoadIndex(&ring->sq_head) == LoadIndex(&header->sq_tail) &&
+        LoadIndex(&ring->num_pending) == 0) {
+      break;
+    }
+
+    ring->completion_sema.Down();
+  }
+
+  __atomic_store_n(&ring->waiting, false, __ATOMIC_SEQ_CST);
+  return LoadIndex(&ring->cq_tail) - LoadIndex(&header->cq_head);
+}
+
+void IORingManager::Release(int pid) {
+  IORing* ring = nullptr;
+  {
+    std::lock_guard<MultiCoreSpinLock> lk(rings_lock_);
+    auto itr = rings_.find(pid);
+    if (itr == rings_.end()) {
+      return;
+    }
+    ring = itr->second;
+    rings_.erase(itr);
+  }
+
+  // The worker may still be running the submissions of the ring.
+  while (true) {
+    {
+      std::lock_guard<MultiCoreSpinLock> lk(rings_lock_);
+      if (!ring->in_use) {
+        break;
+      }
+    }
+    KernelThreadScheduler::GetKernelThreadScheduler().Yield();
+  }
+
+  PageTableManager::GetPageTableManager().UnmapFrameFromKernel(
+      ring->kernel_addr, ring->frames.size() * kFourKB);
+  for (void* frame : ring->frames) {
+    UserFrameAllocator::GetPhysicalFrameAllocator().FreeFrame(frame);
+  }
+  delete ring;
+}
+
+void IORingManager::Run() {
+  bool has_pending = false;
+  while (true) {
+    // The pipe submissions that would have blocked are retried until they are
+    // done. Otherwise sleep until there is something new.
+    if (has_pending) {
+      KernelThreadScheduler::GetKernelThreadScheduler().Yield();
+    } else {
+      work_sema_.Down();
+    }
+
+    std::vector<IORing*> rings;
+    {
+      std::lock_guard<MultiCoreSpinLock> lk(rings_lock_);
+      for (auto itr = rings_.begin(); itr != rings_.end(); ++itr) {
+        itr->second->in_use = true;
+        rings.push_back(itr->second);
+      }
+    }
+
+    has_pending = false;
+    for (IORing* ring : rings) {
+      has_pending |= RunRing(ring);
+    }
+
+    if (!rings.empty()) {
+      std::lock_guard<MultiCoreSpinLock> lk(rings_lock_);
+      for (IORing* ring : rings) {
+        ring->in_use = false;
+      }
+    }
+  }
+}
+
+bool IORingManager::RunRing(IORing* ring) {
+  // Retry the ones that would have blocked.
+  for (auto itr = ring->pending.begin(); itr != ring->pending.end();) {
+    int64_t result;
+    if (!RunSubmission(ring, *itr, &result)) {
+      ++itr;
+      continue;
+    }
+    Complete(ring, itr->user_data, result);
+    itr = ring->pending.erase(itr);
+    StoreIndex(&ring->num_pending, ring->pending.size());
+  }
+
+  IORingHeader* header = ring->header;
+  const uint32_t mask = ring->num_entries - 1;
+
+  // Do not trust sq_tail too much; run at most one ring worth of submissions
+  // at a time.
+  const uint32_t sq_tail = LoadIndex(&header->sq_tail);
+  for (uint32_t i = 0; i < ring->num_entries && ring->sq_head != sq_tail;
+       i++) {
+    // Every consumed submission must have a room in the completion queue.
+    uint32_t num_completions = ring->cq_tail - LoadIndex(&header->cq_head);
+    if (num_completions + ring->pending.size() >= ring->num_entries) {
+      break;
+    }
+
+    // The user can change the entry anytime. Use the copy.
+    IORingSubmission submission = ring->sq[ring->sq_head & mask];
+
+    int64_t result;
+    if (RunSubmission(ring, submission, &result)) {
+      Complete(ring, submission.user_data, result);
+    } else {
+      ring->pending.push_back(submission);
+      StoreIndex(&ring->num_pending, ring->pending.size());
+    }
+
+    StoreIndex(&ring->sq_head, ring->sq_head + 1);
+    StoreIndex(&header->sq_head, ring->sq_head);
+  }
+
+  // Wake up the process to check the progress.
+  if (__atomic_exchange_n(&ring->waiting, false, __ATOMIC_SEQ_CST)) {
+    ring->completion_sema.Up();
+  }
+
+  return !ring->pending.empty();
+}
+
+bool IORingManager::RunSubmission(IORing* ring,
+                                  const IORingSubmission& submission,
+                                  int64_t* result) {
+  *result = -1;
+  if (submission.count > ring->buf_size ||
+      submission.buf_offset > ring->buf_size - submission.count) {
+    return true;
+  }
+
+  // The process may close the fd meanwhile.
+  FileDescriptor* desc =
+      ring->process->GetFileDescriptorTable().GetDescriptorRef(submission.fd);
+  if (desc == nullptr) {
+    return true;
+  }
+
+  bool done = RunSubmissionOnDescriptor(ring, desc, submission, result);
+  desc->Unref();
+  return done;
+}
+
+bool IORingManager::RunSubmissionOnDescriptor(
+    IORing* ring, FileDescriptor* desc, const IORingSubmission& submission,
+    int64_t* result) {
+  char* buf = ring->buf + submission.buf_offset;
+  switch (desc->GetDescriptorType()) {
+    case FileDescriptor::ACTUAL_FILE: {
+      ActualFileDescriptor* actual_file_desc =
+          static_cast<ActualFileDescriptor*>(desc);
+      if (submission.op == IORingSubmission::READ) {
+        *result = actual_file_desc->Read(buf, submission.count);
+      } else if (submission.op == IORingSubmission::WRITE) {
+        *result = actual_file_desc->Write(buf, submission.count);
+      } else if (submission.op == IORingSubmission::PREAD &&
+                 submission.offset >= 0) {
+        // Must not move the offset that the process is using.
+        *result =
+            actual_file_desc->ReadAt(buf, submission.count, submission.offset);
+      }
+      return true;
+    }
+    case FileDescriptor::PIPE_READ: {
+      if (submission.op != IORingSubmission::READ) {
+        return true;
+      }
+      int actually_read = static_cast<PipeDescriptorReadEnd*>(desc)->TryRead(
+          buf, submission.count);
+      if (actually_read < 0) {
+        return false;
+      }
+      *result = actually_read;
+      return true;
+    }
+    case FileDescriptor::PIPE_WRITE: {
+      if (submission.op != IORingSubmission::WRITE) {
+        return true;
+      }
+      int written = static_cast<PipeDescriptorWriteEnd*>(desc)->TryWrite(
+          buf, submission.count);
+      if (written < 0) {
+        return false;
+      }
+      *result = written;
+      return true;
+    }
+    default:
+      return true;
+  }
+}
+
+void IORingManager::Complete(IORing* ring, uint64_t user_data,
+                             int64_t result) {
+  IORingCompletion& completion =
+      ring->cq[ring->cq_tail & (ring->num_entries - 1)];
+  completion.user_data = user_data;
+  completion.result = result;
+
+  StoreIndex(&ring->cq_tail, ring->cq_tail + 1);
+  StoreIndex(&ring->header->cq_tail, ring->cq_tail);
+}
+
+}  // namespace Kernel
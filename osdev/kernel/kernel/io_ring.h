@@ -0,0 +1,151 @@
+#ifndef IO_RING_H
+#define IO_RING_H
+
+#include "../std/map.h"
+#include "../std/types.h"
+#include "../std/vector.h"
+#include "semaphore.h"
+#include "sync.h"
+
+namespace Kernel {
+
+class FileDescriptor;
+class Process;
+
+// Header of the ring memory that is shared with the user process.
+// user/libc/syscall.h has the same structs.
+//
+// The user adds submissions at sq_tail and the kernel consumes them at
+// sq_head. The kernel adds completions at cq_tail and the user reaps them at
+// cq_head. Indices grow monotonically and are masked by (num_entries - 1).
+struct IORingHeader {
+  uint32_t sq_head;
+  uint32_t sq_tail;
+  uint32_t cq_head;
+  uint32_t cq_tail;
+  uint32_t num_entries;
+
+  // Offsets from the start of the ring memory.
+  uint32_t sq_offset;
+  uint32_t cq_offset;
+  uint32_t buf_offset;
+  uint64_t buf_size;
+};
+
+struct IORingSubmission {
+  // Same as the ops of IOBatchOp.
+  enum Op { READ = 0, WRITE = 1, PREAD = 2 };
+
+  int32_t op;
+  int32_t fd;
+
+  // Data is read to (or written from) [buf_offset, buf_offset + count) of the
+  // buffer area of the ring. The kernel cannot access the rest of the user
+  // memory from the worker thread.
+  uint64_t buf_offset;
+  uint64_t count;
+
+  // Only used by PREAD.
+  int64_t offset;
+
+  // Copied to the completion as is.
+  uint64_t user_data;
+};
+
+struct IORingCompletion {
+  uint64_t user_data;
+
+  // Same as what the read (or write) syscall would return. -1 if the
+  // submission is not valid.
+  int64_t result;
+};
+
+// Asynchronous I/O of the user processes. Each process can have one ring and
+// the submissions are run by the kernel worker thread, so the process can keep
+// many reads in flight and reap the completions without the syscall.
+//
+// The worker sleeps while there is nothing to do. It picks up the new
+// submissions when the process enters the ring (See Wait()).
+class IORingManager {
+ public:
+  static constexpr uint32_t kMaxEntries = 256;
+  static constexpr uint64_t kMaxBufferSize = (1 << 20);
+
+  static IORingManager& GetIORingManager() {
+    static IORingManager io_ring_manager;
+    return io_ring_manager;
+  }
+
+  // Starts the worker thread.
+  void Init();
+
+  // Creates the ring of the process and maps it to the mmap area. num_entries
+  // must be a power of 2. Returns the user address of the ring (0 on failure).
+  uint64_t Setup(Process* process, uint32_t num_entries, uint64_t buf_size);
+
+  // Wakes up the worker to run the submissions and sleeps until there are at
+  // least min_complete completions to reap, or until every submission is done.
+  // Returns the number of completions to reap (-1 if the process does not have
+  // the ring).
+  int Wait(int pid, uint32_t min_complete);
+
+  // Called when the process is terminated. Waits until the worker is done
+  // with the ring.
+  void Release(int pid);
+
+ private:
+  struct IORing {
+    Process* process;
+
+    IORingHeader* header;
+    IORingSubmission* sq;
+    IORingCompletion* cq;
+    char* buf;
+
+    // The user can change the header anytime, so the kernel keeps its own
+    // copy of the fields that it owns.
+    uint32_t num_entries;
+    uint64_t buf_size;
+    uint32_t sq_head;
+    uint32_t cq_tail;
+
+    // Pipe submissions that would have blocked. Retried later.
+    std::vector<IORingSubmission> pending;
+    uint32_t num_pending;
+
+    // Set while the worker is running the submissions of the ring.
+    bool in_use;
+
+    // Set while the process sleeps on completion_sema in Wait().
+    bool waiting;
+    Semaphore completion_sema{0};
+
+    std::vector<void*> frames;
+    void* kernel_addr;
+  };
+
+  IORingManager() = default;
+
+  void Run();
+
+  // Returns true if the ring has the pending submissions to retry.
+  bool RunRing(IORing* ring);
+
+  // Returns false if it would block.
+  bool RunSubmission(IORing* ring, const IORingSubmission& submission,
+                     int64_t* result);
+  bool RunSubmissionOnDescriptor(IORing* ring, FileDescriptor* desc,
+                                 const IORingSubmission& submission,
+                                 int64_t* result);
+  void Complete(IORing* ring, uint64_t user_data, int64_t result);
+
+  std::map<int, IORing*> rings_;
+  MultiCoreSpinLock rings_lock_;
+
+  // Posted when there may be a new submission to run.
+  Semaphore work_sema_{0};
+};
+
+}  // namespace Kernel
+
+#endif
@@ -0,0 +1,118 @@
+#include "kernel_simd.h"
+
+#include "cpu.h"
+#include "cpu_context.h"
+#include "kmalloc.h"
+
+namespace Kernel {
+namespace {
+
+// Set when any CPU has enabled SSE. Before this, the CPU context may not even
+// exist so it should not be looked up.
+bool simd_enabled = false;
+
+}  // namespace
+
+KernelSimdGuard::KernelSimdGuard()
+    : saved_rflags_(0), interrupt_disabled_(false), can_use_simd_(false) {
+  if (!simd_enabled) {
+    return;
+  }
+
+  // Must not be switched to other thread (or moved to other CPU) while using
+  // the XMM registers.
+  saved_rflags_ = CPURegsAccessProvider::GetRFlags();
+  CPURegsAccessProvider::DisableInterrupt();
+  interrupt_disabled_ = true;
+
+  CPUContext* context = CPUContextManager::GetCPUContextManager().GetCPUContext();
+  if (!context->simd_ready || context->simd_in_use) {
+    return;
+  }
+
+  context->simd_in_use = true;
+  __builtin_ia32_fxsave(context->simd_save_region);
+  can_use_simd_ = true;
+}
+
+KernelSimdGuard::~KernelSimdGuard() {
+  if (!interrupt_disabled_) {
+    return;
+  }
+
+  if (can_use_simd_) {
+    CPUContext* context =
+        CPUContextManager::GetCPUContextManager().GetCPUContext();
+    __builtin_ia32_fxrstor(context->simd_save_region);
+    context->simd_in_use = false;
+  }
+
+  CPURegsAccessProvider::SetRFlags(saved_rflags_);
+}
+
+void KernelSimdGuard::EnableForCurrentCPU() {
+  CPUContext* context = CPUContextManager::GetCPUContextManager().GetCPUContext();
+  if (context->simd_ready) {
+    return;
+  }
+
+  // fxsave requires 16 byte aligned 512 bytes.
+  context->simd_save_region = kaligned_alloc(16, 512);
+  context->simd_in_use = false;
+  context->simd_ready = true;
+  simd_enabled = true;
+}
+
+void KernelSimd::Copy(void* dest, const void* src, size_t bytes) {
+  KernelSimdGuard guard;
+  if (guard.CanUseSimd()) {
+    SimdCopy(dest, src, bytes);
+  } else {
+    CopyScalar(dest, src, bytes);
+  }
+}
+
+void KernelSimd::Fill32(uint32_t* dest, uint32_t value, size_t count) {
+  KernelSimdGuard guard;
+  if (guard.CanUseSimd()) {
+    SimdFill32(dest, value, count);
+  } else {
+    Fill32Scalar(dest, value, count);
+  }
+}
+
+void KernelSimd::CompareAndCopy32(uint32_t* dest, uint32_t* last,
+                                  const uint32_t* src, size_t count) {
+  KernelSimdGuard guard;
+  if (guard.CanUseSimd()) {
+    SimdCompareAndCopy32(dest, last, src, count);
+  } else {
+    CompareAndCopy32Scalar(dest, last, src, count);
+  }
+}
+
+void KernelSimd::CopyScalar(void* dest, const void* src, size_t bytes) {
+  const char* s = reinterpret_cast<const char*>(src);
+  char* d = reinterpret_cast<char*>(dest);
+  while (bytes-- > 0) {
+    *d++ = *s++;
+  }
+}
+
+void KernelSimd::Fill32Scalar(uint32_t* dest, uint32_t value, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    dest[i] = value;
+  }
+}
+
+void KernelSimd::CompareAndCopy32Scalar(uint32_t* dest, uint32_t* last,
+                                        const uint32_t* src, size_t count) {
+  for (size_t i = 0; i < count; i++) {
+    if (last[i] != src[i]) {
+      last[i] = src[i];
+      dest[i] = src[i];
+    }
+  }
+}
+
+}  // namespace Kernel
@@ -0,0 +1,62 @@
+#ifndef KERNEL_SIMD_H
+#define KERNEL_SIMD_H
+
+#include "../std/types.h"
+
+namespace Kernel {
+
+// The kernel is built with -mgeneral-regs-only, so XMM registers normally hold
+// the state of the user process that is running on the CPU. KernelSimdGuard
+// saves them to the per-CPU region and disables the interrupt so that the
+// kernel can use them within the scope.
+//
+// SIMD is not available if the CPU has not enabled SSE yet, or if the guard is
+// already taken on this CPU. Callers must fall back to the scalar code then.
+//
+// NOTE Never touch the user memory within the guard. The page fault handler
+// can reschedule the thread.
+class KernelSimdGuard {
+ public:
+  KernelSimdGuard();
+  ~KernelSimdGuard();
+
+  bool CanUseSimd() const { return can_use_simd_; }
+
+  // Called on each CPU after SSE is enabled.
+  static void EnableForCurrentCPU();
+
+ private:
+  uint64_t saved_rflags_;
+
+  // Whether the interrupt is disabled by this guard.
+  bool interrupt_disabled_;
+  bool can_use_simd_;
+};
+
+// SSE2 routines (kernel_simd_asm.S). Must be called within KernelSimdGuard.
+extern "C" void SimdCopy(void* dest, const void* src, size_t bytes);
+extern "C" void SimdFill32(uint32_t* dest, uint32_t value, size_t count);
+
+// Copy src[i] to both dest[i] and last[i] if src[i] != last[i].
+extern "C" void SimdCompareAndCopy32(uint32_t* dest, uint32_t* last,
+                                     const uint32_t* src, size_t count);
+
+// Uses SIMD routines if possible and falls back to scalar loops otherwise.
+// Only kernel memory should be passed.
+class KernelSimd {
+ public:
+  static void Copy(void* dest, const void* src, size_t bytes);
+  static void Fill32(uint32_t* dest, uint32_t value, size_t count);
+  static void CompareAndCopy32(uint32_t* dest, uint32_t* last,
+                               const uint32_t* src, size_t count);
+
+  // Scalar versions.
+  static void CopyScalar(void* dest, const void* src, size_t bytes);
+  static void Fill32Scalar(uint32_t* dest, uint32_t value, size_t count);
+  static void CompareAndCopy32Scalar(uint32_t* dest, uint32_t* last,
+                                     const uint32_t* src, size_t count);
+};
+
+}  // namespace Kernel
+
+#endif
@@ -3,6 +3,7 @@
 #include "./fs/ext2.h"
 #include "acpi.h"
 #include "apic.h"
+#include "clock_page.h"
 #include "console.h"
 #include "cpu.h"
 #include "cpu_context.h"
@@ -11,6 +12,7 @@
 #include "fpu.h"
 #include "graphic.h"
 #include "interrupt.h"
+#include "io_ring.h"
 #include "kthread.h"
 #include "paging.h"
 #include "printf.h"
@@ -21,6 +23,7 @@
 #include "syscall.h"
 #include "timer.h"
 #include "vga_output.h"
+#include "zeroed_frame_pool.h"
 
 using namespace Kernel;
 
@@ -117,6 +120,7 @@ void KernelMain(void* multiboot_info) {
 
   // Create per-core scheduling queue.
   KernelThreadScheduler::GetKernelThreadScheduler().SetCoreCount(num_cores);
+  SyscallManager::GetSyscallManager().SetCoreCount(num_cores);
 
   auto& timer_manager = TimerManager::GetTimerManager();
 
@@ -175,6 +179,8 @@ void KernelMain(void* multiboot_info) {
   apic_manager.RedirectIRQs(0xE, 0);
   apic_manager.RedirectIRQs(0xF, 0);
 
+  // Must be ready before the calibration so that it can be published.
+  ClockPage::GetClockPage().Init();
   timer_manager.Calibrate();
 
   auto& ata_driver = ATADriver::GetATADriver();
@@ -215,12 +221,16 @@ void KernelMain(void* multiboot_info) {
   auto* process = process_manager.CreateProcess("/hello");
   process->Start();
   */
+  ZeroedFramePool::GetZeroedFramePool().Init();
+  IORingManager::GetIORingManager().Init();
+
   KernelConsole::InitKernelConsole();
   // VGAOutput::GetVGAOutput().ClearScreen();
 
   KernelConsole::GetKernelConsole().ShowWelcome();
 
   while (1) {
+    ZeroedFramePool::RefillIfIdle();
     KernelThreadScheduler::GetKernelThreadScheduler().Yield();
   }
 }
@@ -287,6 +297,7 @@ void KernelMainForAP(uint32_t cpu_context_lo, uint32_t cpu_context_hi) {
   */
   // volatile uint64_t k = 0;
   while (1) {
+    ZeroedFramePool::RefillIfIdle();
     KernelThreadScheduler::GetKernelThreadScheduler().Yield();
     // void* data = kmalloc(1 << 12);
     /*
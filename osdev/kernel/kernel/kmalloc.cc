@@ -125,6 +125,8 @@ KernelMemoryManager kernel_memory_manager;
 
 uint8_t* KernelMemoryManager::GetMemoryFromBucket(int bucket_index,
                                                   uint32_t bytes) {
+  num_allocations_++;
+
   // Find if there is available free chunk of memory.
   for (int i = bucket_index; i < NUM_BUCKETS; i++) {
     auto free_chunk_offset = IterateFreeList(free_list_[i], bytes);
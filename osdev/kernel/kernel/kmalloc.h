@@ -25,6 +25,7 @@ class KernelMemoryManager {
         heap_memory_limit_(ONE_GB - KERNEL_HEAP_MEMORY_START_OFFSET -
                            MEMORY_ALGIN_OFFSET),
         current_heap_size_(8 /* Added initial offset*/),
+        num_allocations_(0),
         heap_lock_(1),
         multi_core_lock_("MemLock") {
     for (int i = 0; i < NUM_BUCKETS; i++) {
@@ -45,6 +46,12 @@ class KernelMemoryManager {
 
   void ShowDebugInfo() const;
 
+  // Number of kmalloc calls so far. Used to check that the hot paths do not
+  // allocate.
+  size_t GetNumAllocations() const {
+    return __atomic_load_n(&num_allocations_, __ATOMIC_RELAXED);
+  }
+
   // Resets entire heap allocation. All the previously allocated memory will be
   // unusable. ONLY USE THIS FOR TESTING PURPOSES!
   void Reset();
@@ -94,6 +101,8 @@ class KernelMemoryManager {
   // Current end of heap.
   uint32_t current_heap_size_;
 
+  size_t num_allocations_;
+
   // Buckets for 2^3, 2^4, ..., 2^18 bytes, total of 16 buckets.
   // Each bucket contains the offset to the available memory chunk.
   uint32_t free_list_[NUM_BUCKETS];
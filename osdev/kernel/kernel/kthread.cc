@@ -89,7 +89,8 @@ KernelThread::KernelThread(EntryFuncType entry_function, bool need_stack,
       status_(THREAD_RUN),
       kernel_list_elem_(&KernelThreadScheduler::GetKernelThreadList()),
       in_queue_(false),
-      in_same_cpu_id_(in_same_cpu_id) {
+      in_same_cpu_id_(in_same_cpu_id),
+      next_in_inbox_(nullptr) {
   thread_id_ = ThreadIdManager::GetThreadId();
 
   // The rip of this function will be entry_function.
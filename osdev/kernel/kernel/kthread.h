@@ -106,8 +106,22 @@ class KernelThread {
     return "";
   }
 
-  void SetInQueue(bool in_queue) { in_queue_ = in_queue; }
-  bool IsInQueue() const { return in_queue_; }
+  void SetInQueue(bool in_queue) {
+    __atomic_store_n(&in_queue_, in_queue, __ATOMIC_RELEASE);
+  }
+  bool IsInQueue() const {
+    return __atomic_load_n(&in_queue_, __ATOMIC_ACQUIRE);
+  }
+
+  // Marks the thread as in queue. Returns false if someone else already did.
+  bool TryMarkInQueue() {
+    bool expected = false;
+    return __atomic_compare_exchange_n(&in_queue_, &expected, true, false,
+                                       __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+  }
+
+  KernelThread* NextInInbox() const { return next_in_inbox_; }
+  void SetNextInInbox(KernelThread* next) { next_in_inbox_ = next; }
 
   virtual bool IsKernelThread() const { return true; }
   virtual bool IsInKernelSpace() const { return true; }
@@ -144,6 +158,9 @@ class KernelThread {
   bool in_same_cpu_id_;
 
   ThreadStatus status_before_sleep_;
+
+  // Next thread in the ThreadInbox.
+  KernelThread* next_in_inbox_;
 };
 
 }  // namespace Kernel
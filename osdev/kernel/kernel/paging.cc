@@ -4,6 +4,7 @@
 #include "../std/printf.h"
 #include "../std/utility.h"
 #include "./fs/ext2.h"
+#include "./fs/page_cache.h"
 #include "cpu.h"
 #include "cpu_context.h"
 #include "descriptor_table.h"
@@ -15,7 +16,9 @@
 #include "process.h"
 #include "qemu_log.h"
 #include "scheduler.h"
+#include "tlb_shootdown.h"
 #include "vga_output.h"
+#include "zeroed_frame_pool.h"
 
 namespace Kernel {
 namespace {
@@ -37,6 +40,18 @@ constexpr size_t kPDTableEntryNum = 512;
 constexpr uint64_t kPageTableAddressSizePerEntry = (1LL << 12);
 constexpr size_t kPageTableEntryNum = 512;
 
+// Page fault error code.
+constexpr uint64_t kPageFaultPresent = 0x1;
+constexpr uint64_t kPageFaultWrite = 0x2;
+
+// Bit 9 ~ 11 of the page table entry are free to use by the OS. We use bit 9 to
+// mark the read only page that should be copied on write.
+constexpr uint64_t kCopyOnWriteBit = (1 << 9);
+
+// Bit 10 marks the writable page that is shared on purpose (e.g with the
+// kernel). It stays writable (and shared) on fork.
+constexpr uint64_t kSharedBit = (1 << 10);
+
 void SetPresent(uint64_t* entry) { (*entry) |= 1; }
 void SetFree(uint64_t* entry) { (*entry) &= (0xFFFFFFFF'FFFFFFFELL); }
 
@@ -44,6 +59,18 @@ bool IsPresent(uint64_t entry) { return entry & 1; }
 bool IsUserAccessible(uint64_t entry) { return entry & 0x4; }
 
 void SetReadWrite(uint64_t* entry) { (*entry) |= 0x2; }
+void SetReadOnly(uint64_t* entry) { (*entry) &= ~0x2ULL; }
+bool IsReadWrite(uint64_t entry) { return entry & 0x2; }
+
+// PS bit of the page directory entry. If set, the entry maps the 2MB page.
+bool IsHugePage(uint64_t entry) { return entry & 0x80; }
+void SetHugePage(uint64_t* entry) { (*entry) |= 0x80; }
+
+bool IsCopyOnWrite(uint64_t entry) { return entry & kCopyOnWriteBit; }
+void SetCopyOnWrite(uint64_t* entry) { (*entry) |= kCopyOnWriteBit; }
+
+bool IsShared(uint64_t entry) { return entry & kSharedBit; }
+void SetShared(uint64_t* entry) { (*entry) |= kSharedBit; }
 
 void SetUserAccessible(uint64_t* entry) { (*entry) |= 0x4; }
 
@@ -150,6 +177,20 @@ void CopyCPUInteruptHandlerArgs(T* to, U* from) {
   to->cs = from->cs;
 }
 
+// Take another reference of the frame that entry maps, so that it can be
+// mapped to the other page table. Writable page becomes copy on write unless
+// it is marked as shared.
+void* ShareUserPage(uint64_t* entry) {
+  if (IsReadWrite(*entry) && !IsShared(*entry)) {
+    SetReadOnly(entry);
+    SetCopyOnWrite(entry);
+  }
+
+  void* frame = GetBaseAddress(*entry);
+  UserFrameAllocator::GetPhysicalFrameAllocator().ShareFrame(frame);
+  return frame;
+}
+
 }  // namespace
 
 uint64_t* PageTable::CreateEmptyPageTable() const {
@@ -335,7 +376,8 @@ void PageTable::SetPT(uint64_t start_addr, uint64_t end_addr,
 }
 
 void PageTable::FreePML4E(uint64_t start_addr, uint64_t size,
-                          uint64_t* pml4e_base_addr) {
+                          uint64_t* pml4e_base_addr,
+                          ReleasedPages* released) {
   size_t offset_start = GetPML4Offset(start_addr);
   size_t offset_end = GetPML4Offset(start_addr + size - 1);
   uint64_t pml4_start_addr = GetPML4StartAddr(start_addr);
@@ -359,15 +401,18 @@ void PageTable::FreePML4E(uint64_t start_addr, uint64_t size,
                 pml4_start_addr + (delta + 1) * kPML4AddressSizePerEntry);
       }
 
-      if (FreePDPT(pdpt_start_addr, pdpt_end_addr, pdpt_base_addr)) {
+      if (FreePDPT(pdpt_start_addr, pdpt_end_addr, pdpt_base_addr,
+                   released)) {
         SetFree(&pml4e_base_addr[offset]);
+        ReleaseTable(pdpt_base_addr, released);
       }
     }
   }
 }
 
 bool PageTable::FreePDPT(uint64_t start_addr, uint64_t end_addr,
-                         uint64_t* pdpe_base_addr) {
+                         uint64_t* pdpe_base_addr,
+                         ReleasedPages* released) {
   size_t offset_start = GetPDPOffset(start_addr);
   size_t offset_end = GetPDPOffset(end_addr - 1);
   uint64_t pdpt_start_addr = GetPDPStartAddr(start_addr);
@@ -386,8 +431,9 @@ bool PageTable::FreePDPT(uint64_t start_addr, uint64_t end_addr,
       if (FreePDT(pdt_start_addr,
                   min(end_addr, pdpt_start_addr +
                                     (delta + 1) * kPDPTableAddressSizePerEntry),
-                  pdt_base_addr)) {
+                  pdt_base_addr, released)) {
         SetFree(&pdpe_base_addr[offset]);
+        ReleaseTable(pdt_base_addr, released);
       }
     }
   }
@@ -404,7 +450,8 @@ bool PageTable::FreePDPT(uint64_t start_addr, uint64_t end_addr,
 }
 
 bool PageTable::FreePDT(uint64_t start_addr, uint64_t end_addr,
-                        uint64_t* pdt_base_addr) {
+                        uint64_t* pdt_base_addr,
+                        ReleasedPages* released) {
   size_t offset_start = GetPDOffset(start_addr);
   size_t offset_end = GetPDOffset(end_addr - 1);
   uint64_t pdt_start_addr = GetPDStartAddr(start_addr);
@@ -412,19 +459,33 @@ bool PageTable::FreePDT(uint64_t start_addr, uint64_t end_addr,
   ASSERT((uint64_t)pdt_base_addr >= kKernelVirtualOffset);
 
   for (size_t offset = offset_start; offset <= offset_end; offset++) {
-    if (IsPresent(pdt_base_addr[offset])) {
+    int delta = offset - offset_start;
+    uint64_t huge_page_start =
+        pdt_start_addr + delta * kPDTableAddressSizePerEntry;
+
+    // If the range covers only the part of the 2MB page, the rest must stay
+    // mapped; split it into 4KB pages and free those in the range below.
+    if (IsPresent(pdt_base_addr[offset]) && IsHugePage(pdt_base_addr[offset]) &&
+        (start_addr > huge_page_start ||
+         end_addr < huge_page_start + kPDTableAddressSizePerEntry)) {
+      SplitHugePage(&pdt_base_addr[offset], released);
+    }
+
+    if (IsPresent(pdt_base_addr[offset]) && IsHugePage(pdt_base_addr[offset])) {
+      SetFree(&pdt_base_addr[offset]);
+      ReleaseFrame(GetBaseAddress(pdt_base_addr[offset]), released);
+    } else if (IsPresent(pdt_base_addr[offset])) {
       uint64_t* pt_base_addr =
           PhysToKernel<uint64_t*>(GetBaseAddress(pdt_base_addr[offset]));
-      int delta = offset - offset_start;
-      uint64_t pt_start_addr =
-          max(start_addr, pdt_start_addr + delta * kPDTableAddressSizePerEntry);
+      uint64_t pt_start_addr = max(start_addr, huge_page_start);
 
       // Set the next level page table.
       if (FreePT(pt_start_addr,
                  min(end_addr, pdt_start_addr +
                                    (delta + 1) * kPDTableAddressSizePerEntry),
-                 pt_base_addr)) {
+                 pt_base_addr, released)) {
         SetFree(&pdt_base_addr[offset]);
+        ReleaseTable(pt_base_addr, released);
       }
     }
   }
@@ -441,18 +502,22 @@ bool PageTable::FreePDT(uint64_t start_addr, uint64_t end_addr,
 }
 
 bool PageTable::FreePT(uint64_t start_addr, uint64_t end_addr,
-                       uint64_t* pt_base_addr) {
+                       uint64_t* pt_base_addr,
+                       ReleasedPages* released) {
   size_t offset_start = GetPTOffset(start_addr);
   size_t offset_end = GetPTOffset(end_addr - 1);
 
   ASSERT((uint64_t)pt_base_addr >= kKernelVirtualOffset);
 
   for (size_t offset = offset_start; offset <= offset_end; offset++) {
+    if (!IsPresent(pt_base_addr[offset])) {
+      continue;
+    }
+
     SetFree(&pt_base_addr[offset]);
 
-    // Free the physical frame.
-    uint64_t* frame_phys_addr = GetBaseAddress(pt_base_addr[offset]);
-    UserFrameAllocator::GetPhysicalFrameAllocator().FreeFrame(frame_phys_addr);
+    // Drop the reference of the physical frame.
+    ReleaseFrame(GetBaseAddress(pt_base_addr[offset]), released);
   }
 
   for (size_t i = 0; i < kPageTableEntryNum; i++) {
@@ -463,6 +528,111 @@ bool PageTable::FreePT(uint64_t start_addr, uint64_t end_addr,
   return true;
 }
 
+void PageTable::SplitHugePage(uint64_t* pdt_entry, ReleasedPages* released) {
+  auto& frame_allocator = UserFrameAllocator::GetPhysicalFrameAllocator();
+  auto& page_table_manager = PageTableManager::GetPageTableManager();
+
+  // The 2MB frame is one buddy block which can not be freed in part. Copy it
+  // to the separate 4KB frames instead.
+  std::vector<void*> frames;
+  frames.reserve(kPageTableEntryNum);
+  for (size_t i = 0; i < kPageTableEntryNum; i++) {
+    frames.push_back(frame_allocator.AllocateFrame(0));
+  }
+
+  uint64_t* huge_frame = GetBaseAddress(*pdt_entry);
+  void* from = page_table_manager.MapFrameToKernel(
+      huge_frame, kPDTableAddressSizePerEntry);
+  void* to =
+      page_table_manager.MapFramesToKernel(&frames[0], kPageTableEntryNum);
+  memcpy(to, from, kPDTableAddressSizePerEntry);
+  page_table_manager.UnmapFrameFromKernel(to, kPDTableAddressSizePerEntry);
+  page_table_manager.UnmapFrameFromKernel(from, kPDTableAddressSizePerEntry);
+
+  // Pages keep the protection (and the copy on write mark) of the huge page.
+  const uint64_t kNoExecuteBit = (1ULL << 63);
+  uint64_t flags =
+      (*pdt_entry & 0xFFF & ~0x80ULL) | (*pdt_entry & kNoExecuteBit);
+  uint64_t* pt_base_addr = CreateNewTable();
+  for (size_t i = 0; i < kPageTableEntryNum; i++) {
+    pt_base_addr[i] = reinterpret_cast<uint64_t>(frames[i]) | flags;
+  }
+
+  SetEntry(KernelToPhys<uint64_t>(pt_base_addr), /*present=*/true, /*rw=*/true,
+           /*is_kernel=*/false, pdt_entry);
+  SetUserAccessible(pdt_entry);
+  ReleaseFrame(huge_frame, released);
+}
+
+void PageTable::ReleaseFrame(uint64_t* frame, ReleasedPages* released) {
+  if (released != nullptr) {
+    released->frames.push_back(frame);
+  } else {
+    UserFrameAllocator::GetPhysicalFrameAllocator().FreeFrame(frame);
+  }
+}
+
+void PageTable::ReleaseTable(uint64_t* table, ReleasedPages* released) {
+  if (released != nullptr) {
+    released->tables.push_back(table);
+  } else {
+    kfree(table);
+  }
+}
+
+void PageTable::DeallocatePages(uint64_t* pml4e_base_addr_phys,
+                                uint64_t vm_start_addr, size_t bytes,
+                                ReleasedPages* released) {
+  FreePML4E(vm_start_addr, bytes, PhysToKernel<uint64_t*>(pml4e_base_addr_phys),
+            released);
+}
+
+void PageTable::AllocateHugePage(uint64_t* pml4e_base_addr_phys,
+                                 uint64_t vm_addr, uint64_t physical_addr) {
+  ASSERT(vm_addr < kKernelVirtualOffset);
+  ASSERT(vm_addr % kPDTableAddressSizePerEntry == 0);
+  ASSERT(physical_addr % kPDTableAddressSizePerEntry == 0);
+
+  uint64_t* table = PhysToKernel<uint64_t*>(pml4e_base_addr_phys);
+  size_t offsets[2] = {GetPML4Offset(vm_addr), GetPDPOffset(vm_addr)};
+  for (size_t offset : offsets) {
+    if (!IsPresent(table[offset])) {
+      uint64_t* next_table = CreateNewTable();
+      SetEntry(KernelToPhys<uint64_t>(next_table), /*present=*/true,
+               /*rw=*/true, /*super=*/false, &table[offset]);
+    }
+    SetUserAccessible(&table[offset]);
+    table = PhysToKernel<uint64_t*>(GetBaseAddress(table[offset]));
+  }
+
+  uint64_t* entry = &table[GetPDOffset(vm_addr)];
+  ASSERT(!IsPresent(*entry));
+
+  SetEntry(physical_addr, /*present=*/true, /*rw=*/true, /*super=*/false,
+           entry);
+  SetHugePage(entry);
+}
+
+uint64_t* PageTable::GetPageTableEntry(uint64_t* pml4e_base_addr_phys,
+                                       uint64_t vm_addr) const {
+  uint64_t* table = PhysToKernel<uint64_t*>(pml4e_base_addr_phys);
+  size_t offsets[3] = {GetPML4Offset(vm_addr), GetPDPOffset(vm_addr),
+                       GetPDOffset(vm_addr)};
+
+  for (size_t level = 0; level < 3; level++) {
+    size_t offset = offsets[level];
+    if (!IsPresent(table[offset])) {
+      return nullptr;
+    }
+    if (level == 2 && IsHugePage(table[offset])) {
+      return &table[offset];
+    }
+    table = PhysToKernel<uint64_t*>(GetBaseAddress(table[offset]));
+  }
+
+  return &table[GetPTOffset(vm_addr)];
+}
+
 void PageTableManager::AllocatePage(uint64_t* user_pml4e_base_phys_addr_,
                                     uint64_t* user_vm_address, size_t order) {
   // Make sure that the requested vm address is actually in user space.
@@ -482,6 +652,21 @@ void PageTableManager::AllocatePage(uint64_t* user_pml4e_base_phys_addr_,
       (1 << order) * FourKB, /*is_kernel=*/false, physical_frame);
 }
 
+void PageTableManager::AllocateHugePage(uint64_t* user_pml4e_base_phys_addr,
+                                        uint64_t user_vm_address) {
+  ASSERT(user_vm_address < kKernelVMStart);
+
+  // Order 9 (2^9 * 4KB = 2MB) buddy block is always 2MB aligned since each
+  // buddy allocator starts at the 2MB aligned address.
+  uint64_t physical_frame = reinterpret_cast<uint64_t>(
+      UserFrameAllocator::GetPhysicalFrameAllocator().AllocateFrame(9));
+  QemuSerialLog::Logf("Allocate huge page : %lx (vm: %lx)\n", physical_frame,
+                      user_vm_address);
+
+  page_table_.AllocateHugePage(user_pml4e_base_phys_addr, user_vm_address,
+                               physical_frame);
+}
+
 void PageTableManager::AllocateKernelPage(uint64_t kernel_vm_addr,
                                           uint64_t size,
                                           uint64_t physical_addr) {
@@ -490,8 +675,272 @@ void PageTableManager::AllocateKernelPage(uint64_t kernel_vm_addr,
                             /*physical=*/physical_addr);
 }
 
+void PageTableManager::MapPage(uint64_t* user_pml4e_base_phys_addr,
+                               uint64_t user_vm_address, void* frame,
+                               bool writable, bool copy_on_write) {
+  ASSERT(user_vm_address < kKernelVMStart);
+  ASSERT(user_vm_address % FourKB == 0);
+
+  page_table_.AllocateTable(user_pml4e_base_phys_addr, user_vm_address, FourKB,
+                            /*is_kernel=*/false,
+                            reinterpret_cast<uint64_t>(frame));
+
+  uint64_t* entry =
+      page_table_.GetPageTableEntry(user_pml4e_base_phys_addr, user_vm_address);
+  if (!writable || copy_on_write) {
+    SetReadOnly(entry);
+  }
+  if (copy_on_write) {
+    SetCopyOnWrite(entry);
+  }
+
+  CPURegsAccessProvider::InvalidatePage(user_vm_address);
+}
+
+void PageTableManager::MapSharedPage(uint64_t* user_pml4e_base_phys_addr,
+                                     uint64_t user_vm_address, void* frame) {
+  MapPage(user_pml4e_base_phys_addr, user_vm_address, frame, /*writable=*/true);
+
+  uint64_t* entry =
+      page_table_.GetPageTableEntry(user_pml4e_base_phys_addr, user_vm_address);
+  SetShared(entry);
+}
+
+bool PageTableManager::IsCopyOnWritePage(uint64_t* user_pml4e_base_phys_addr,
+                                         uint64_t user_vm_address) const {
+  uint64_t* entry =
+      page_table_.GetPageTableEntry(user_pml4e_base_phys_addr, user_vm_address);
+  return entry != nullptr && IsPresent(*entry) && IsCopyOnWrite(*entry);
+}
+
+void PageTableManager::HandleCopyOnWrite(uint64_t* user_pml4e_base_phys_addr,
+                                         uint64_t user_vm_address) {
+  uint64_t* entry =
+      page_table_.GetPageTableEntry(user_pml4e_base_phys_addr, user_vm_address);
+  ASSERT(entry != nullptr && IsCopyOnWrite(*entry));
+
+  const bool is_huge_page = IsHugePage(*entry);
+  const uint64_t page_size = is_huge_page ? kHugePageSize : FourKB;
+  uint64_t boundary = user_vm_address - user_vm_address % page_size;
+
+  auto& frame_allocator = UserFrameAllocator::GetPhysicalFrameAllocator();
+  uint8_t* frame = reinterpret_cast<uint8_t*>(GetBaseAddress(*entry));
+
+  // If nobody else is using the frame, then we can just take it.
+  uint8_t* old_frame = nullptr;
+  if (frame_allocator.GetRefCount(frame) > 1) {
+    uint8_t* new_frame = static_cast<uint8_t*>(
+        frame_allocator.AllocateFrame(is_huge_page ? 9 : 0));
+
+    void* from = MapFrameToKernel(frame, page_size);
+    void* to = MapFrameToKernel(new_frame, page_size);
+    memcpy(to, from, page_size);
+    UnmapFrameFromKernel(to, page_size);
+    UnmapFrameFromKernel(from, page_size);
+
+    SetEntry(reinterpret_cast<uint64_t>(new_frame), /*present=*/true,
+             /*rw=*/true, /*is_kernel=*/false, entry);
+    old_frame = frame;
+  } else {
+    SetEntry(reinterpret_cast<uint64_t>(frame), /*present=*/true, /*rw=*/true,
+             /*is_kernel=*/false, entry);
+  }
+
+  if (is_huge_page) {
+    SetHugePage(entry);
+  }
+
+  // Other threads of the process may have the read only entry. Invalidating
+  // any address in the huge page flushes the whole page.
+  TLBShootdownManager::GetTLBShootdownManager().FlushRange(
+      user_pml4e_base_phys_addr, boundary, FourKB);
+
+  // Drop the reference only after no CPU can reach the old frame through this
+  // page table.
+  if (old_frame != nullptr) {
+    frame_allocator.FreeFrame(old_frame);
+  }
+}
+
+void PageTableManager::UnmapUserPages(uint64_t* user_pml4e_base_phys_addr,
+                                      uint64_t user_vm_address,
+                                      uint64_t size) {
+  ASSERT(user_vm_address % FourKB == 0 && size % FourKB == 0);
+
+  PageTable::ReleasedPages released;
+  page_table_.DeallocatePages(user_pml4e_base_phys_addr, user_vm_address,
+                              size, &released);
+  TLBShootdownManager::GetTLBShootdownManager().FlushRange(
+      user_pml4e_base_phys_addr, user_vm_address, size);
+
+  FreeReleasedPages(released);
+}
+
+void PageTableManager::FreeUserPages(uint64_t* user_pml4e_base_phys_addr) {
+  // Lower half of the address space (PML4 entry 0 ~ 255) is the user memory.
+  PageTable::ReleasedPages released;
+  page_table_.DeallocatePages(user_pml4e_base_phys_addr, 0,
+                              256 * kPML4AddressSizePerEntry, &released);
+
+  // The other CPUs that ran the process last may still have the entries.
+  TLBShootdownManager::GetTLBShootdownManager().FlushAll(
+      user_pml4e_base_phys_addr);
+
+  FreeReleasedPages(released);
+}
+
+void PageTableManager::FreeReleasedPages(
+    const PageTable::ReleasedPages& released) {
+  auto& frame_allocator = UserFrameAllocator::GetPhysicalFrameAllocator();
+  for (uint64_t* frame : released.frames) {
+    frame_allocator.FreeFrame(frame);
+  }
+  for (uint64_t* table : released.tables) {
+    kfree(table);
+  }
+}
+
+void* PageTableManager::MapFrameToKernel(void* frame, uint64_t size) {
+  ASSERT(size % FourKB == 0);
+
+  // Borrow pages from the kernel heap and point them to the frame. Heap chunk
+  // headers are outside of the aligned region, so it is safe to remap the
+  // whole pages.
+  uint64_t kernel_addr =
+      reinterpret_cast<uint64_t>(kaligned_alloc(FourKB, size));
+  ASSERT(kernel_addr != 0);
+
+  // Other CPUs may still have the heap pages in their TLB.
+  AllocateKernelPage(kernel_addr, size, reinterpret_cast<uint64_t>(frame));
+  TLBShootdownManager::GetTLBShootdownManager().FlushKernelRange(kernel_addr,
+                                                                 size);
+
+  return reinterpret_cast<void*>(kernel_addr);
+}
+
+void* PageTableManager::MapFramesToKernel(void* const* frames,
+                                          size_t num_frames) {
+  uint64_t kernel_addr =
+      reinterpret_cast<uint64_t>(kaligned_alloc(FourKB, num_frames * FourKB));
+  ASSERT(kernel_addr != 0);
+
+  for (size_t i = 0; i < num_frames; i++) {
+    AllocateKernelPage(kernel_addr + i * FourKB, FourKB,
+                       reinterpret_cast<uint64_t>(frames[i]));
+  }
+  TLBShootdownManager::GetTLBShootdownManager().FlushKernelRange(
+      kernel_addr, num_frames * FourKB);
+
+  return reinterpret_cast<void*>(kernel_addr);
+}
+
+void PageTableManager::UnmapFrameFromKernel(void* kernel_addr, uint64_t size) {
+  // Restore the original mapping of the heap pages and return them.
+  uint64_t addr = reinterpret_cast<uint64_t>(kernel_addr);
+  // No CPU may keep using the frame (which can be freed right after this)
+  // through the stale entry.
+  AllocateKernelPage(addr, size, KernelToPhys<uint64_t>(kernel_addr));
+  TLBShootdownManager::GetTLBShootdownManager().FlushKernelRange(addr, size);
+
+  kfree(kernel_addr);
+}
+
+void PageTableManager::LoadELFSegmentPage(Process* process,
+                                          uint64_t fault_addr) {
+  uint64_t boundary = Get4KBBoundary(fault_addr);
+  ELFProgramHeader header = process->GetMatchingProgramHeader(fault_addr);
+
+  // If the page only contains the file content, then it can be backed by the
+  // shared frame in the page cache. Read only segments (e.g .text) just share
+  // it; writable segments (e.g .data) get its own copy on the first write.
+  // Pages that overlap with .bss (p_filesz ~ p_memsz) must be zero filled so
+  // those are always private.
+  if ((header.p_vaddr - header.p_offset) % FourKB == 0 &&
+      boundary + FourKB <= header.p_vaddr + header.p_filesz) {
+    uint64_t file_offset = header.p_offset + (boundary - header.p_vaddr);
+    void* frame = PageCache::GetPageCache().GetPage(process->GetInodeNumber(),
+                                                    file_offset);
+
+    bool is_writable = header.p_flags & kELFSegmentWritable;
+    MapPage(process->GetPageTableBaseAddress(), boundary, frame,
+            /*writable=*/false, /*copy_on_write=*/is_writable);
+    return;
+  }
+
+  AllocatePage(process->GetPageTableBaseAddress(), (uint64_t*)boundary, 0);
+
+  uint64_t file_read_start_offset =
+      header.p_offset + (max(header.p_vaddr, boundary) - header.p_vaddr);
+
+  uint64_t num_read = 0;
+  if (boundary > header.p_vaddr) {
+    num_read = min(FourKB, header.p_vaddr + header.p_memsz - boundary);
+  } else {
+    num_read = min(FourKB, header.p_memsz);
+  }
+
+  // If the address was ELF section, then we need to copy it from the file.
+  auto& file_system = Ext2FileSystem::GetExt2FileSystem();
+  file_system.ReadFile(
+      process->GetFileName().c_str(),
+      reinterpret_cast<uint8_t*>(max(header.p_vaddr, boundary)), num_read,
+      file_read_start_offset);
+
+  process->ZeroInitIfNeeded(boundary);
+}
+
+void PageTableManager::LoadHeapPage(Process* process, uint64_t fault_addr) {
+  uint64_t* pml4e_base_phys_addr = process->GetPageTableBaseAddress();
+  uint64_t heap_start = Process::kUserProcessHeapStartAddress;
+  uint64_t heap_end = reinterpret_cast<uint64_t>(process->GetHeapEnd());
+
+  // If the whole 2MB around the fault address is in the heap and nothing is
+  // mapped there yet, then map the 2MB page at once.
+  uint64_t huge_boundary = fault_addr - fault_addr % kHugePageSize;
+  if (heap_start <= huge_boundary &&
+      huge_boundary + kHugePageSize <= heap_end &&
+      page_table_.GetPageTableEntry(pml4e_base_phys_addr, huge_boundary) ==
+          nullptr) {
+    AllocateHugePage(pml4e_base_phys_addr, huge_boundary);
+
+    uint64_t* entry =
+        page_table_.GetPageTableEntry(pml4e_base_phys_addr, huge_boundary);
+    void* frame_addr = MapFrameToKernel(GetBaseAddress(*entry), kHugePageSize);
+    memset(frame_addr, 0, kHugePageSize);
+    UnmapFrameFromKernel(frame_addr, kHugePageSize);
+    return;
+  }
+
+  void* frame = ZeroedFramePool::GetZeroedFramePool().AllocateZeroedFrame();
+  MapPage(pml4e_base_phys_addr, Get4KBBoundary(fault_addr), frame,
+          /*writable=*/true);
+}
+
+void PageTableManager::LoadMappedPage(Process* process, uint64_t fault_addr) {
+  VMArea area;
+  bool found = process->GetVMAreaTree().FindArea(fault_addr, &area);
+  ASSERT(found);
+
+  uint64_t boundary = Get4KBBoundary(fault_addr);
+  bool is_writable = area.prot & VMArea::kProtWrite;
+
+  if (area.type == VMArea::FILE) {
+    // Writable file mapping is private; it gets its own copy on the first
+    // write.
+    void* frame = PageCache::GetPageCache().GetPage(
+        area.inode_num, area.file_offset + (boundary - area.start));
+    MapPage(process->GetPageTableBaseAddress(), boundary, frame,
+            /*writable=*/false, /*copy_on_write=*/is_writable);
+    return;
+  }
+
+  void* frame = ZeroedFramePool::GetZeroedFramePool().AllocateZeroedFrame();
+  MapPage(process->GetPageTableBaseAddress(), boundary, frame, is_writable);
+}
+
 void PageTableManager::PageFaultHandler(CPUInterruptHandlerArgs* args,
-                                        InterruptHandlerSavedRegs* regs) {
+                                        InterruptHandlerSavedRegs* regs,
+                                        uint64_t error_code) {
   uint64_t fault_addr = CPURegsAccessProvider::ReadCR2();
 
   // We first need to check whether the fault address is valid.
@@ -548,6 +997,19 @@ void PageTableManager::PageFaultHandler(CPUInterruptHandlerArgs* args,
   CopyCPUInteruptHandlerArgs(process_regs, args);
 
   auto address_info = process->GetAddressInfo(fault_addr);
+
+  // Fault on the present page means that the access violated the protection
+  // of the page. Only the write on the copy on write page is allowed.
+  bool is_copy_on_write = false;
+  if (error_code & kPageFaultPresent) {
+    is_copy_on_write =
+        (error_code & kPageFaultWrite) &&
+        IsCopyOnWritePage(process->GetPageTableBaseAddress(), fault_addr);
+    if (!is_copy_on_write) {
+      address_info = ProcessAddressInfo::NOT_VALID_ADDR;
+    }
+  }
+
   if (address_info == ProcessAddressInfo::NOT_VALID_ADDR) {
     PageTablePrintUtil::PrintUserTable(
         PhysToKernel<uint64_t*>(process->GetPageTableBaseAddress()));
@@ -565,30 +1027,19 @@ void PageTableManager::PageFaultHandler(CPUInterruptHandlerArgs* args,
   // within the page fault handler.
   CPURegsAccessProvider::EnableInterrupt();
 
-  // Allocate 1 page.
-  uint64_t boundary = Get4KBBoundary(fault_addr);
-  AllocatePage(process->GetPageTableBaseAddress(), (uint64_t*)boundary, 0);
-  if (address_info == ProcessAddressInfo::ELF_SEGMENT_ADDR) {
-    ELFProgramHeader header = process->GetMatchingProgramHeader(fault_addr);
-
-    uint64_t file_read_start_offset =
-        header.p_offset + (max(header.p_vaddr, boundary) - header.p_vaddr);
-
-    uint64_t num_read = 0;
-    if (boundary > header.p_vaddr) {
-      num_read = min(FourKB, header.p_vaddr + header.p_memsz - boundary);
-    } else {
-      num_read = min(FourKB, header.p_memsz);
-    }
-
-    // If the address was ELF section, then we need to copy it from the file.
-    auto& file_system = Ext2FileSystem::GetExt2FileSystem();
-    file_system.ReadFile(
-        process->GetFileName().c_str(),
-        reinterpret_cast<uint8_t*>(max(header.p_vaddr, boundary)), num_read,
-        file_read_start_offset);
-
-    process->ZeroInitIfNeeded(boundary);
+  if (is_copy_on_write) {
+    HandleCopyOnWrite(process->GetPageTableBaseAddress(), fault_addr);
+  } else if (address_info == ProcessAddressInfo::ELF_SEGMENT_ADDR) {
+    LoadELFSegmentPage(process, fault_addr);
+  } else if (address_info == ProcessAddressInfo::HEAP_ADDR) {
+    LoadHeapPage(process, fault_addr);
+  } else if (address_info == ProcessAddressInfo::MMAP_ANONYMOUS_ADDR ||
+             address_info == ProcessAddressInfo::MMAP_FILE_ADDR) {
+    LoadMappedPage(process, fault_addr);
+  } else {
+    // Allocate 1 page.
+    uint64_t boundary = Get4KBBoundary(fault_addr);
+    AllocatePage(process->GetPageTableBaseAddress(), (uint64_t*)boundary, 0);
   }
 
   /*
@@ -610,10 +1061,62 @@ void PageTableManager::PageFaultHandler(CPUInterruptHandlerArgs* args,
 
 void PageTableManager::CopyUserPageTable(uint64_t* from_pml4_base_addr,
                                          uint64_t* to_pml4_base_addr) {
-  // Copy page table.
-  UNUSED(from_pml4_base_addr);
-  UNUSED(to_pml4_base_addr);
+  // Only the lower half (user memory) is copied. Kernel entries are already
+  // shared when the table is created.
+  uint64_t* pml4 = PhysToKernel<uint64_t*>(from_pml4_base_addr);
+  for (uint64_t pml4_offset = 0; pml4_offset < kPML4EntryNum / 2;
+       pml4_offset++) {
+    if (!IsPresent(pml4[pml4_offset])) {
+      continue;
+    }
+
+    uint64_t* pdpt = PhysToKernel<uint64_t*>(GetBaseAddress(pml4[pml4_offset]));
+    for (uint64_t pdp_offset = 0; pdp_offset < kPDPTEntryNum; pdp_offset++) {
+      if (!IsPresent(pdpt[pdp_offset])) {
+        continue;
+      }
+
+      uint64_t* pdt = PhysToKernel<uint64_t*>(GetBaseAddress(pdpt[pdp_offset]));
+      for (uint64_t pd_offset = 0; pd_offset < kPDTableEntryNum; pd_offset++) {
+        if (!IsPresent(pdt[pd_offset])) {
+          continue;
+        }
+
+        if (IsHugePage(pdt[pd_offset])) {
+          uint64_t vm_addr =
+              (pml4_offset << 39) | (pdp_offset << 30) | (pd_offset << 21);
+          void* frame = ShareUserPage(&pdt[pd_offset]);
+          page_table_.AllocateHugePage(to_pml4_base_addr, vm_addr,
+                                       reinterpret_cast<uint64_t>(frame));
+          *page_table_.GetPageTableEntry(to_pml4_base_addr, vm_addr) =
+              pdt[pd_offset];
+          continue;
+        }
+
+        uint64_t* pt = PhysToKernel<uint64_t*>(GetBaseAddress(pdt[pd_offset]));
+        for (uint64_t pt_offset = 0; pt_offset < kPageTableEntryNum;
+             pt_offset++) {
+          uint64_t* entry = &pt[pt_offset];
+          if (!IsPresent(*entry)) {
+            continue;
+          }
+
+          void* frame = ShareUserPage(entry);
+          uint64_t vm_addr = (pml4_offset << 39) | (pdp_offset << 30) |
+                             (pd_offset << 21) | (pt_offset << 12);
+          page_table_.AllocateTable(to_pml4_base_addr, vm_addr, FourKB,
+                                    /*is_kernel=*/false,
+                                    reinterpret_cast<uint64_t>(frame));
+          *page_table_.GetPageTableEntry(to_pml4_base_addr, vm_addr) = *entry;
+        }
+      }
+    }
+  }
+
+  // Flush the TLB since the parent's pages are now read only.
+  TLBShootdownManager::GetTLBShootdownManager().FlushAll(from_pml4_base_addr);
 }
+
 // Print the page table entires where the user can access.
 void PageTablePrintUtil::PrintUserTable(uint64_t* cr3) {
   int cpu_id = CPUContextManager::GetCurrentCPUId();
@@ -651,10 +1154,14 @@ void PageTablePrintUtil::PrintPDE(uint64_t* pdt_top, uint64_t start_addr) {
   int cpu_id = CPUContextManager::GetCurrentCPUId();
   for (uint64_t i = 0; i < 512; i++) {
     if (IsPresent(pdt_top[i]) && IsUserAccessible(pdt_top[i])) {
-      QemuSerialLog::Logf(">> [%d] PDT (%lx) ~ (%lx) : [%lx] \n", cpu_id,
+      QemuSerialLog::Logf(">> [%d] PDT (%lx) ~ (%lx) : [%lx]%s \n", cpu_id,
                           (i << 21) + start_addr,
                           ((i + 1) << 21) - 1 + start_addr,
-                          GetBaseAddress(pdt_top[i]));
+                          GetBaseAddress(pdt_top[i]),
+                          IsHugePage(pdt_top[i]) ? " (2MB)" : "");
+      if (IsHugePage(pdt_top[i])) {
+        continue;
+      }
       PrintPT(PhysToKernel<uint64_t*>(GetBaseAddress(pdt_top[i])),
               (i << 21) + start_addr);
     }
@@ -680,6 +1187,8 @@ bool IsKernelMemory(uint64_t memory_addr) {
 }  // namespace Kernel
 
 void PageFaultInterruptHandlerCaller(Kernel::CPUInterruptHandlerArgs* args,
-                                     Kernel::InterruptHandlerSavedRegs* regs) {
-  Kernel::PageTableManager::GetPageTableManager().PageFaultHandler(args, regs);
+                                     Kernel::InterruptHandlerSavedRegs* regs,
+                                     uint64_t error_code) {
+  Kernel::PageTableManager::GetPageTableManager().PageFaultHandler(args, regs,
+                                                                   error_code);
 }
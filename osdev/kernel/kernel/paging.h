@@ -8,6 +8,9 @@
 #include "printf.h"
 
 namespace Kernel {
+
+class Process;
+
 // Physical Memory Layout
 //
 //  THIS IS THE PHYSICAL MEMORY (Not Virtual)
@@ -68,9 +71,32 @@ class PageTable {
                      size_t bytes, bool is_kernel,
                      uint64_t physical_addr_start);
 
-  // Remove pages from the table.
+  // Frames and page tables that are taken out of the page table but not freed
+  // yet. Other CPUs may still use them through their TLB (or the paging
+  // structure cache) until the TLB is flushed.
+  struct ReleasedPages {
+    std::vector<uint64_t*> frames;
+
+    // Kernel VM address of the emptied page tables.
+    std::vector<uint64_t*> tables;
+  };
+
+  // Remove pages from the table. Frames that are mapped are released and the
+  // tables that become empty are freed. If released is given, those are put
+  // there instead so that the caller can free them after flushing the TLB.
   void DeallocatePages(uint64_t* pml4e_base_addr_phys, uint64_t vm_start_addr,
-                       size_t bytes);
+                       size_t bytes, ReleasedPages* released = nullptr);
+
+  // Map 2MB page at vm_addr (using the page directory entry). Both vm_addr and
+  // physical_addr must be 2MB aligned. Only used for the user pages.
+  void AllocateHugePage(uint64_t* pml4e_base_addr_phys, uint64_t vm_addr,
+                        uint64_t physical_addr);
+
+  // Returns the (kernel VM) address of the page table entry that maps vm_addr.
+  // If vm_addr is in the 2MB page, then returns the page directory entry.
+  // Returns nullptr if the page table that contains the entry does not exist.
+  uint64_t* GetPageTableEntry(uint64_t* pml4e_base_addr_phys,
+                              uint64_t vm_addr) const;
 
   // This is for low memory (< 1MB). MUST BE DEALLOCATED AFTER USE.
   // USE AT YOUR OWN DISCRETION!
@@ -89,13 +115,26 @@ class PageTable {
   void SetPT(uint64_t start_addr, uint64_t end_addr, uint64_t* pt_base_addr,
              bool is_kernel, uint64_t physical_addr_start);
 
-  void FreePML4E(uint64_t start_addr, uint64_t size, uint64_t* pml4e_base_addr);
+  void FreePML4E(uint64_t start_addr, uint64_t size, uint64_t* pml4e_base_addr,
+                 ReleasedPages* released);
 
   // Returns true if every entry in this table is freed.
   bool FreePDPT(uint64_t start_addr, uint64_t end_addr,
-                uint64_t* pdpe_base_addr);
-  bool FreePDT(uint64_t start_addr, uint64_t end_addr, uint64_t* pdt_base_addr);
-  bool FreePT(uint64_t start_addr, uint64_t end_addr, uint64_t* pt_base_addr);
+                uint64_t* pdpe_base_addr,
+                ReleasedPages* released);
+  bool FreePDT(uint64_t start_addr, uint64_t end_addr, uint64_t* pdt_base_addr,
+               ReleasedPages* released);
+  bool FreePT(uint64_t start_addr, uint64_t end_addr, uint64_t* pt_base_addr,
+              ReleasedPages* released);
+
+  // Replace the 2MB page with the page table of 4KB pages that have the same
+  // contents.
+  void SplitHugePage(uint64_t* pdt_entry, ReleasedPages* released);
+
+  // Release the frame (or the emptied page table) now or later (if released
+  // is given).
+  static void ReleaseFrame(uint64_t* frame, ReleasedPages* released);
+  static void ReleaseTable(uint64_t* table, ReleasedPages* released);
 
   // Register start_addr ~ start_addr + size address as Kernel Page.
   void RegisterKernelPage(uint64_t start_addr, uint64_t size);
@@ -127,14 +166,68 @@ class PageTableManager {
   // Returns physical address to the pml4e base address.
   uint64_t* CreateUserPageTable() { return page_table_.CreateEmptyPageTable(); }
 
+  static constexpr uint64_t kHugePageSize = (1 << 21);
+
   // Allocate 2^order bytes of pages for user_vm_address.
   void AllocatePage(uint64_t* user_pml4e_base_phys_addr_,
                     uint64_t* user_vm_address, size_t order);
 
+  // Allocate a 2MB page for user_vm_address (must be 2MB aligned). It is backed
+  // by the physically contiguous order 9 frame.
+  void AllocateHugePage(uint64_t* user_pml4e_base_phys_addr,
+                        uint64_t user_vm_address);
+
+  // Map the (already allocated) physical frame to user_vm_address. The
+  // reference of the frame that the caller holds is moved to the page table.
+  // If copy_on_write is set, the page is mapped as read only and the first
+  // write to the page will make a private copy of the frame.
+  void MapPage(uint64_t* user_pml4e_base_phys_addr, uint64_t user_vm_address,
+               void* frame, bool writable, bool copy_on_write = false);
+
+  // Map the frame as a writable page that is shared with others (e.g the
+  // kernel). Unlike the other writable pages, it does not become copy on write
+  // on fork().
+  void MapSharedPage(uint64_t* user_pml4e_base_phys_addr,
+                     uint64_t user_vm_address, void* frame);
+
+  // Returns true if user_vm_address is mapped to the copy on write page.
+  bool IsCopyOnWritePage(uint64_t* user_pml4e_base_phys_addr,
+                         uint64_t user_vm_address) const;
+
+  // Make the copy on write page at user_vm_address writable. If the frame is
+  // shared with others, the content is copied to the newly allocated frame
+  // (whole 2MB for the huge page).
+  void HandleCopyOnWrite(uint64_t* user_pml4e_base_phys_addr,
+                         uint64_t user_vm_address);
+
+  // Release the user pages in [user_vm_address, user_vm_address + size) and
+  // flush them from the TLB of every CPU that uses the page table. Frames are
+  // released after the flush so that no CPU can touch them after reuse.
+  void UnmapUserPages(uint64_t* user_pml4e_base_phys_addr,
+                      uint64_t user_vm_address, uint64_t size);
+
+  // Release every user page (and the tables) mapped in the page table. Like
+  // UnmapUserPages, frames are released after flushing the TLB. Note that the
+  // PML4 table itself is not freed. The process must not be running in the
+  // user space.
+  void FreeUserPages(uint64_t* user_pml4e_base_phys_addr);
+
+  // User frames live outside of the kernel's directly mapped memory. This
+  // temporarily maps the frame to the kernel VM so that the kernel can access
+  // it. The returned address must be released by UnmapFrameFromKernel().
+  void* MapFrameToKernel(void* frame, uint64_t size = (1 << 12));
+  void UnmapFrameFromKernel(void* kernel_addr, uint64_t size = (1 << 12));
+
+  // Same as above but the frames need not be physically contiguous. Released
+  // by UnmapFrameFromKernel(kernel_addr, num_frames * 4KB).
+  void* MapFramesToKernel(void* const* frames, size_t num_frames);
+
+  // error_code is the error code that CPU pushes on #PF.
   void PageFaultHandler(CPUInterruptHandlerArgs* args,
-                        InterruptHandlerSavedRegs* regs);
+                        InterruptHandlerSavedRegs* regs, uint64_t error_code);
 
   // Copy page table of parent process to the user process. Used for fork().
+  // Frames are not copied; writable pages become copy on write in both.
   void CopyUserPageTable(uint64_t* from_pml4_base_addr,
                          uint64_t* to_pml4_base_addr);
 
@@ -160,6 +253,20 @@ class PageTableManager {
                               /*physical=*/0);
   }
 
+  // Return the frames and the page tables (that are taken out of the page
+  // table) to the allocators.
+  static void FreeReleasedPages(const PageTable::ReleasedPages& released);
+
+  // Bring the page of the ELF segment that contains fault_addr.
+  void LoadELFSegmentPage(Process* process, uint64_t fault_addr);
+
+  // Map the zero filled page to the heap.
+  void LoadHeapPage(Process* process, uint64_t fault_addr);
+
+  // Bring the page of the mmap-ed area. File pages are shared with the page
+  // cache and anonymous pages are zero filled.
+  void LoadMappedPage(Process* process, uint64_t fault_addr);
+
   PageTable page_table_;
   uint64_t* kernel_pml4e_base_phys_addr_;
 };
@@ -185,6 +292,6 @@ bool IsKernelMemory(uint64_t memory_addr);
 
 extern "C" void PageFaultInterruptHandlerCaller(
     Kernel::CPUInterruptHandlerArgs* args,
-    Kernel::InterruptHandlerSavedRegs* regs);
+    Kernel::InterruptHandlerSavedRegs* regs, uint64_t error_code);
 
 #endif
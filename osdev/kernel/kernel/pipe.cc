@@ -7,60 +7,73 @@
 namespace Kernel {
 
 int Pipe::Write(char* data, int len) {
-  if (len > kPipeMaxSize) {
-    QemuSerialLog::Logf("Data size is too large!");
-    return 0;
-  }
-
   // Wait until there is nothing left in the pipe.
   while (true) {
-    buf_access_lock_.lock();
-    if (size_ > 0) {
-      buf_access_lock_.unlock();
-      KernelThreadScheduler::GetKernelThreadScheduler().Yield();
-      continue;
+    int written = TryWrite(data, len);
+    if (written >= 0) {
+      return written;
     }
-
-    for (int i = 0; i < len; i++) {
-      buf_[i] = data[i];
-    }
-
-    size_ = len;
-    buf_access_lock_.unlock();
-    return len;
+    KernelThreadScheduler::GetKernelThreadScheduler().Yield();
   }
 }
 
 int Pipe::Read(char* data, size_t count) {
   // Wait until there is some data in the pipe.
   while (true) {
-    buf_access_lock_.lock();
-    if (size_ == 0) {
-      buf_access_lock_.unlock();
+    int actually_read = TryRead(data, count);
+    if (actually_read >= 0) {
+      return actually_read;
+    }
+    KernelThreadScheduler::GetKernelThreadScheduler().Yield();
+  }
+}
 
-      // Immediately return if it is a non-blocking IO.
-      if (!is_blocking_) {
-        return 0;
-      }
+int Pipe::TryWrite(char* data, int len) {
+  if (len > kPipeMaxSize) {
+    QemuSerialLog::Logf("Data size is too large!");
+    return 0;
+  }
 
-      KernelThreadScheduler::GetKernelThreadScheduler().Yield();
-      continue;
-    }
+  buf_access_lock_.lock();
+  if (size_ > 0) {
+    buf_access_lock_.unlock();
+    return -1;
+  }
 
-    int actually_read = min((int)count, size_);
-    for (int i = 0; i < actually_read; i++) {
-      data[i] = buf_[i];
-    }
+  for (int i = 0; i < len; i++) {
+    buf_[i] = data[i];
+  }
 
-    size_ -= actually_read;
-    for (int i = 0; i < size_; i++) {
-      buf_[i] = buf_[i + actually_read];
-    }
+  size_ = len;
+  buf_access_lock_.unlock();
+  return len;
+}
 
+int Pipe::TryRead(char* data, size_t count) {
+  buf_access_lock_.lock();
+  if (size_ == 0) {
     buf_access_lock_.unlock();
 
-    return actually_read;
+    // Immediately return if it is a non-blocking IO.
+    if (!is_blocking_) {
+      return 0;
+    }
+    return -1;
+  }
+
+  int actually_read = min((int)count, size_);
+  for (int i = 0; i < actually_read; i++) {
+    data[i] = buf_[i];
   }
+
+  size_ -= actually_read;
+  for (int i = 0; i < size_; i++) {
+    buf_[i] = buf_[i + actually_read];
+  }
+
+  buf_access_lock_.unlock();
+
+  return actually_read;
 }
 
 int PipeDescriptorReadEnd::Read(char* data, size_t count) {
@@ -71,4 +84,12 @@ int PipeDescriptorWriteEnd::Write(char* data, int len) {
   return pipe_->Write(data, len);
 }
 
+int PipeDescriptorReadEnd::TryRead(char* data, size_t count) {
+  return pipe_->TryRead(data, count);
+}
+
+int PipeDescriptorWriteEnd::TryWrite(char* data, int len) {
+  return pipe_->TryWrite(data, len);
+}
+
 }  // namespace Kernel
@@ -19,6 +19,10 @@ class Pipe {
   // kPipeMaxSize buffer.
   int Read(char* data, size_t count);
 
+  // Same as Write and Read but returns -1 instead of waiting.
+  int TryWrite(char* data, int len);
+  int TryRead(char* data, size_t count);
+
   Pipe() = default;
   ~Pipe() = default;
 
@@ -45,6 +49,7 @@ class PipeDescriptorReadEnd : public FileDescriptor {
   DescriptorType GetDescriptorType() final { return PIPE_READ; }
 
   int Read(char* data, size_t count);
+  int TryRead(char* data, size_t count);
 
  private:
   Pipe* pipe_;
@@ -57,6 +62,7 @@ class PipeDescriptorWriteEnd : public FileDescriptor {
   DescriptorType GetDescriptorType() final { return PIPE_WRITE; }
 
   int Write(char* data, int len);
+  int TryWrite(char* data, int len);
 
  private:
   Pipe* pipe_;
@@ -1,8 +1,12 @@
 #include "process.h"
 
 #include "./fs/ext2.h"
+#include "./fs/page_cache.h"
+#include "clock_page.h"
 #include "cpu_context.h"
 #include "elf.h"
+#include "graphic.h"
+#include "io_ring.h"
 #include "kernel_math.h"
 #include "paging.h"
 #include "qemu_log.h"
@@ -43,6 +47,7 @@ Process::Process(KernelThread* parent, const KernelString& file_name,
       parent_(parent),
       child_list_elem_(nullptr),
       file_name_(file_name),
+      inode_num_(0),
       num_page_fault_(0),
       working_dir_(working_dir),
       heap_size_(0) {
@@ -70,6 +75,13 @@ Process::Process(KernelThread* parent, const KernelString& file_name,
       pml4e_base_phys_addr_, (uint64_t*)(kUserProcessStackAddress - kFourKB),
       0);
 
+  vm_areas_.AddArea(VMArea{kUserProcessStackAddress - kEightMB,
+                           kUserProcessStackAddress, VMArea::STACK,
+                           VMArea::kProtRead | VMArea::kProtWrite, 0, 0});
+
+  // The forked process gets it along with the rest of the page table.
+  ClockPage::GetClockPage().MapToProcess(pml4e_base_phys_addr_);
+
   user_regs_.rip = (uint64_t)entry_function;
   user_regs_.rsp = kUserProcessStackAddress - 8;
   user_regs_.cs = 0x23;       // User Code segment
@@ -83,24 +95,120 @@ Process::Process(KernelThread* parent, const KernelString& file_name,
   fxsaved_region_ = kaligned_alloc(16, 512);
 }
 
+Process::Process(Process* parent, const SavedRegisters& user_regs)
+    : KernelThread(nullptr, /*need_stack=*/true, /*in_same_cpu_id=*/false),
+      in_kernel_space_(false),
+      user_regs_(user_regs),
+      parent_(parent),
+      child_list_elem_(nullptr),
+      program_headers_(parent->program_headers_),
+      section_headers_(parent->section_headers_),
+      file_name_(parent->file_name_),
+      inode_num_(parent->inode_num_),
+      fd_table_(parent->fd_table_),
+      argv_(parent->argv_),
+      num_page_fault_(parent->num_page_fault_),
+      working_dir_(parent->working_dir_),
+      heap_size_(parent->heap_size_),
+      vm_areas_(parent->vm_areas_) {
+  child_list_elem_.Set(this);
+  child_list_elem_.ChangeList(parent->GetChildrenList());
+  child_list_elem_.PushBack();
+
+  auto& page_table_manager = PageTableManager::GetPageTableManager();
+  pml4e_base_phys_addr_ = page_table_manager.CreateUserPageTable();
+  page_table_manager.CopyUserPageTable(parent->pml4e_base_phys_addr_,
+                                       pml4e_base_phys_addr_);
+
+  // GraphicManager and IORingManager only know the parent's areas.
+  DropInheritedAreas(VMArea::FRAME_BUFFER);
+  DropInheritedAreas(VMArea::IO_RING);
+
+  fd_table_.AddProcessIdToDescriptors(Id());
+
+  // Parent's vector registers are still live since the kernel does not touch
+  // them.
+  fxsaved_region_ = kaligned_alloc(16, 512);
+  SaveVectorAndFPURegisters();
+}
+
+void Process::DropInheritedAreas(VMArea::Type type) {
+  std::vector<VMArea> areas = vm_areas_.GetAreasInRange(
+      kUserProcessMmapStartAddress, kUserProcessMmapEndAddress);
+  for (const auto& area : areas) {
+    if (area.type != type) {
+      continue;
+    }
+
+    // This drops the references that CopyUserPageTable() added.
+    vm_areas_.RemoveRange(area.start, area.end);
+    PageTableManager::GetPageTableManager().UnmapUserPages(
+        pml4e_base_phys_addr_, area.start, area.end - area.start);
+  }
+}
+
+Process::~Process() {
+  // Release the user pages. The PML4 table itself is kept since the CPU that
+  // ran this process last may still have it in its CR3.
+  PageTableManager::GetPageTableManager().FreeUserPages(pml4e_base_phys_addr_);
+  GraphicManager::GetGraphicManager().ReleaseFrameBuffer(Id());
+  IORingManager::GetIORingManager().Release(Id());
+  kfree(fxsaved_region_);
+}
+
 ProcessAddressInfo Process::GetAddressInfo(uint64_t addr) const {
   if (addr == 0) {
     return ProcessAddressInfo::NOT_VALID_ADDR;
   }
 
-  if (kUserProcessStackAddress - kEightMB <= addr &&
-      addr <= kUserProcessStackAddress) {
-    return ProcessAddressInfo::STACK_ADDR;
+  VMArea area;
+  if (!vm_areas_.FindArea(addr, &area)) {
+    return ProcessAddressInfo::NOT_VALID_ADDR;
   }
 
-  for (const auto header : program_headers_) {
-    if (header.p_vaddr <= addr && addr < header.p_vaddr + header.p_memsz) {
+  switch (area.type) {
+    case VMArea::STACK:
+      return ProcessAddressInfo::STACK_ADDR;
+    case VMArea::ELF_SEGMENT:
       return ProcessAddressInfo::ELF_SEGMENT_ADDR;
-    }
+    case VMArea::HEAP:
+      return ProcessAddressInfo::HEAP_ADDR;
+    case VMArea::ANONYMOUS:
+      return ProcessAddressInfo::MMAP_ANONYMOUS_ADDR;
+    case VMArea::FILE:
+      return ProcessAddressInfo::MMAP_FILE_ADDR;
+    case VMArea::FRAME_BUFFER:
+    case VMArea::IO_RING:
+      // Always mapped; faulting there is the protection violation.
+      return ProcessAddressInfo::NOT_VALID_ADDR;
   }
   return ProcessAddressInfo::NOT_VALID_ADDR;
 }
 
+void Process::SetProgramHeaders(std::vector<ELFProgramHeader> headers) {
+  program_headers_ = std::move(headers);
+
+  for (const auto& header : program_headers_) {
+    if (header.p_type != kELFSegmentLoad || header.p_memsz == 0) {
+      continue;
+    }
+
+    int prot = 0;
+    if (header.p_flags & kELFSegmentReadable) {
+      prot |= VMArea::kProtRead;
+    }
+    if (header.p_flags & kELFSegmentWritable) {
+      prot |= VMArea::kProtWrite;
+    }
+    if (header.p_flags & kELFSegmentExecutable) {
+      prot |= VMArea::kProtExec;
+    }
+    vm_areas_.AddArea(VMArea{header.p_vaddr, header.p_vaddr + header.p_memsz,
+                             VMArea::ELF_SEGMENT, prot, inode_num_,
+                             header.p_offset});
+  }
+}
+
 void Process::ZeroInitIfNeeded(uint64_t boundary) {
   // Check if [boudary, boudary + 4KB] overlaps with BSS section.
   for (const auto section : section_headers_) {
@@ -182,12 +290,39 @@ Process* ProcessManager::CreateProcess(std::string_view file_name,
     return nullptr;
   }
 
-  // Read the entire file.
-  uint8_t* buf = static_cast<uint8_t*>(kmalloc(file_info.file_size));
-  ext2_filesystem.ReadFile(file_name, buf, file_info.file_size);
+  // Only read the ELF header and the program & section header tables. Rest of
+  // the file is brought through the page cache when the process page faults.
+  auto& page_cache = PageCache::GetPageCache();
+  ELFHeader elf_header;
+  if (file_info.file_size < sizeof(ELFHeader)) {
+    kprintf("Elf parse error : %s \n", "File is too small.");
+    return nullptr;
+  }
+  page_cache.Read(file_info.inode, &elf_header, sizeof(ELFHeader), 0);
+
+  size_t program_header_table_size =
+      elf_header.e_phnum * sizeof(ELFProgramHeader);
+  size_t section_header_table_size =
+      elf_header.e_shnum * sizeof(ELFSectionHeader);
+  if (elf_header.e_phoff + program_header_table_size > file_info.file_size ||
+      elf_header.e_shoff + section_header_table_size > file_info.file_size) {
+    kprintf("Elf parse error : %s \n", "Header table is out of the file.");
+    return nullptr;
+  }
+
+  uint8_t* program_header_table =
+      static_cast<uint8_t*>(kmalloc(program_header_table_size));
+  uint8_t* section_header_table =
+      static_cast<uint8_t*>(kmalloc(section_header_table_size));
+  page_cache.Read(file_info.inode, program_header_table,
+                  program_header_table_size, elf_header.e_phoff);
+  page_cache.Read(file_info.inode, section_header_table,
+                  section_header_table_size, elf_header.e_shoff);
 
   // Parse the ELF header.
-  ELFReader elf_reader(buf, file_info.file_size);
+  ELFReader elf_reader(elf_header, program_header_table, section_header_table);
+  kfree(program_header_table);
+  kfree(section_header_table);
 
   if (!elf_reader.IsValid()) {
     kprintf("Elf parse error : %s \n", elf_reader.Error().c_str());
@@ -196,34 +331,48 @@ Process* ProcessManager::CreateProcess(std::string_view file_name,
 
   // Create a process. Note that the entry function would be the RIP defiend at
   // e_entry ELF header.
-  // TODO Optimize following code to only read elf header and program headers.
-  const ELFHeader& elf_header = elf_reader.GetHeader();
-
   Process* process =
       new Process(KernelThread::CurrentThread(), file_name,
                   (KernelThread::EntryFuncType)elf_header.e_entry, working_dir);
 
-  process->SetProgramHeaders(elf_reader.GetProgramHeaders());
-  process->SetSectionHeaders(elf_reader.GetSectionHeaders());
-  kfree(buf);
+  process->SetInodeNumber(file_info.inode);
+  process->SetProgramHeaders(elf_reader.TakeProgramHeaders());
+  process->SetSectionHeaders(elf_reader.TakeSectionHeaders());
 
   // Now as soon as the kernel switches to this thread, it will first copy the
   // contents from the program headers.
   return process;
 }
 
-void Process::IncreaseHeapSize(uint64_t bytes) {
+bool Process::IncreaseHeapSize(uint64_t bytes) {
   ASSERT(bytes % kFourKB == 0);
-  int num_pages = bytes / kFourKB;
+  if (bytes == 0) {
+    return true;
+  }
 
-  auto& page_table_manager = PageTableManager::GetPageTableManager();
-  for (int i = 0; i < num_pages; i++) {
-    uint64_t* user_vm_addr = reinterpret_cast<uint64_t*>(
-        kUserProcessHeapStartAddress + heap_size_ + i * kFourKB);
-    page_table_manager.AllocatePage(GetPageTableBaseAddress(), user_vm_addr, 0);
+  // The heap must not grow into the mmap region.
+  uint64_t heap_end = kUserProcessHeapStartAddress + heap_size_;
+  if (bytes > kUserProcessMmapStartAddress - heap_end) {
+    return false;
+  }
+
+  // Only reserve the address range. Page fault handler brings zero filled
+  // pages (or 2MB pages if possible) when they are actually touched. The heap
+  // is a single area that keeps growing.
+  bool added;
+  if (heap_size_ == 0) {
+    added = vm_areas_.AddArea(VMArea{heap_end, heap_end + bytes, VMArea::HEAP,
+                                     VMArea::kProtRead | VMArea::kProtWrite, 0,
+                                     0});
+  } else {
+    added = vm_areas_.ExtendArea(heap_end, heap_end + bytes);
+  }
+  if (!added) {
+    return false;
   }
 
   heap_size_ += bytes;
+  return true;
 }
 
 void* Process::GetHeapEnd() const {
@@ -232,7 +381,7 @@ void* Process::GetHeapEnd() const {
 
 Process* ProcessManager::CreateProcess(std::string_view file_name,
                                        std::string_view working_dir,
-                                       std::vector<KernelString> argv) {
+                                       const ProcessArgv& argv) {
   Process* process = CreateProcess(file_name, working_dir);
   if (process == nullptr) {
     return nullptr;
@@ -257,6 +406,28 @@ bool Process::ReadExitCode(pid_t pid, uint64_t* exit_code) {
   return false;
 }
 
+void Process::ReleaseUserMemory() {
+  PageTableManager::GetPageTableManager().FreeUserPages(pml4e_base_phys_addr_);
+}
+
+Process* ProcessManager::ForkProcess(Process* parent) {
+  const SyscallSavedUserRegs* syscall_regs = parent->GetSyscallSavedUserRegs();
+
+  // Child resumes right after the syscall instruction. Registers other than
+  // RBP are either saved on the user stack by the syscall wrapper or clobbered
+  // by the syscall anyway.
+  SavedRegisters user_regs{};
+  user_regs.rip = syscall_regs->rip;
+  user_regs.rsp = syscall_regs->rsp;
+  user_regs.rflags = syscall_regs->rflags | 0x200;  // Interrupt is enabled.
+  user_regs.cs = 0x23;                               // User Code segment
+  user_regs.ss = 0x1b;                               // User Stack segment.
+  user_regs.regs.rbp = syscall_regs->rbp;
+  user_regs.regs.rax = 0;  // fork() returns 0 in the child.
+
+  return new Process(parent, user_regs);
+}
+
 void Process::SaveVectorAndFPURegisters() {
   __builtin_ia32_fxsave(fxsaved_region_);
 }
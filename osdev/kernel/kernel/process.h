@@ -2,11 +2,14 @@
 #define PROCESS_H
 
 #include "../std/array.h"
+#include "../std/inlined_vector.h"
+#include "../std/string.h"
 #include "../std/string_view.h"
 #include "elf.h"
 #include "file_descriptor.h"
 #include "kernel_list.h"
 #include "kthread.h"
+#include "vm_area.h"
 
 namespace Kernel {
 enum class ProcessAddressInfo {
@@ -14,8 +17,22 @@ enum class ProcessAddressInfo {
   STACK_ADDR,
   ELF_SEGMENT_ADDR,
   HEAP_ADDR,
+  MMAP_ANONYMOUS_ADDR,
+  MMAP_FILE_ADDR,
 };
 
+// User registers that SyscallHandlerAsm saves at the top of the kernel stack
+// (from the lowest address).
+struct SyscallSavedUserRegs {
+  uint64_t rbp;
+  uint64_t rip;
+  uint64_t rflags;
+  uint64_t rsp;
+} __attribute__((packed));
+
+// Most of the commands have only a few arguments.
+using ProcessArgv = std::InlinedVector<KernelString, 4>;
+
 // Reprsents the user process.
 class Process : public KernelThread {
  public:
@@ -25,9 +42,18 @@ class Process : public KernelThread {
   // Adress of the start of the heap.
   static constexpr uint64_t kUserProcessHeapStartAddress = 0x10000000;
 
+  // Range of the address that mmap() can place the mappings. It ends right
+  // below the clock page which is right below the stack (8 MB).
+  static constexpr uint64_t kUserProcessMmapStartAddress = 0x20000000;
+  static constexpr uint64_t kUserProcessMmapEndAddress = 0x3F7FF000;
+
   // Specify nullptr to parent if it is the process is the first process.
   Process(KernelThread* parent, const KernelString& file_name,
           EntryFuncType entry_function, std::string_view working_dir);
+  // Create a copy of the parent process (fork). Child starts running from
+  // user_regs. User memory is shared with the parent as copy on write.
+  Process(Process* parent, const SavedRegisters& user_regs);
+  ~Process() override;
 
   KernelList<Process*>* GetChildrenList() { return &children_; }
   void SetParent(KernelThread* parent) { parent_ = parent; }
@@ -40,12 +66,11 @@ class Process : public KernelThread {
     return pml4e_base_phys_addr_;
   }
 
-  void SetProgramHeaders(std::vector<ELFProgramHeader> headers) {
-    program_headers_ = headers;
-  }
+  // Also registers the loadable segments as the memory areas.
+  void SetProgramHeaders(std::vector<ELFProgramHeader> headers);
 
   void SetSectionHeaders(std::vector<ELFSectionHeader> headers) {
-    section_headers_ = headers;
+    section_headers_ = std::move(headers);
   }
 
   const std::vector<ELFProgramHeader>& GetProgramHeaders() {
@@ -53,8 +78,18 @@ class Process : public KernelThread {
   }
 
   SavedRegisters* GetSavedUserRegs() { return &user_regs_; }
+
+  // Only valid while the process is in the syscall.
+  const SyscallSavedUserRegs* GetSyscallSavedUserRegs() const {
+    return reinterpret_cast<const SyscallSavedUserRegs*>(
+        GetKernelStackTop() - sizeof(SyscallSavedUserRegs));
+  }
   const KernelString& GetFileName() { return file_name_; }
 
+  // Inode number of the executable file.
+  void SetInodeNumber(size_t inode_num) { inode_num_ = inode_num; }
+  size_t GetInodeNumber() const { return inode_num_; }
+
   void SetInKernel() { in_kernel_space_ = true; }
   void SetInUser() { in_kernel_space_ = false; }
 
@@ -68,16 +103,15 @@ class Process : public KernelThread {
 
   FileDescriptorTable& GetFileDescriptorTable() { return fd_table_; }
 
-  // Check whether the address falls within
-  //   - Current process's stack size.
-  //   - ELF segments.
-  //   - Allocated heap area.
-  // Otherwise it is unrecoverable page fault and the process should be
-  // immediately trashed.
+  // Check which memory area (stack, ELF segments, heap or mmap-ed areas) the
+  // address falls within. If it does not belong to any area, it is
+  // unrecoverable page fault and the process should be immediately trashed.
   ProcessAddressInfo GetAddressInfo(uint64_t addr) const;
+
+  VMAreaTree& GetVMAreaTree() { return vm_areas_; }
   ELFProgramHeader GetMatchingProgramHeader(uint64_t addr) const;
 
-  std::vector<KernelString>& GetArgv() { return argv_; }
+  ProcessArgv& GetArgv() { return argv_; }
   void CopyArgvToStack();
 
   int GetNumPageFault() const { return num_page_fault_; }
@@ -86,8 +120,9 @@ class Process : public KernelThread {
   KernelString GetWorkingDir() const { return working_dir_; }
 
   // Increase size of the process heap by (bytes) bytes.
-  // It must be multiple of 4KB (Page size).
-  void IncreaseHeapSize(uint64_t bytes);
+  // It must be multiple of 4KB (Page size). Returns false if the heap would
+  // overlap with other memory areas.
+  bool IncreaseHeapSize(uint64_t bytes);
   void* GetHeapEnd() const;
 
   void ZeroInitIfNeeded(uint64_t boundary);
@@ -98,7 +133,14 @@ class Process : public KernelThread {
   // Load the vector and FPU registers from the saved data.
   void LoadVectorAndFPURegisters();
 
+  // Release every user page of the process. Must be called only when the
+  // process will never go back to the user space.
+  void ReleaseUserMemory();
+
  private:
+  // Unmap every area of the type that is copied from the parent on fork.
+  void DropInheritedAreas(VMArea::Type type);
+
   bool in_kernel_space_;
   SavedRegisters user_regs_;
 
@@ -115,6 +157,7 @@ class Process : public KernelThread {
   std::vector<ELFSectionHeader> section_headers_;
 
   KernelString file_name_;
+  size_t inode_num_;
 
   FileDescriptorTable fd_table_;
 
@@ -122,7 +165,7 @@ class Process : public KernelThread {
   MultiCoreSpinLock exit_code_lock_;
   std::map<pid_t, int> child_to_exit_code_;
 
-  std::vector<KernelString> argv_;
+  ProcessArgv argv_;
 
   int num_page_fault_;
 
@@ -131,6 +174,9 @@ class Process : public KernelThread {
   // Heap size.
   uint64_t heap_size_;
 
+  // Memory areas that the process is allowed to access.
+  VMAreaTree vm_areas_;
+
   // Region where x87 FPU, XMM registers are saved.
   // This must be aligned to 16-byte boundary.
   void* fxsaved_region_;
@@ -147,7 +193,11 @@ class ProcessManager {
                          std::string_view working_dir);
   Process* CreateProcess(std::string_view file_name,
                          std::string_view working_dir,
-                         std::vector<KernelString> argv);
+                         const ProcessArgv& argv);
+
+  // Fork the current process that is in the syscall. Child returns 0 from the
+  // syscall.
+  Process* ForkProcess(Process* parent);
 
  private:
   ProcessManager() {}
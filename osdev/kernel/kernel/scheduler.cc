@@ -63,6 +63,21 @@ KernelListElement<KernelThread*>* KernelThreadScheduler::PopNextThreadToRun() {
   return nullptr;
 }
 
+void KernelThreadScheduler::DrainInbox() {
+  uint32_t cpu_id = CPUContextManager::GetCurrentCPUId();
+  KernelThread* thread = inboxes_[cpu_id].TakeAll();
+  while (thread != nullptr) {
+    KernelThread* next = thread->NextInInbox();
+    thread->SetNextInInbox(nullptr);
+
+    auto* elem = thread->GetKenrelListElem();
+    elem->ChangeList(&kernel_thread_list_[cpu_id]);
+    elem->PushBack();
+
+    thread = next;
+  }
+}
+
 void KernelThreadScheduler::YieldInInterruptHandler(
     CPUInterruptHandlerArgs* args, InterruptHandlerSavedRegs* regs) {
   // Scheduling is not enabled yet!
@@ -72,6 +87,7 @@ void KernelThreadScheduler::YieldInInterruptHandler(
 
   queue_locks_[CPUContextManager::GetCurrentCPUId()].lock();
 
+  DrainInbox();
   auto* next_thread_element = PopNextThreadToRun();
   if (next_thread_element == nullptr) {
     queue_locks_[CPUContextManager::GetCurrentCPUId()].unlock();
@@ -109,11 +125,11 @@ void KernelThreadScheduler::YieldInInterruptHandler(
   // the queue. Hence two same threads are put into the queue.
   //
   // This problem can be prevented by checking whether the thread is already in
-  // queue on step (3).
-  if (current_thread->IsRunnable() && !current_thread->IsInQueue()) {
+  // queue on step (3). Since (2) does not take the queue lock, the check and
+  // the mark must be done at once.
+  if (current_thread->IsRunnable() && current_thread->TryMarkInQueue()) {
     // Move the current thread to run at the back of the queue.
     GetKernelThreadList().push_back(current_thread->GetKenrelListElem());
-    current_thread->SetInQueue(true);
   } else {
     // This thread is no longer in queue (since it is sleeping).
     current_thread->SetInQueue(false);
@@ -159,8 +175,16 @@ void KernelThreadScheduler::YieldInInterruptHandler(
 
   // If the next thread is a user process, then we have to reset CR3
   if (!next_thread->IsKernelThread()) {
-    CPURegsAccessProvider::SetCR3(
-        reinterpret_cast<uint64_t>(next_thread->GetPageTableBaseAddress()));
+    uint64_t page_table =
+        reinterpret_cast<uint64_t>(next_thread->GetPageTableBaseAddress());
+
+    // Mark before loading CR3 so that the TLB shootdown of this page table
+    // does not miss this CPU. Until CR3 is loaded, only the kernel runs here
+    // and loading CR3 flushes the entries of the old one anyway.
+    CPUContext* cpu_context =
+        CPUContextManager::GetCPUContextManager().GetCPUContext();
+    cpu_context->loaded_page_table = page_table;
+    CPURegsAccessProvider::SetCR3(page_table);
   }
 
   KernelThread::SetCurrentThread(next_thread);
@@ -172,40 +196,46 @@ void KernelThreadScheduler::YieldInInterruptHandler(
 
 void KernelThreadScheduler::Yield() { asm volatile("int $0x30\n"); }
 
-void KernelThreadScheduler::EnqueueThread(
-    KernelListElement<KernelThread*>* elem) {
-  uint32_t cpu_id = elem->Get()->CpuId();
-  __atomic_fetch_add(&num_threads_per_core_[cpu_id], 1, __ATOMIC_RELAXED);
+bool KernelThreadScheduler::IsCurrentCoreIdle() {
+  // Scheduling is not enabled yet!
+  if (kernel_thread_list_.empty() || inboxes_.empty()) {
+    return false;
+  }
 
-  // Acquire lock on the scheduling queue.
-  queue_locks_[cpu_id].lock();
+  // Does not need to be exact; the queue may contain the sleeping threads.
+  uint32_t cpu_id = CPUContextManager::GetCurrentCPUId();
+  return kernel_thread_list_[cpu_id].size() == 0 && inboxes_[cpu_id].IsEmpty();
+}
 
-  // Enqueue thread.
-  elem->ChangeList(&kernel_thread_list_[cpu_id]);
-  // QemuSerialLog::Logf("Enqueue %d --> %d \n", elem->Get()->Id(), cpu_id);
-  /*
-  QemuSerialLog::Logf("[EnqueueThread]h %lx t %lx sz : %d t:%d cpu %d t:%d\n",
-                      kernel_thread_list_[cpu_id].head_,
-                      kernel_thread_list_[cpu_id].tail_,
-                      kernel_thread_list_[cpu_id].size_, elem->Get()->Id(),
-                      cpu_id, elem->Get()->Id());
-                      */
+void KernelThreadScheduler::EnqueueThread(
+    KernelListElement<KernelThread*>* elem) {
+  KernelThread* thread = elem->Get();
+  uint32_t cpu_id = thread->CpuId();
 
   // TODO Figure out when elem->Get()->IsInQueue() can be true.
   // (Happens rarely but can't figure out why it is happening).
-  if (!elem->Get()->IsInQueue()) {
-    elem->PushBack();
-    elem->Get()->SetInQueue(true);
-  } else {
+  if (!thread->TryMarkInQueue()) {
     QemuSerialLog::Logf("Already in queue?");
+    return;
   }
-  /*
-  QemuSerialLog::Logf("[aftEnqueueThread]h %lx t %lx sz : %d\n",
-                      kernel_thread_list_[cpu_id].head_,
-                      kernel_thread_list_[cpu_id].tail_,
-                      kernel_thread_list_[cpu_id].size_);
-                      */
+  __atomic_fetch_add(&num_threads_per_core_[cpu_id], 1, __ATOMIC_RELAXED);
 
+  // Do not contend with the scheduler of the other core; it will pick the
+  // thread up from the inbox when it schedules next time.
+  //
+  // Only the thread that finds the inbox empty sends the IPI. Others are
+  // drained together by the one that is already on the way.
+  if (cpu_id != CPUContextManager::GetCurrentCPUId()) {
+    if (inboxes_[cpu_id].Push(thread) &&
+        APICManager::GetAPICManager().IsMulticoreEnabled()) {
+      APICManager::GetAPICManager().SendRescheduleIPI(cpu_id);
+    }
+    return;
+  }
+
+  queue_locks_[cpu_id].lock();
+  elem->ChangeList(&kernel_thread_list_[cpu_id]);
+  elem->PushBack();
   queue_locks_[cpu_id].unlock();
 }
 
@@ -227,11 +257,13 @@ void KernelThreadScheduler::SetCoreCount(int num_core) {
   kernel_thread_list_.reserve(num_core);
   queue_locks_.reserve(num_core);
   num_threads_per_core_.reserve(num_core);
+  inboxes_.reserve(num_core);
 
   for (int i = 0; i < num_core; i++) {
     kernel_thread_list_.push_back(KernelList<KernelThread*>());
     queue_locks_.push_back(MultiCoreSpinLock());
     num_threads_per_core_.push_back(0);
+    inboxes_.push_back(ThreadInbox());
   }
 }
 
@@ -243,3 +275,12 @@ extern "C" void YieldInInterruptHandlerCaller(
   Kernel::KernelThreadScheduler::GetKernelThreadScheduler()
       .YieldInInterruptHandler(args, regs);
 }
+
+extern "C" void RescheduleIPICaller(Kernel::CPUInterruptHandlerArgs* args,
+                                    Kernel::InterruptHandlerSavedRegs* regs) {
+  // EOI must be sent before switching to the other thread; otherwise this core
+  // will not get the next IPI until that thread is switched out.
+  Kernel::APICManager::GetAPICManager().SetEndOfInterrupt();
+  Kernel::KernelThreadScheduler::GetKernelThreadScheduler()
+      .YieldInInterruptHandler(args, regs);
+}
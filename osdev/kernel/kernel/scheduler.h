@@ -6,6 +6,7 @@
 #include "cpu_context.h"
 #include "interrupt.h"
 #include "kthread.h"
+#include "thread_inbox.h"
 
 namespace Kernel {
 
@@ -29,12 +30,16 @@ class KernelThreadScheduler {
   // Each core will have its own kernel thread list.
   void SetCoreCount(int num_core);
 
-  // Enqueue the kernel thread.
+  // Enqueue the kernel thread. If the thread belongs to the other core, it is
+  // put into that core's inbox without taking the lock.
   void EnqueueThread(KernelListElement<KernelThread*>* elem);
 
   // Enqueue the kernel thread for the first time. Core will be chosen.
   void EnqueueThreadFirstTime(KernelListElement<KernelThread*>* elem);
 
+  // Returns true if no other thread is waiting to run on the current core.
+  bool IsCurrentCoreIdle();
+
   const std::vector<int>& NumThreadsPerCore() const {
     return num_threads_per_core_;
   }
@@ -43,6 +48,10 @@ class KernelThreadScheduler {
   KernelThreadScheduler() = default;
   KernelListElement<KernelThread*>* PopNextThreadToRun();
 
+  // Move the threads in the inbox to the scheduling queue of the current
+  // core. The queue lock must be held.
+  void DrainInbox();
+
   // Scheduling queue.
   // NOTE that currently running thread (on CPU) is NOT on the queue.
   std::vector<KernelList<KernelThread*>> kernel_thread_list_;
@@ -51,7 +60,12 @@ class KernelThreadScheduler {
   std::vector<int> num_threads_per_core_;
 
   // Locks for the scheduling queue. MUST be obtained when modifying the queue.
+  // Only the owner core modifies the queue; the other cores use the inbox.
   std::vector<MultiCoreSpinLock> queue_locks_;
+
+  // Threads that are woken up by the other cores. Drained to the scheduling
+  // queue by the owner core when it schedules.
+  std::vector<ThreadInbox> inboxes_;
 };
 
 extern "C" void YieldInInterruptHandlerCaller(
@@ -1,6 +1,8 @@
 #ifndef SYS_SYS_EXIT_H
 #define SYS_SYS_EXIT_H
 
+#include "../graphic.h"
+#include "../io_ring.h"
 #include "../kthread.h"
 #include "../process.h"
 #include "sys.h"
@@ -19,10 +21,18 @@ class SysExitHandler : public SyscallHandler<SysExitHandler> {
     }
     // kprintf("Terminate thread : %d %d\n", exit_num, current_thread->Id());
 
+    // The I/O ring worker must be done with the descriptors first.
+    IORingManager::GetIORingManager().Release(process->Id());
+
     // Let descriptors know that this process is now being terminated.
     // It will probably remove descriptors that are not being used anymore.
     process->GetFileDescriptorTable().RemoveProcessIdToDescriptors(
         process->Id());
+
+    // The process will never go back to the user space. Release the user pages
+    // now rather than waiting for someone to delete the process.
+    GraphicManager::GetGraphicManager().ReleaseFrameBuffer(process->Id());
+    process->ReleaseUserMemory();
     process->Terminate();
 
     return exit_code;
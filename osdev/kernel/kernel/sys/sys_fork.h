@@ -0,0 +1,28 @@
+#ifndef SYS_SYS_FORK_H
+#define SYS_SYS_FORK_H
+
+#include "../kthread.h"
+#include "../process.h"
+#include "../qemu_log.h"
+#include "sys.h"
+
+namespace Kernel {
+
+class SysForkHandler : public SyscallHandler<SysForkHandler> {
+ public:
+  // Returns the pid of the child to the parent. Child gets 0.
+  int SysFork() {
+    ASSERT(!KernelThread::CurrentThread()->IsKernelThread());
+    Process* parent = static_cast<Process*>(KernelThread::CurrentThread());
+
+    Process* child = ProcessManager::GetProcessManager().ForkProcess(parent);
+    QemuSerialLog::Logf("Forked process pid: %d \n", child->Id());
+
+    child->Start();
+    return child->Id();
+  }
+};
+
+}  // namespace Kernel
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef SYS_SYS_IO_BATCH_H
+#define SYS_SYS_IO_BATCH_H
+
+#include "sys.h"
+#include "sys_pread.h"
+#include "sys_read.h"
+#include "sys_write.h"
+
+namespace Kernel {
+
+// Single operation of the batch. Same as struct io_batch_op of the libc.
+struct IOBatchOp {
+  enum Op { READ = 0, WRITE = 1, PREAD = 2 };
+
+  int op;
+  int fd;
+  void* buf;
+  size_t count;
+
+  // Only used by PREAD.
+  off_t offset;
+
+  // Filled by the kernel. Same as what the single syscall would return.
+  int64_t result;
+};
+
+// Run many read/write operations with one syscall. Operations are run in
+// order, and the failure of one does not stop the others.
+class SysIOBatchHandler : public SyscallHandler<SysIOBatchHandler> {
+ public:
+  // Returns the number of operations that are run, or -1 if num_ops is
+  // invalid.
+  int SysIOBatch(IOBatchOp* ops, int num_ops) {
+    if (num_ops < 0) {
+      return -1;
+    }
+
+    for (int i = 0; i < num_ops; i++) {
+      IOBatchOp op = ops[i];
+      switch (op.op) {
+        case IOBatchOp::READ:
+          op.result = static_cast<int64_t>(SysReadHandler::GetHandler().SysRead(
+              op.fd, reinterpret_cast<char*>(op.buf), op.count));
+          break;
+        case IOBatchOp::WRITE:
+          op.result =
+              static_cast<int64_t>(SysWriteHandler::GetHandler().SysWrite(
+                  op.fd, reinterpret_cast<uint8_t*>(op.buf), op.count));
+          break;
+        case IOBatchOp::PREAD:
+          op.result =
+              static_cast<int64_t>(SysPreadHandler::GetHandler().SysPread(
+                  op.fd, reinterpret_cast<char*>(op.buf), op.count, op.offset));
+          break;
+        default:
+          op.result = -1;
+          break;
+      }
+      ops[i].result = op.result;
+    }
+    return num_ops;
+  }
+};
+
+}  // namespace Kernel
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef SYS_SYS_IO_RING_H
+#define SYS_SYS_IO_RING_H
+
+#include "../io_ring.h"
+#include "../kthread.h"
+#include "../process.h"
+#include "sys.h"
+
+namespace Kernel {
+
+class SysIORingSetupHandler : public SyscallHandler<SysIORingSetupHandler> {
+ public:
+  // Returns the user address of the ring. Returns -1 on failure.
+  int64_t SysIORingSetup(uint32_t num_entries, uint64_t buf_size) {
+    ASSERT(!KernelThread::CurrentThread()->IsKernelThread());
+    Process* process = static_cast<Process*>(KernelThread::CurrentThread());
+
+    uint64_t addr = IORingManager::GetIORingManager().Setup(
+        process, num_entries, buf_size);
+    if (addr == 0) {
+      return -1;
+    }
+    return addr;
+  }
+};
+
+// Lets the worker pick up the queued submissions, and waits for the
+// completions without spinning.
+class SysIORingEnterHandler : public SyscallHandler<SysIORingEnterHandler> {
+ public:
+  // Returns the number of completions to reap. Returns -1 if the process does
+  // not have the ring.
+  int SysIORingEnter(uint32_t min_complete) {
+    ASSERT(!KernelThread::CurrentThread()->IsKernelThread());
+    Process* process = static_cast<Process*>(KernelThread::CurrentThread());
+
+    return IORingManager::GetIORingManager().Wait(process->Id(), min_complete);
+  }
+};
+
+}  // namespace Kernel
+
+#endif
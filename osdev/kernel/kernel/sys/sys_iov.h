@@ -0,0 +1,74 @@
+#ifndef SYS_SYS_IOV_H
+#define SYS_SYS_IOV_H
+
+#include "sys.h"
+#include "sys_read.h"
+#include "sys_write.h"
+
+namespace Kernel {
+
+// Same as struct iovec.
+struct IOVec {
+  void* base;
+  size_t len;
+};
+
+// readv and writev. Buffers are handled in order by the single buffer
+// handlers, and it stops at the first short read (or write).
+class SysReadvHandler : public SyscallHandler<SysReadvHandler> {
+ public:
+  // Returns the total bytes read, or -1 if the first read fails.
+  int64_t SysReadv(int fd, const IOVec* iov, int iovcnt) {
+    if (iovcnt < 0) {
+      return -1;
+    }
+
+    int64_t total = 0;
+    for (int i = 0; i < iovcnt; i++) {
+      IOVec vec = iov[i];
+      int64_t num_read =
+          static_cast<int64_t>(SysReadHandler::GetHandler().SysRead(
+              fd, reinterpret_cast<char*>(vec.base), vec.len));
+      if (num_read < 0) {
+        return total == 0 ? -1 : total;
+      }
+
+      total += num_read;
+      if (static_cast<size_t>(num_read) < vec.len) {
+        break;
+      }
+    }
+    return total;
+  }
+};
+
+class SysWritevHandler : public SyscallHandler<SysWritevHandler> {
+ public:
+  // Returns the total bytes written, or -1 if the first write fails.
+  int64_t SysWritev(int fd, const IOVec* iov, int iovcnt) {
+    if (iovcnt < 0) {
+      return -1;
+    }
+
+    int64_t total = 0;
+    for (int i = 0; i < iovcnt; i++) {
+      IOVec vec = iov[i];
+      int64_t num_write =
+          static_cast<int64_t>(SysWriteHandler::GetHandler().SysWrite(
+              fd, reinterpret_cast<uint8_t*>(vec.base), vec.len));
+      if (num_write < 0) {
+        return total == 0 ? -1 : total;
+      }
+
+      total += num_write;
+      if (static_cast<size_t>(num_write) < vec.len) {
+        break;
+      }
+    }
+    return total;
+  }
+};
+
+}  // namespace Kernel
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef SYS_SYS_MMAP_H
+#define SYS_SYS_MMAP_H
+
+#include "../fs/actual_file_desc.h"
+#include "../process.h"
+#include "../qemu_log.h"
+#include "../vm_area.h"
+#include "sys.h"
+
+namespace Kernel {
+
+// Only reserves the memory area. Pages are brought by the page fault handler
+// when they are touched.
+class SysMmapHandler : public SyscallHandler<SysMmapHandler> {
+ public:
+  static constexpr int MAP_SHARED = 0x1;
+  static constexpr int MAP_PRIVATE = 0x2;
+  static constexpr int MAP_FIXED = 0x10;
+  static constexpr int MAP_ANONYMOUS = 0x20;
+
+  // Returns the start address of the mapping. Returns -1 on failure.
+  int64_t SysMmap(uint64_t addr, size_t length, int prot, int flags, int fd,
+                  off_t offset) {
+    ASSERT(!KernelThread::CurrentThread()->IsKernelThread());
+    Process* process = static_cast<Process*>(KernelThread::CurrentThread());
+
+    static constexpr uint64_t kFourKB = (1 << 12);
+    if (length == 0 || addr % kFourKB != 0 || offset % kFourKB != 0) {
+      return -1;
+    }
+    if (prot & ~(VMArea::kProtRead | VMArea::kProtWrite | VMArea::kProtExec)) {
+      return -1;
+    }
+
+    // Reject before rounding up; otherwise the huge length wraps to 0.
+    static constexpr uint64_t kMmapSize = Process::kUserProcessMmapEndAddress -
+                                          Process::kUserProcessMmapStartAddress;
+    if (length > kMmapSize) {
+      return -1;
+    }
+    length = (length + kFourKB - 1) & ~(kFourKB - 1);
+
+    VMArea area{0, 0, VMArea::ANONYMOUS, prot, 0, 0};
+    if (!(flags & MAP_ANONYMOUS)) {
+      FileDescriptor* desc = process->GetFileDescriptorTable().GetDescriptor(fd);
+      if (desc == nullptr ||
+          desc->GetDescriptorType() != FileDescriptor::ACTUAL_FILE) {
+        return -1;
+      }
+
+      // Only the read only (or private) file mappings are supported since
+      // the write is never propagated back to the file.
+      if ((prot & VMArea::kProtWrite) && !(flags & MAP_PRIVATE)) {
+        return -1;
+      }
+
+      area.type = VMArea::FILE;
+      area.inode_num = static_cast<ActualFileDescriptor*>(desc)->GetInodeNum();
+      area.file_offset = offset;
+    }
+
+    VMAreaTree& vm_areas = process->GetVMAreaTree();
+    if (flags & MAP_FIXED) {
+      // Only allow the fixed mapping within the mmap area. Compare before
+      // adding so that addr + length does not overflow.
+      if (addr < Process::kUserProcessMmapStartAddress ||
+          addr >= Process::kUserProcessMmapEndAddress ||
+          length > Process::kUserProcessMmapEndAddress - addr) {
+        return -1;
+      }
+      area.start = addr;
+    } else {
+      area.start = vm_areas.FindFreeRange(
+          length, Process::kUserProcessMmapStartAddress,
+          Process::kUserProcessMmapEndAddress);
+      if (area.start == 0) {
+        return -1;
+      }
+    }
+    area.end = area.start + length;
+
+    if (!vm_areas.AddArea(area)) {
+      return -1;
+    }
+
+    QemuSerialLog::Logf("mmap [%lx, %lx) type : %d\n", area.start, area.end,
+                        area.type);
+    return area.start;
+  }
+};
+
+}  // namespace Kernel
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef SYS_SYS_MUNMAP_H
+#define SYS_SYS_MUNMAP_H
+
+#include "../paging.h"
+#include "../process.h"
+#include "../vm_area.h"
+#include "sys.h"
+
+namespace Kernel {
+
+class SysMunmapHandler : public SyscallHandler<SysMunmapHandler> {
+ public:
+  // Returns 0 on success and -1 on failure.
+  int SysMunmap(uint64_t addr, size_t length) {
+    ASSERT(!KernelThread::CurrentThread()->IsKernelThread());
+    Process* process = static_cast<Process*>(KernelThread::CurrentThread());
+
+    static constexpr uint64_t kFourKB = (1 << 12);
+    if (length == 0 || addr % kFourKB != 0) {
+      return -1;
+    }
+
+    // Never let the user touch the page tables outside of the mmap region
+    // (e.g the kernel's, which are shared by every process). Compare before
+    // adding so that addr + length does not overflow.
+    if (addr < Process::kUserProcessMmapStartAddress ||
+        addr >= Process::kUserProcessMmapEndAddress ||
+        length > Process::kUserProcessMmapEndAddress - addr) {
+      return -1;
+    }
+    length = (length + kFourKB - 1) & ~(kFourKB - 1);
+    if (length > Process::kUserProcessMmapEndAddress - addr) {
+      return -1;
+    }
+
+    // Only the areas that are created by mmap can be unmapped.
+    VMAreaTree& vm_areas = process->GetVMAreaTree();
+    std::vector<VMArea> areas = vm_areas.GetAreasInRange(addr, addr + length);
+    for (const auto& area : areas) {
+      if (area.type != VMArea::ANONYMOUS && area.type != VMArea::FILE) {
+        return -1;
+      }
+    }
+
+    vm_areas.RemoveRange(addr, addr + length);
+    PageTableManager::GetPageTableManager().UnmapUserPages(
+        process->GetPageTableBaseAddress(), addr, length);
+    return 0;
+  }
+};
+
+}  // namespace Kernel
+
+#endif
@@ -1,6 +1,7 @@
 #ifndef SYS_SYS_READ_H
 #define SYS_SYS_READ_H
 
+#include "../console.h"
 #include "../fs/actual_file_desc.h"
 #include "../kthread.h"
 #include "../pipe.h"
@@ -30,6 +31,12 @@ class SysReadHandler : public SyscallHandler<SysReadHandler> {
           static_cast<ActualFileDescriptor*>(desc);
       return actual_file_desc->Read(buf, count);
     } else if (desc->GetDescriptorType() == FileDescriptor::PIPE_READ) {
+      // The process may wait for the input; show what it has printed (e.g
+      // the prompt without the newline) first.
+      if (fd == FileDescriptorTable::STDIO::STDIN) {
+        KernelConsole::GetKernelConsole().FlushTerminal();
+      }
+
       PipeDescriptorReadEnd* read_end =
           static_cast<PipeDescriptorReadEnd*>(desc);
       return read_end->Read(buf, count);
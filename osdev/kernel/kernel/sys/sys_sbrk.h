@@ -31,7 +31,10 @@ class SysSbrkHandler : public SyscallHandler<SysSbrkHandler> {
     }
 
     QemuSerialLog::Logf("Request size : %d", RoundUpToMultipleOfFourKb(bytes));
-    process->IncreaseHeapSize(RoundUpToMultipleOfFourKb(bytes));
+    if (!process->IncreaseHeapSize(RoundUpToMultipleOfFourKb(bytes))) {
+      // Heap can't grow into other memory areas.
+      return reinterpret_cast<void*>(-1);
+    }
     return prev_brk;
   }
 };
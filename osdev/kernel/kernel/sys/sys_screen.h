@@ -8,7 +8,12 @@
 
 namespace Kernel {
 
-enum SysScreenCommands { GET_SCREEN_INFO, COPY_FRAME_BUFFER };
+enum SysScreenCommands {
+  GET_SCREEN_INFO,
+  COPY_FRAME_BUFFER,
+  MAP_FRAME_BUFFER,
+  PRESENT_FRAME_BUFFER
+};
 
 struct ScreenInfo {
   int width;
@@ -34,6 +39,15 @@ class SysScreenHandler : public SyscallHandler<SysScreenHandler> {
           reinterpret_cast<uint32_t*>(arg1),
           reinterpret_cast<GraphicManager::FrameBufferInfo*>(arg2));
       return 0;
+    } else if (command == MAP_FRAME_BUFFER) {
+      // Returns the address of the shared frame buffer (0 on failure).
+      Process* process = static_cast<Process*>(KernelThread::CurrentThread());
+      GraphicManager::FrameBufferInfo info =
+          *reinterpret_cast<GraphicManager::FrameBufferInfo*>(arg1);
+      return gm.MapFrameBuffer(process, info);
+    } else if (command == PRESENT_FRAME_BUFFER) {
+      return gm.PresentFrameBuffer(KernelThread::CurrentThread()->Id()) ? 0
+                                                                         : 1;
     }
     return 1;
   }
@@ -25,6 +25,7 @@ class SysWriteHandler : public SyscallHandler<SysWriteHandler> {
       KernelConsole::GetKernelConsole().PrintToTerminal(
           reinterpret_cast<char*>(buf), count);
       // kprintf("%s", buf);
+      return count;
     } else if (desc->GetDescriptorType() == FileDescriptor::ACTUAL_FILE) {
       ActualFileDescriptor* actual_file_desc =
           static_cast<ActualFileDescriptor*>(desc);
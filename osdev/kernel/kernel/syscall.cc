@@ -1,14 +1,21 @@
 #include "syscall.h"
 
+#include "../std/algorithm.h"
 #include "../std/printf.h"
 #include "./fs/ext2.h"
 #include "./sys/sys_console.h"
 #include "./sys/sys_dup2.h"
 #include "./sys/sys_exit.h"
+#include "./sys/sys_fork.h"
 #include "./sys/sys_getcwd.h"
 #include "./sys/sys_getdents.h"
+#include "./sys/sys_io_batch.h"
+#include "./sys/sys_io_ring.h"
+#include "./sys/sys_iov.h"
 #include "./sys/sys_lseek.h"
+#include "./sys/sys_mmap.h"
 #include "./sys/sys_mstick.h"
+#include "./sys/sys_munmap.h"
 #include "./sys/sys_open.h"
 #include "./sys/sys_pipe.h"
 #include "./sys/sys_pread.h"
@@ -20,7 +27,6 @@
 #include "./sys/sys_usleep.h"
 #include "./sys/sys_waitpid.h"
 #include "./sys/sys_write.h"
-#include "cpp_macro.h"
 #include "cpu.h"
 #include "cpu_context.h"
 #include "descriptor_table.h"
@@ -41,6 +47,202 @@ static constexpr uint32_t kFMASK_MSR = 0xC000'0084;
 static constexpr uint32_t kEEFR_MSR = 0xC000'0080;
 static constexpr uint32_t kEnableSyscallExtensionBit = 0x1;
 
+// Log every syscall (except write) to the serial port. Very slow.
+static constexpr bool kLogSyscalls = false;
+
+namespace {
+
+// Every entry takes all six syscall arguments and uses what it needs.
+using SyscallFunc = int64_t (*)(uint64_t arg1, uint64_t arg2, uint64_t arg3,
+                                uint64_t arg4, uint64_t arg5, uint64_t arg6);
+
+int64_t SysExitEntry(uint64_t arg1, uint64_t, uint64_t, uint64_t, uint64_t,
+                     uint64_t) {
+  SysExitHandler::GetHandler().SysExit(arg1);
+  return 0;
+}
+
+int64_t SysReadEntry(uint64_t arg1, uint64_t arg2, uint64_t arg3, uint64_t,
+                     uint64_t, uint64_t) {
+  return SysReadHandler::GetHandler().SysRead(
+      static_cast<int>(arg1), reinterpret_cast<char*>(arg2), arg3);
+}
+
+int64_t SysWriteEntry(uint64_t arg1, uint64_t arg2, uint64_t arg3, uint64_t,
+                      uint64_t, uint64_t) {
+  return SysWriteHandler::GetHandler().SysWrite(
+      static_cast<int>(arg1), reinterpret_cast<uint8_t*>(arg2), arg3);
+}
+
+int64_t SysForkEntry(uint64_t, uint64_t, uint64_t, uint64_t, uint64_t,
+                     uint64_t) {
+  return SysForkHandler::GetHandler().SysFork();
+}
+
+int64_t SysSpawnEntry(uint64_t arg1, uint64_t arg2, uint64_t, uint64_t,
+                      uint64_t, uint64_t) {
+  return SysSpawnHandler::GetHandler().SysSpawn(
+      reinterpret_cast<pid_t*>(arg1), reinterpret_cast<const char*>(arg2));
+}
+
+int64_t SysWaitpidEntry(uint64_t arg1, uint64_t arg2, uint64_t, uint64_t,
+                        uint64_t, uint64_t) {
+  return SysWaitpidHandler::GetHandler().SysWaitpid(
+      reinterpret_cast<pid_t>(arg1), reinterpret_cast<int*>(arg2));
+}
+
+int64_t SysOpenEntry(uint64_t arg1, uint64_t arg2, uint64_t, uint64_t, uint64_t,
+                     uint64_t) {
+  return SysOpenHandler::GetHandler().SysOpen(
+      reinterpret_cast<const char*>(arg1), arg2);
+}
+
+int64_t SysPipeEntry(uint64_t arg1, uint64_t, uint64_t, uint64_t, uint64_t,
+                     uint64_t) {
+  return SysPipeHandler::GetHandler().SysPipe(reinterpret_cast<int*>(arg1));
+}
+
+int64_t SysDup2Entry(uint64_t arg1, uint64_t arg2, uint64_t, uint64_t, uint64_t,
+                     uint64_t) {
+  return SysDup2Handler::GetHandler().SysDup2(arg1, arg2);
+}
+
+int64_t SysStatEntry(uint64_t arg1, uint64_t arg2, uint64_t, uint64_t, uint64_t,
+                     uint64_t) {
+  return SysStatHandler::GetHandler().SysStat(
+      reinterpret_cast<const char*>(arg1), reinterpret_cast<FileInfo*>(arg2));
+}
+
+int64_t SysSbrkEntry(uint64_t arg1, uint64_t, uint64_t, uint64_t, uint64_t,
+                     uint64_t) {
+  return reinterpret_cast<uint64_t>(SysSbrkHandler::GetHandler().SysSbrk(arg1));
+}
+
+int64_t SysGetDentsEntry(uint64_t arg1, uint64_t arg2, uint64_t arg3, uint64_t,
+                         uint64_t, uint64_t) {
+  return SysGetDentsHandler::GetHandler().SysGetDents(
+      arg1, reinterpret_cast<linux_dirent*>(arg2), arg3);
+}
+
+int64_t SysGetCWDEntry(uint64_t arg1, uint64_t arg2, uint64_t, uint64_t,
+                       uint64_t, uint64_t) {
+  return reinterpret_cast<uint64_t>(SysGetCWDHandler::GetHandler().SysGetCWD(
+      reinterpret_cast<char*>(arg1), arg2));
+}
+
+int64_t SysConsoleEntry(uint64_t arg1, uint64_t, uint64_t, uint64_t, uint64_t,
+                        uint64_t) {
+  return SysConsoleHandler::GetHandler().SysConsole(
+      static_cast<SysConsoleCommands>(arg1));
+}
+
+int64_t SysScreenEntry(uint64_t arg1, uint64_t arg2, uint64_t arg3, uint64_t,
+                       uint64_t, uint64_t) {
+  return SysScreenHandler::GetHandler().SysScreen(
+      static_cast<SysScreenCommands>(arg1), reinterpret_cast<void*>(arg2),
+      reinterpret_cast<void*>(arg3));
+}
+
+int64_t SysUSleepEntry(uint64_t arg1, uint64_t, uint64_t, uint64_t, uint64_t,
+                       uint64_t) {
+  return SysUSleepHandler::GetHandler().SysUSleep(arg1);
+}
+
+int64_t SysMsTickEntry(uint64_t, uint64_t, uint64_t, uint64_t, uint64_t,
+                       uint64_t) {
+  return SysMsTickHandler::GetHandler().SysMsTick();
+}
+
+int64_t SysPreadEntry(uint64_t arg1, uint64_t arg2, uint64_t arg3,
+                      uint64_t arg4, uint64_t, uint64_t) {
+  return SysPreadHandler::GetHandler().SysPread(
+      arg1, reinterpret_cast<char*>(arg2), arg3, arg4);
+}
+
+int64_t SysLseekEntry(uint64_t arg1, uint64_t arg2, uint64_t arg3, uint64_t,
+                      uint64_t, uint64_t) {
+  return SysLseekHandler::GetHandler().SysLseek(arg1, arg2, arg3);
+}
+
+int64_t SysMmapEntry(uint64_t arg1, uint64_t arg2, uint64_t arg3, uint64_t arg4,
+                     uint64_t arg5, uint64_t arg6) {
+  return SysMmapHandler::GetHandler().SysMmap(arg1, arg2, arg3, arg4, arg5,
+                                              arg6);
+}
+
+int64_t SysMunmapEntry(uint64_t arg1, uint64_t arg2, uint64_t, uint64_t,
+                       uint64_t, uint64_t) {
+  return SysMunmapHandler::GetHandler().SysMunmap(arg1, arg2);
+}
+
+int64_t SysReadvEntry(uint64_t arg1, uint64_t arg2, uint64_t arg3, uint64_t,
+                      uint64_t, uint64_t) {
+  return SysReadvHandler::GetHandler().SysReadv(
+      arg1, reinterpret_cast<const IOVec*>(arg2), arg3);
+}
+
+int64_t SysWritevEntry(uint64_t arg1, uint64_t arg2, uint64_t arg3, uint64_t,
+                       uint64_t, uint64_t) {
+  return SysWritevHandler::GetHandler().SysWritev(
+      arg1, reinterpret_cast<const IOVec*>(arg2), arg3);
+}
+
+int64_t SysIOBatchEntry(uint64_t arg1, uint64_t arg2, uint64_t, uint64_t,
+                        uint64_t, uint64_t) {
+  return SysIOBatchHandler::GetHandler().SysIOBatch(
+      reinterpret_cast<IOBatchOp*>(arg1), arg2);
+}
+
+int64_t SysIORingSetupEntry(uint64_t arg1, uint64_t arg2, uint64_t, uint64_t,
+                            uint64_t, uint64_t) {
+  return SysIORingSetupHandler::GetHandler().SysIORingSetup(arg1, arg2);
+}
+
+int64_t SysIORingEnterEntry(uint64_t arg1, uint64_t, uint64_t, uint64_t,
+                            uint64_t, uint64_t) {
+  return SysIORingEnterHandler::GetHandler().SysIORingEnter(arg1);
+}
+
+struct SyscallEntry {
+  const char* name;
+  SyscallFunc handler;
+};
+
+// Indexed by SyscallNumbers.
+constexpr SyscallEntry kSyscallTable[] = {
+    {"exit", SysExitEntry},                  // 0
+    {"read", SysReadEntry},                  // 1
+    {"write", SysWriteEntry},                // 2
+    {"fork", SysForkEntry},                  // 3
+    {"exec", nullptr},                       // 4
+    {"spawn", SysSpawnEntry},                // 5
+    {"waitpid", SysWaitpidEntry},            // 6
+    {"open", SysOpenEntry},                  // 7
+    {"pipe", SysPipeEntry},                  // 8
+    {"dup2", SysDup2Entry},                  // 9
+    {"stat", SysStatEntry},                  // 10
+    {"sbrk", SysSbrkEntry},                  // 11
+    {"getdents", SysGetDentsEntry},          // 12
+    {"getcwd", SysGetCWDEntry},              // 13
+    {"console", SysConsoleEntry},            // 14
+    {"screen", SysScreenEntry},              // 15
+    {"usleep", SysUSleepEntry},              // 16
+    {"mstick", SysMsTickEntry},              // 17
+    {"pread", SysPreadEntry},                // 18
+    {"lseek", SysLseekEntry},                // 19
+    {"mmap", SysMmapEntry},                  // 20
+    {"munmap", SysMunmapEntry},              // 21
+    {"readv", SysReadvEntry},                // 22
+    {"writev", SysWritevEntry},              // 23
+    {"io_batch", SysIOBatchEntry},           // 24
+    {"io_ring_setup", SysIORingSetupEntry},  // 25
+    {"io_ring_enter", SysIORingEnterEntry},  // 26
+};
+static_assert(sizeof(kSyscallTable) / sizeof(SyscallEntry) == kNumSyscalls,
+              "Every syscall must be in the table");
+
+}  // namespace
+
 // WARNING Caller of this function MUST save RBX and R12.
 
 // This function is called upon "syscall" instruction from the user process.
@@ -65,6 +267,8 @@ __attribute__((naked)) void SyscallHandlerAsm() {
       "push %%r12\n" // Save Previous RSP.
       "push %%r11\n" // Save Previous RFLAGS.
       "push %%rcx\n" // Save Previous RIP.
+      "push %%rbp\n" // Save Previous RBP (needed by fork).
+      "sub $8, %%rsp\n" // Keep the stack 16 byte aligned.
 
       "push %%r9\n"
       "movq %%r8, %%r9\n" // Fifth syscall arg to arg5
@@ -75,6 +279,8 @@ __attribute__((naked)) void SyscallHandlerAsm() {
       "movq %%rax, %%rdi\n" // EAX to syscall_num
       "call SyscallHandlerCaller\n"
       "pop %%r9\n"
+      "add $8, %%rsp\n"
+      "pop %%rbp\n"
       "pop %%rcx\n"
       "pop %%r11\n"
       "pop %%r12\n"
@@ -114,10 +320,13 @@ void SyscallManager::InitSyscall() {
   CPURegsAccessProvider::SetMSR(kSTAR_MSR, star_lo, star_hi);
 }
 
-int SyscallManager::SyscallHandler(uint64_t syscall_num, uint64_t arg1,
-                                   uint64_t arg2, uint64_t arg3, uint64_t arg4,
-                                   uint64_t arg5, uint64_t arg6) {
-  if (syscall_num != 2) {
+int64_t SyscallManager::SyscallHandler(uint64_t syscall_num, uint64_t arg1,
+                                       uint64_t arg2, uint64_t arg3,
+                                       uint64_t arg4, uint64_t arg5,
+                                       uint64_t arg6) {
+  const uint64_t start = CPURegsAccessProvider::ReadTimeStampCounter();
+
+  if (kLogSyscalls && syscall_num != SYS_WRITE) {
     QemuSerialLog::Logf("Syscall %d [pid:%d] [CPU:%d] %lx \n", syscall_num,
                         KernelThread::CurrentThread()->Id(),
                         CPUContextManager::GetCurrentCPUId(),
@@ -135,85 +344,19 @@ int SyscallManager::SyscallHandler(uint64_t syscall_num, uint64_t arg1,
     PANIC();
   }
 
-  int ret = 0;
-  switch (syscall_num) {
-    case SYS_EXIT:  // 0
-      SysExitHandler::GetHandler().SysExit(arg1);
-      break;
-    case SYS_READ:  // 1
-      ret = SysReadHandler::GetHandler().SysRead(
-          static_cast<int>(arg1), reinterpret_cast<char*>(arg2), arg3);
-      break;
-    case SYS_WRITE:  // 2
-      ret = SysWriteHandler::GetHandler().SysWrite(
-          static_cast<int>(arg1), reinterpret_cast<uint8_t*>(arg2), arg3);
-      break;
-    case SYS_SPAWN:  // 5
-      ret = SysSpawnHandler::GetHandler().SysSpawn(
-          reinterpret_cast<pid_t*>(arg1), reinterpret_cast<const char*>(arg2));
-      break;
-    case SYS_WAITPID:  // 6
-      ret = SysWaitpidHandler::GetHandler().SysWaitpid(
-          reinterpret_cast<pid_t>(arg1), reinterpret_cast<int*>(arg2));
-      break;
-    case SYS_OPEN:  // 7
-      ret = SysOpenHandler::GetHandler().SysOpen(
-          reinterpret_cast<const char*>(arg1), arg2);
-      break;
-    case SYS_PIPE:  // 8
-      ret = SysPipeHandler::GetHandler().SysPipe(reinterpret_cast<int*>(arg1));
-      break;
-    case SYS_DUP2:  // 9
-      ret = SysDup2Handler::GetHandler().SysDup2(arg1, arg2);
-      break;
-    case SYS_STAT:  // 10
-      ret = SysStatHandler::GetHandler().SysStat(
-          reinterpret_cast<const char*>(arg1),
-          reinterpret_cast<FileInfo*>(arg2));
-      break;
-    case SYS_SBRK:  // 11
-      ret = reinterpret_cast<uint64_t>(
-          SysSbrkHandler::GetHandler().SysSbrk(arg1));
-      break;
-    case SYS_GETDENTS:  // 12
-      ret = SysGetDentsHandler::GetHandler().SysGetDents(
-          arg1, reinterpret_cast<linux_dirent*>(arg2), arg3);
-      break;
-    case SYS_GETCWD:  // 13
-      ret = reinterpret_cast<uint64_t>(SysGetCWDHandler::GetHandler().SysGetCWD(
-          reinterpret_cast<char*>(arg1), arg2));
-      break;
-    case SYS_CONSOLE:  // 14
-      ret =
-          reinterpret_cast<uint64_t>(SysConsoleHandler::GetHandler().SysConsole(
-              static_cast<SysConsoleCommands>(arg1)));
-      break;
-    case SYS_SCREEN:  // 15
-      ret = reinterpret_cast<uint64_t>(SysScreenHandler::GetHandler().SysScreen(
-          static_cast<SysScreenCommands>(arg1), reinterpret_cast<void*>(arg2),
-          reinterpret_cast<void*>(arg3)));
-      break;
-    case SYS_USLEEP:  // 16
-      ret = reinterpret_cast<uint64_t>(
-          SysUSleepHandler::GetHandler().SysUSleep(arg1));
-      break;
-    case SYS_MSTICK:  // 17
-      ret = reinterpret_cast<uint64_t>(
-          SysMsTickHandler::GetHandler().SysMsTick());
-      break;
-    case SYS_PREAD:  // 18
-      ret = reinterpret_cast<uint64_t>(SysPreadHandler::GetHandler().SysPread(
-          arg1, reinterpret_cast<char*>(arg2), arg3, arg4));
-      break;
-    case SYS_LSEEK:  // 19
-      ret = reinterpret_cast<uint64_t>(
-          SysLseekHandler::GetHandler().SysLseek(arg1, arg2, arg3));
-      break;
+  int64_t ret = 0;
+  if (syscall_num < kNumSyscalls &&
+      kSyscallTable[syscall_num].handler != nullptr) {
+    ret = kSyscallTable[syscall_num].handler(arg1, arg2, arg3, arg4, arg5,
+                                             arg6);
   }
 
   TaskStateSegmentManager::GetTaskStateSegmentManager().SetRSP0(
       KernelThread::CurrentThread()->GetKernelStackTop());
 
+  RecordStat(syscall_num,
+             CPURegsAccessProvider::ReadTimeStampCounter() - start);
+
   // If current kernel thread is terminate ready, then we just terminate instead
   // of returning from the syscall handler.
   KernelThread* current_thread = KernelThread::CurrentThread();
@@ -221,20 +364,65 @@ int SyscallManager::SyscallHandler(uint64_t syscall_num, uint64_t arg1,
     current_thread->MakeTerminate();
   }
 
-  UNUSED(syscall_num);
-  UNUSED(arg1);
-  UNUSED(arg2);
-  UNUSED(arg3);
-  UNUSED(arg4);
-  UNUSED(arg5);
-  UNUSED(arg6);
-
   return ret;
 }
 
-extern "C" int SyscallHandlerCaller(uint64_t syscall_num, uint64_t arg1,
-                                    uint64_t arg2, uint64_t arg3, uint64_t arg4,
-                                    uint64_t arg5, uint64_t arg6) {
+void SyscallManager::SetCoreCount(int num_core) {
+  num_core_ = num_core;
+  stats_ = reinterpret_cast<SyscallStat*>(
+      kmalloc(sizeof(SyscallStat) * num_core * kNumSyscalls));
+  ResetStats();
+}
+
+void SyscallManager::RecordStat(uint64_t syscall_num, uint64_t cycles) {
+  if (stats_ == nullptr || syscall_num >= kNumSyscalls) {
+    return;
+  }
+
+  // Other thread on this CPU must not update the counters in the middle.
+  uint64_t rflags = CPURegsAccessProvider::GetRFlags();
+  CPURegsAccessProvider::DisableInterrupt();
+
+  uint32_t cpu_id = CPUContextManager::GetCurrentCPUId();
+  ASSERT(cpu_id < static_cast<uint32_t>(num_core_));
+
+  SyscallStat& stat = stats_[cpu_id * kNumSyscalls + syscall_num];
+  stat.count++;
+  stat.total_cycles += cycles;
+  stat.max_cycles = max(stat.max_cycles, cycles);
+
+  CPURegsAccessProvider::SetRFlags(rflags);
+}
+
+void SyscallManager::PrintStats() {
+  kprintf("[Syscall] [Count] [Avg cycles] [Max cycles] [Total cycles]\n");
+  for (uint64_t num = 0; num < kNumSyscalls; num++) {
+    SyscallStat sum{0, 0, 0};
+    for (int cpu = 0; cpu < num_core_; cpu++) {
+      const SyscallStat& stat = stats_[cpu * kNumSyscalls + num];
+      sum.count += stat.count;
+      sum.total_cycles += stat.total_cycles;
+      sum.max_cycles = max(sum.max_cycles, stat.max_cycles);
+    }
+
+    if (sum.count == 0) {
+      continue;
+    }
+    kprintf("[%s] %lu %lu %lu %lu\n", kSyscallTable[num].name, sum.count,
+            sum.total_cycles / sum.count, sum.max_cycles, sum.total_cycles);
+  }
+}
+
+void SyscallManager::ResetStats() {
+  for (uint64_t i = 0; i < num_core_ * kNumSyscalls; i++) {
+    stats_[i] = SyscallStat{0, 0, 0};
+  }
+}
+
+extern "C" int64_t SyscallHandlerCaller(uint64_t syscall_num, uint64_t arg1,
+                                        uint64_t arg2, uint64_t arg3,
+                                        uint64_t arg4, uint64_t arg5,
+                                        uint64_t arg6) {
   return SyscallManager::GetSyscallManager().SyscallHandler(
       syscall_num, arg1, arg2, arg3, arg4, arg5, arg6);
 }
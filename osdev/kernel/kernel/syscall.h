@@ -1,3 +1,6 @@
+#ifndef SYSCALL_H
+#define SYSCALL_H
+
 #include "../std/types.h"
 
 namespace Kernel {
@@ -6,7 +9,7 @@ enum SyscallNumbers {
   SYS_EXIT = 0,
   SYS_READ,
   SYS_WRITE,
-  SYS_FORK,  // Do not use
+  SYS_FORK,
   SYS_EXEC,  // Do not use
   SYS_SPAWN = 5,
   SYS_WAITPID,
@@ -22,7 +25,24 @@ enum SyscallNumbers {
   SYS_USLEEP,
   SYS_MSTICK,
   SYS_PREAD,
-  SYS_LSEEK
+  SYS_LSEEK,
+  SYS_MMAP = 20,
+  SYS_MUNMAP,
+  SYS_READV,
+  SYS_WRITEV,
+  SYS_IO_BATCH,
+  SYS_IO_RING_SETUP = 25,
+  SYS_IO_RING_ENTER
+};
+
+constexpr uint64_t kNumSyscalls = SYS_IO_RING_ENTER + 1;
+
+// Statistics of a syscall. Cycles are measured with rdtsc from the entry to the
+// exit of the handler, so it includes the time that the process was blocked.
+struct SyscallStat {
+  uint64_t count;
+  uint64_t total_cycles;
+  uint64_t max_cycles;
 };
 
 class SyscallManager {
@@ -32,19 +52,37 @@ class SyscallManager {
     return syscall_manager;
   }
 
-  int SyscallHandler(uint64_t syscall_num, uint64_t arg1, uint64_t arg2,
-                     uint64_t arg3, uint64_t arg4, uint64_t arg5,
-                     uint64_t arg6);
+  // The result is returned to the user as is (in RAX).
+  int64_t SyscallHandler(uint64_t syscall_num, uint64_t arg1, uint64_t arg2,
+                         uint64_t arg3, uint64_t arg4, uint64_t arg5,
+                         uint64_t arg6);
 
   void InitSyscall();
 
+  // Allocate the per-CPU syscall statistics.
+  void SetCoreCount(int num_core);
+
+  // Print the statistics of every syscall (summed over the CPUs).
+  void PrintStats();
+  void ResetStats();
+
  private:
   SyscallManager();
+
+  void RecordStat(uint64_t syscall_num, uint64_t cycles);
+
+  int num_core_ = 0;
+
+  // num_core_ x kNumSyscalls statistics. Each CPU only updates its own row.
+  SyscallStat* stats_ = nullptr;
 };
 
 }  // namespace Kernel
 
 // This function will be used by syscall_handler defined as asm.
-extern "C" int SyscallHandlerCaller(uint64_t syscall_num, uint64_t arg1,
-                                    uint64_t arg2, uint64_t arg3, uint64_t arg4,
-                                    uint64_t arg5, uint64_t arg6);
+extern "C" int64_t SyscallHandlerCaller(uint64_t syscall_num, uint64_t arg1,
+                                        uint64_t arg2, uint64_t arg3,
+                                        uint64_t arg4, uint64_t arg5,
+                                        uint64_t arg6);
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef THREAD_INBOX_H
+#define THREAD_INBOX_H
+
+#include "kthread.h"
+
+namespace Kernel {
+
+// Threads that are woken up for a core by the other cores. Any core can push
+// without taking a lock, and only the core that owns the inbox takes them out
+// (multi producer, single consumer).
+//
+// The consumer always takes the entire list at once, so the push does not
+// suffer from the ABA problem.
+//
+// Inboxes of different cores should not share the cache line.
+class alignas(64) ThreadInbox {
+ public:
+  ThreadInbox() : head_(nullptr) {}
+
+  // Returns true if the inbox was empty.
+  bool Push(KernelThread* thread) {
+    KernelThread* head = __atomic_load_n(&head_, __ATOMIC_RELAXED);
+    do {
+      thread->SetNextInInbox(head);
+    } while (!__atomic_compare_exchange_n(&head_, &head, thread,
+                                          /*weak=*/true, __ATOMIC_RELEASE,
+                                          __ATOMIC_RELAXED));
+    return head == nullptr;
+  }
+
+  bool IsEmpty() const {
+    return __atomic_load_n(&head_, __ATOMIC_RELAXED) == nullptr;
+  }
+
+  // Takes every thread out in the order they were pushed. Returns the first
+  // one and the rest are linked by NextInInbox().
+  KernelThread* TakeAll() {
+    if (__atomic_load_n(&head_, __ATOMIC_RELAXED) == nullptr) {
+      return nullptr;
+    }
+
+    // The last pushed one is at the head.
+    KernelThread* current =
+        __atomic_exchange_n(&head_, nullptr, __ATOMIC_ACQUIRE);
+    KernelThread* reversed = nullptr;
+    while (current != nullptr) {
+      KernelThread* next = current->NextInInbox();
+      current->SetNextInInbox(reversed);
+      reversed = current;
+      current = next;
+    }
+    return reversed;
+  }
+
+ private:
+  KernelThread* head_;
+};
+
+static_assert(sizeof(ThreadInbox) == 64, "ThreadInbox must fill a cache line");
+
+}  // namespace Kernel
+
+#endif
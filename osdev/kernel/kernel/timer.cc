@@ -3,6 +3,7 @@
 #include "../std/stdint.h"
 #include "acpi.h"
 #include "apic.h"
+#include "clock_page.h"
 #include "cpu.h"
 #include "kernel_context.h"
 #include "kthread.h"
@@ -26,6 +27,11 @@ void Timer::TimerInterruptHandler(CPUInterruptHandlerArgs* args,
                                   InterruptHandlerSavedRegs* regs) {
   timer_tick_++;
 
+  // The user processes see the time of CPU 0.
+  if (timer_id_ == 0) {
+    ClockPage::GetClockPage().UpdateTick(timer_tick_);
+  }
+
   if (APICManager::GetAPICManager().IsMulticoreEnabled()) {
     APICManager::GetAPICManager().SetEndOfInterrupt();
   }
@@ -165,6 +171,10 @@ uint64_t Timer::Calibrate() {
   constexpr int kNumCalibrate = 50;
   constexpr int kCalibrateTicks = 5;
 
+  // TSC is measured over the whole calibration.
+  const uint64_t tsc_start = CPURegsAccessProvider::ReadTimeStampCounter();
+  const uint64_t tick_start = timer_tick_;
+
   uint64_t diffs[kNumCalibrate];
   for (int i = 0; i < kNumCalibrate; i++) {
     uint64_t start = GetHPETMainCount();
@@ -172,6 +182,10 @@ uint64_t Timer::Calibrate() {
     diffs[i] = GetHPETMainCount() - start;
   }
 
+  const uint64_t tsc_per_tick =
+      (CPURegsAccessProvider::ReadTimeStampCounter() - tsc_start) /
+      (timer_tick_ - tick_start);
+
   // Drop max and min.
   uint64_t max_diff = diffs[0], min_diff = diffs[0];
   int max_index = 0, min_index = 0;
@@ -196,6 +210,10 @@ uint64_t Timer::Calibrate() {
   kprintf("10^-8 seconds per tick : %d \n",
           total / (kNumCalibrate - 2) / kCalibrateTicks);
   num_10nanosec_per_tick_ = total / (kNumCalibrate - 2) / kCalibrateTicks;
+  kprintf("TSC per tick : %lu \n", tsc_per_tick);
+
+  ClockPage::GetClockPage().SetCalibration(num_10nanosec_per_tick_,
+                                           tsc_per_tick);
 
   *config_register = 0;
   MarkCalibrationDone();
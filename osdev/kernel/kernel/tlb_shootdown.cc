@@ -0,0 +1,132 @@
+#include "tlb_shootdown.h"
+
+#include "apic.h"
+#include "cpu.h"
+#include "cpu_context.h"
+
+namespace Kernel {
+namespace {
+
+constexpr uint64_t FourKB = 0x1000;
+
+}  // namespace
+
+void TLBShootdownManager::FlushRange(uint64_t* pml4e_base_phys_addr,
+                                     uint64_t vm_addr, uint64_t size) {
+  uint64_t page_table = reinterpret_cast<uint64_t>(pml4e_base_phys_addr);
+  if (CPURegsAccessProvider::ReadCR3() == page_table) {
+    FlushLocal(vm_addr, size);
+  }
+
+  if (!APICManager::GetAPICManager().IsMulticoreEnabled()) {
+    return;
+  }
+
+  // The changed entries must be visible before checking which CPU has the
+  // page table. The CPU that loads the page table after this point will not
+  // see the old entries (The scheduler marks loaded_page_table before it
+  // loads CR3).
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+  auto& cpu_context_manager = CPUContextManager::GetCPUContextManager();
+  uint32_t current_cpu_id = CPUContextManager::GetCurrentCPUId();
+  uint64_t target_cpus = 0;
+  for (uint32_t cpu_id = 0; cpu_id < kMaxNumCPU; cpu_id++) {
+    CPUContext* context = cpu_context_manager.GetCPUContext(cpu_id);
+    if (cpu_id != current_cpu_id && context != nullptr &&
+        context->loaded_page_table == page_table) {
+      target_cpus |= (1ULL << cpu_id);
+    }
+  }
+
+  Shootdown(target_cpus, page_table, vm_addr, size);
+}
+
+void TLBShootdownManager::FlushKernelRange(uint64_t vm_addr, uint64_t size) {
+  FlushLocal(vm_addr, size);
+
+  if (!APICManager::GetAPICManager().IsMulticoreEnabled()) {
+    return;
+  }
+
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+  // The kernel half is shared by every page table so every CPU may have it.
+  auto& cpu_context_manager = CPUContextManager::GetCPUContextManager();
+  uint32_t current_cpu_id = CPUContextManager::GetCurrentCPUId();
+  uint64_t target_cpus = 0;
+  for (uint32_t cpu_id = 0; cpu_id < kMaxNumCPU; cpu_id++) {
+    if (cpu_id != current_cpu_id &&
+        cpu_context_manager.GetCPUContext(cpu_id) != nullptr) {
+      target_cpus |= (1ULL << cpu_id);
+    }
+  }
+
+  Shootdown(target_cpus, kKernelPageTable, vm_addr, size);
+}
+
+void TLBShootdownManager::Shootdown(uint64_t target_cpus, uint64_t page_table,
+                                    uint64_t vm_addr, uint64_t size) {
+  if (target_cpus == 0) {
+    return;
+  }
+
+  // Other CPU might be waiting for this CPU to flush while holding the lock;
+  // serve it while spinning (the interrupt can be disabled here).
+  while (!lock_.try_lock()) {
+    HandleShootdown();
+    asm volatile("pause");
+  }
+
+  page_table_ = page_table;
+  vm_addr_ = vm_addr;
+  size_ = size;
+  __atomic_store_n(&pending_cpus_, target_cpus, __ATOMIC_RELEASE);
+
+  auto& apic_manager = APICManager::GetAPICManager();
+  for (uint32_t cpu_id = 0; cpu_id < kMaxNumCPU; cpu_id++) {
+    if (target_cpus & (1ULL << cpu_id)) {
+      apic_manager.SendTLBShootdownIPI(cpu_id);
+    }
+  }
+
+  while (__atomic_load_n(&pending_cpus_, __ATOMIC_ACQUIRE) != 0) {
+    asm volatile("pause");
+  }
+
+  lock_.unlock();
+}
+
+void TLBShootdownManager::FlushAll(uint64_t* pml4e_base_phys_addr) {
+  FlushRange(pml4e_base_phys_addr, 0, ~0ULL);
+}
+
+void TLBShootdownManager::HandleShootdown() {
+  uint64_t cpu_bit = (1ULL << CPUContextManager::GetCurrentCPUId());
+  if (!(__atomic_load_n(&pending_cpus_, __ATOMIC_ACQUIRE) & cpu_bit)) {
+    return;
+  }
+
+  // If this CPU has switched to the other page table, the old entries are
+  // already gone.
+  if (page_table_ == kKernelPageTable ||
+      CPURegsAccessProvider::ReadCR3() == page_table_) {
+    FlushLocal(vm_addr_, size_);
+  }
+
+  __atomic_fetch_and(&pending_cpus_, ~cpu_bit, __ATOMIC_RELEASE);
+}
+
+void TLBShootdownManager::FlushLocal(uint64_t vm_addr, uint64_t size) {
+  // Reloading CR3 is cheaper than invalidating lots of pages one by one.
+  if (size / FourKB > kMaxPagesToInvalidate) {
+    CPURegsAccessProvider::SetCR3(CPURegsAccessProvider::ReadCR3());
+    return;
+  }
+
+  for (uint64_t offset = 0; offset < size; offset += FourKB) {
+    CPURegsAccessProvider::InvalidatePage(vm_addr + offset);
+  }
+}
+
+}  // namespace Kernel
@@ -0,0 +1,70 @@
+#ifndef TLB_SHOOTDOWN_H
+#define TLB_SHOOTDOWN_H
+
+#include "../std/types.h"
+#include "sync.h"
+
+namespace Kernel {
+
+// Removes the stale TLB entries of the page table from every CPU that has
+// the page table loaded (See CPUContext::loaded_page_table).
+//
+// Only one shootdown is in flight at a time. The CPUs that need the flush are
+// notified by the IPI and the caller waits until all of them are done.
+class TLBShootdownManager {
+ public:
+  static TLBShootdownManager& GetTLBShootdownManager() {
+    static TLBShootdownManager m;
+    return m;
+  }
+
+  // If the range is larger than this, the entire TLB is flushed instead of
+  // flushing the pages one by one.
+  static constexpr uint64_t kMaxPagesToInvalidate = 32;
+
+  // Flush [vm_addr, vm_addr + size) of the page table. Must be called after
+  // the page table entries are changed.
+  void FlushRange(uint64_t* pml4e_base_phys_addr, uint64_t vm_addr,
+                  uint64_t size);
+
+  // Flush every (non global) entry of the page table.
+  void FlushAll(uint64_t* pml4e_base_phys_addr);
+
+  // Flush [vm_addr, vm_addr + size) of the kernel half from every CPU. The
+  // kernel half is shared by all page tables so it does not matter which one
+  // is loaded. Must be called after the kernel page table entries are changed.
+  void FlushKernelRange(uint64_t vm_addr, uint64_t size);
+
+  // Called by the TLB shootdown IPI handler.
+  void HandleShootdown();
+
+  TLBShootdownManager(const TLBShootdownManager&) = delete;
+  TLBShootdownManager& operator=(const TLBShootdownManager&) = delete;
+
+ private:
+  TLBShootdownManager() = default;
+
+  // page_table_ of the shootdown from FlushKernelRange(). CR3 is never 0.
+  static constexpr uint64_t kKernelPageTable = 0;
+
+  // Notify the target CPUs and wait until all of them flush the range.
+  void Shootdown(uint64_t target_cpus, uint64_t page_table, uint64_t vm_addr,
+                 uint64_t size);
+
+  // Flush the range from the TLB of the current CPU.
+  static void FlushLocal(uint64_t vm_addr, uint64_t size);
+
+  MultiCoreSpinLock lock_;
+
+  // The shootdown that is in flight. Set while holding the lock_.
+  uint64_t page_table_ = 0;
+  uint64_t vm_addr_ = 0;
+  uint64_t size_ = 0;
+
+  // Bit i is set until CPU i finishes the flush.
+  uint64_t pending_cpus_ = 0;
+};
+
+}  // namespace Kernel
+
+#endif
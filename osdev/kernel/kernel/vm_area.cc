@@ -0,0 +1,108 @@
+#include "vm_area.h"
+
+#include "../std/algorithm.h"
+
+namespace Kernel {
+namespace {
+
+constexpr uint64_t kFourKB = (1 << 12);
+
+uint64_t RoundUpToFourKB(uint64_t addr) {
+  return (addr + kFourKB - 1) & ~(kFourKB - 1);
+}
+
+}  // namespace
+
+bool VMAreaTree::AddArea(const VMArea& area) {
+  ASSERT(area.start < area.end);
+
+  // The first area that ends after the new area starts must start after the
+  // new area ends.
+  auto itr = areas_.upper_bound(area.start);
+  if (itr != areas_.end() && itr->second.start < area.end) {
+    return false;
+  }
+
+  areas_[area.end] = area;
+  return true;
+}
+
+bool VMAreaTree::ExtendArea(uint64_t end, uint64_t new_end) {
+  ASSERT(end < new_end);
+
+  auto itr = areas_.find(end);
+  if (itr == areas_.end()) {
+    return false;
+  }
+
+  auto next = areas_.upper_bound(end);
+  if (next != areas_.end() && next->second.start < new_end) {
+    return false;
+  }
+
+  // Areas are keyed by the end address, so it has to be put again.
+  VMArea area = itr->second;
+  areas_.erase(itr);
+  area.end = new_end;
+  areas_[new_end] = area;
+  return true;
+}
+
+bool VMAreaTree::FindArea(uint64_t addr, VMArea* area) const {
+  auto itr = areas_.upper_bound(addr);
+  if (itr == areas_.end() || addr < itr->second.start) {
+    return false;
+  }
+
+  *area = itr->second;
+  return true;
+}
+
+std::vector<VMArea> VMAreaTree::GetAreasInRange(uint64_t start,
+                                                uint64_t end) const {
+  std::vector<VMArea> areas;
+  for (auto itr = areas_.upper_bound(start);
+       itr != areas_.end() && itr->second.start < end; ++itr) {
+    areas.push_back(itr->second);
+  }
+  return areas;
+}
+
+void VMAreaTree::RemoveRange(uint64_t start, uint64_t end) {
+  std::vector<VMArea> areas = GetAreasInRange(start, end);
+  for (const auto& area : areas) {
+    areas_.erase(area.end);
+
+    // Put back the parts that are not covered by the range.
+    if (area.start < start) {
+      VMArea left = area;
+      left.end = start;
+      areas_[left.end] = left;
+    }
+    if (end < area.end) {
+      VMArea right = area;
+      right.start = end;
+      right.file_offset += (end - area.start);
+      areas_[right.end] = right;
+    }
+  }
+}
+
+uint64_t VMAreaTree::FindFreeRange(uint64_t size, uint64_t low,
+                                   uint64_t high) const {
+  uint64_t candidate = low;
+  for (auto itr = areas_.upper_bound(low); itr != areas_.end(); ++itr) {
+    if (candidate + size <= itr->second.start) {
+      break;
+    }
+    // ELF segments do not need to end at the page boundary.
+    candidate = max(candidate, RoundUpToFourKB(itr->second.end));
+  }
+
+  if (candidate + size > high) {
+    return 0;
+  }
+  return candidate;
+}
+
+}  // namespace Kernel
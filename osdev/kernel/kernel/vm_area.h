@@ -0,0 +1,73 @@
+#ifndef VM_AREA_H
+#define VM_AREA_H
+
+#include "../std/map.h"
+#include "../std/types.h"
+#include "../std/vector.h"
+
+namespace Kernel {
+
+// Contiguous virtual memory area of the user process : [start, end).
+struct VMArea {
+  // FRAME_BUFFER (the screen buffer) and IO_RING are shared with the kernel.
+  // They are mapped as a whole when created so they never fault.
+  enum Type {
+    STACK,
+    ELF_SEGMENT,
+    HEAP,
+    ANONYMOUS,
+    FILE,
+    FRAME_BUFFER,
+    IO_RING
+  };
+
+  // Protection of the area (Same as PROT_READ, PROT_WRITE and PROT_EXEC).
+  static constexpr int kProtRead = 0x1;
+  static constexpr int kProtWrite = 0x2;
+  static constexpr int kProtExec = 0x4;
+
+  uint64_t start;
+  uint64_t end;
+  Type type;
+  int prot;
+
+  // Only used for the FILE area. file_offset is the offset of the file that is
+  // mapped at start.
+  size_t inode_num;
+  size_t file_offset;
+};
+
+// Set of non overlapping memory areas of the process. Areas are kept in the
+// tree ordered by its end address, so the area that contains an address is the
+// first area that ends after it.
+class VMAreaTree {
+ public:
+  // Returns false if the area overlaps with the existing area.
+  bool AddArea(const VMArea& area);
+
+  // Move the end of the area that ends at end to new_end. Returns false if
+  // there is no such area or the grown part overlaps with the other area.
+  bool ExtendArea(uint64_t end, uint64_t new_end);
+
+  // Find the area that contains addr. Returns false if there is no such area.
+  bool FindArea(uint64_t addr, VMArea* area) const;
+
+  // Returns every area that overlaps with [start, end).
+  std::vector<VMArea> GetAreasInRange(uint64_t start, uint64_t end) const;
+
+  // Remove [start, end) from the areas. Areas that partially overlap with the
+  // range are split.
+  void RemoveRange(uint64_t start, uint64_t end);
+
+  // Find the lowest free range of the size within [low, high). Returns 0 if
+  // there is no such range.
+  uint64_t FindFreeRange(uint64_t size, uint64_t low, uint64_t high) const;
+
+ private:
+  // Maps the end address of the area to the area.
+  std::map<uint64_t, VMArea> areas_;
+};
+
+}  // namespace Kernel
+
+#endif
@@ -0,0 +1,75 @@
+#include "zeroed_frame_pool.h"
+
+#include "../std/string.h"
+#include "frame_allocator.h"
+#include "paging.h"
+#include "scheduler.h"
+
+namespace Kernel {
+
+bool ZeroedFramePool::initialized_ = false;
+
+void ZeroedFramePool::Init() {
+  frames_.reserve(kPoolSize);
+  __atomic_store_n(&initialized_, true, __ATOMIC_RELEASE);
+}
+
+void ZeroedFramePool::RefillIfIdle() {
+  if (!__atomic_load_n(&initialized_, __ATOMIC_ACQUIRE)) {
+    return;
+  }
+
+  // Never delay the threads that are waiting to run.
+  if (!KernelThreadScheduler::GetKernelThreadScheduler().IsCurrentCoreIdle()) {
+    return;
+  }
+
+  GetZeroedFramePool().RefillOneFrame();
+}
+
+void* ZeroedFramePool::AllocateZeroedFrame() {
+  {
+    std::lock_guard<MultiCoreSpinLock> lk(lock_);
+    if (!frames_.empty()) {
+      void* frame = frames_.back();
+      frames_.pop_back();
+      return frame;
+    }
+  }
+
+  return CreateZeroedFrame();
+}
+
+void* ZeroedFramePool::CreateZeroedFrame() {
+  void* frame = UserFrameAllocator::GetPhysicalFrameAllocator().AllocateFrame(0);
+
+  auto& page_table_manager = PageTableManager::GetPageTableManager();
+  void* frame_addr = page_table_manager.MapFrameToKernel(frame);
+  memset(frame_addr, 0, (1 << 12));
+  page_table_manager.UnmapFrameFromKernel(frame_addr);
+
+  return frame;
+}
+
+void ZeroedFramePool::RefillOneFrame() {
+  {
+    std::lock_guard<MultiCoreSpinLock> lk(lock_);
+    if (frames_.size() >= kPoolSize) {
+      return;
+    }
+  }
+
+  // Clear the frame outside of the lock. The other core may have filled the
+  // pool meanwhile.
+  void* frame = CreateZeroedFrame();
+  {
+    std::lock_guard<MultiCoreSpinLock> lk(lock_);
+    if (frames_.size() < kPoolSize) {
+      frames_.push_back(frame);
+      return;
+    }
+  }
+  UserFrameAllocator::GetPhysicalFrameAllocator().FreeFrame(frame);
+}
+
+}  // namespace Kernel
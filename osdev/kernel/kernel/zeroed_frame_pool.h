@@ -0,0 +1,53 @@
+#ifndef ZEROED_FRAME_POOL_H
+#define ZEROED_FRAME_POOL_H
+
+#include "../std/types.h"
+#include "../std/vector.h"
+#include "sync.h"
+
+namespace Kernel {
+
+// Pool of 4KB user frames that are already filled with zero. Page fault
+// handler takes frames from here so that the faulting process does not have
+// to wait for the frame to be cleared. The pool is refilled by the idle loop
+// of each core, only when the core has nothing else to run.
+class ZeroedFramePool {
+ public:
+  static ZeroedFramePool& GetZeroedFramePool() {
+    static ZeroedFramePool zeroed_frame_pool;
+    return zeroed_frame_pool;
+  }
+
+  // Let the idle loops start refilling the pool.
+  void Init();
+
+  // Called by the idle loop of each core. Clears one frame into the pool if
+  // there is no other thread to run on the core.
+  static void RefillIfIdle();
+
+  // Returns a zero filled frame (with the reference count of 1). If the pool
+  // is empty, the frame is cleared right away.
+  void* AllocateZeroedFrame();
+
+ private:
+  // Number of frames to keep in the pool (1 MB).
+  static constexpr size_t kPoolSize = 256;
+
+  ZeroedFramePool() : lock_("ZeroedFramePoolLock") {}
+
+  // Allocate a new frame and fill it with zero.
+  void* CreateZeroedFrame();
+
+  void RefillOneFrame();
+
+  std::vector<void*> frames_;
+  MultiCoreSpinLock lock_;
+
+  // Set by Init(). The idle loops of the APs start before the pool is
+  // constructed.
+  static bool initialized_;
+};
+
+}  // namespace Kernel
+
+#endif
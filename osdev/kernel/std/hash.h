@@ -35,6 +35,17 @@ struct hash<char> {
   size_t operator()(const char& x) const { return hash<uint64_t>()(x); }
 };
 
+// FNV-1a of the bytes. The result is mixed once more since the hash tables use
+// both the low and the high bits.
+inline size_t HashBytes(const char* data, size_t size) {
+  uint64_t h = 0xcbf29ce484222325ull;
+  for (size_t i = 0; i < size; i++) {
+    h ^= static_cast<uint8_t>(data[i]);
+    h *= 0x100000001b3ull;
+  }
+  return hash<uint64_t>()(h);
+}
+
 }  // namespace std
 }  // namespace Kernel
 #endif
@@ -11,43 +11,42 @@ struct KeyValHashMap {
   Key key;
   Value value;
 
-  KeyValHashMap() {}
-  KeyValHashMap(const Key& k) : key(k) {}
+  KeyValHashMap(const Key& k) : key(k), value() {}
   KeyValHashMap(const Key& k, const Value& v) : key(k), value(v) {}
-
-  bool operator==(const KeyValHashMap& kv) { return key == kv.key; }
+  KeyValHashMap(KeyValHashMap&& kv)
+      : key(std::move(kv.key)), value(std::move(kv.value)) {}
 };
 
 template <typename Key, typename Value>
-struct hash<KeyValHashMap<Key, Value>> {
-  size_t operator()(const KeyValHashMap<Key, Value>& kv) const {
-    return std::hash<Key>()(kv.key);
+struct HashMapGetKey {
+  const Key& operator()(const KeyValHashMap<Key, Value>& kv) const {
+    return kv.key;
   }
 };
 
 template <typename Key, typename Value>
 class HashMap {
  public:
+  // Does nothing if the key already exists.
   void insert(const Key& key, const Value& val) {
-    hash_set_.insert(KeyValHashMap<Key, Value>(key, val));
-  }
-
-  void insert(const Key& key) {
-    hash_set_.insert(KeyValHashMap<Key, Value>(key));
+    hash_map_.Insert(key, key, val);
   }
 
-  size_t erase(const Key& key) {
-    KeyValHashMap<Key, Value> kv;
-    kv.key = key;
+  void insert(const Key& key) { hash_map_.Insert(key, key); }
 
-    return hash_set_.erase(kv);
-  }
+  size_t erase(const Key& key) { return hash_map_.Erase(key) ? 1 : 0; }
 
   const Value* find(const Key& key) const {
-    KeyValHashMap<Key, Value> kv;
-    kv.key = key;
+    auto* key_val = hash_map_.Find(key);
+    if (key_val == nullptr) {
+      return nullptr;
+    }
+
+    return &key_val->value;
+  }
 
-    auto* key_val = hash_set_.find(kv);
+  Value* find(const Key& key) {
+    auto* key_val = hash_map_.Find(key);
     if (key_val == nullptr) {
       return nullptr;
     }
@@ -55,21 +54,43 @@ class HashMap {
     return &key_val->value;
   }
 
-  Value& operator[](const Key& key) {
-    KeyValHashMap<Key, Value> kv;
-    kv.key = key;
+  // Lookup by other type (e.g string_view for KernelString) without making
+  // the Key.
+  template <typename K,
+            typename = enable_if_t<
+                hash_internal::IsTransparent<std::hash<Key>>::value &&
+                !is_same<K, Key>::value>>
+  const Value* find(const K& key) const {
+    auto* key_val = hash_map_.Find(key);
+    if (key_val == nullptr) {
+      return nullptr;
+    }
+
+    return &key_val->value;
+  }
 
-    auto* key_val = hash_set_.find(kv);
+  template <typename K,
+            typename = enable_if_t<
+                hash_internal::IsTransparent<std::hash<Key>>::value &&
+                !is_same<K, Key>::value>>
+  Value* find(const K& key) {
+    auto* key_val = hash_map_.Find(key);
     if (key_val == nullptr) {
-      insert(key);
+      return nullptr;
     }
 
-    key_val = hash_set_.find(kv);
-    return key_val->value;
+    return &key_val->value;
   }
 
+  Value& operator[](const Key& key) {
+    return hash_map_.Insert(key, key).first->value;
+  }
+
+  size_t size() const { return hash_map_.size(); }
+
  private:
-  HashSet<KeyValHashMap<Key, Value>> hash_set_;
+  FlatHashTable<KeyValHashMap<Key, Value>, Key, HashMapGetKey<Key, Value>>
+      hash_map_;
 };
 
 }  // namespace std
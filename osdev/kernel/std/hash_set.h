@@ -1,127 +1,259 @@
 #ifndef STD_HASH_SET
 #define STD_HASH_SET
 
-#include "../kernel/qemu_log.h"
+#include "../kernel/kmalloc.h"
 #include "hash.h"
+#include "memory.h"
+#include "type_traits.h"
 #include "types.h"
-#include "vector.h"
+#include "utility.h"
 
 namespace Kernel {
 namespace std {
+namespace hash_internal {
 
-template <typename Key>
-struct HashSetSlot {
-  bool is_tomb = false;
-  Key* key = nullptr;
-};
+// Every slot has a control byte. The full slot keeps the low 7 bits of the
+// hash (so the MSB is 0) and the others have the MSB set.
+constexpr uint8_t kEmpty = 0x80;
+constexpr uint8_t kDeleted = 0xFE;
 
-template <typename Key>
-class HashSetInternal {
+// Control bytes are read 8 at a time (a group) as a uint64_t.
+constexpr size_t kGroupSize = 8;
+constexpr uint64_t kLsbs = 0x0101010101010101ull;
+constexpr uint64_t kMsbs = 0x8080808080808080ull;
+
+// Returns the mask whose MSB of each byte is set if the control byte can be
+// h2. Can have the false positive, but never the false negative.
+inline uint64_t MatchByte(uint64_t group, uint8_t h2) {
+  uint64_t x = group ^ (kLsbs * h2);
+  return (x - kLsbs) & ~x & kMsbs;
+}
+
+// kEmpty is the only one that has the MSB set and the bit 1 cleared.
+inline uint64_t MatchEmpty(uint64_t group) {
+  return group & ~(group << 6) & kMsbs;
+}
+
+inline uint64_t MatchEmptyOrDeleted(uint64_t group) { return group & kMsbs; }
+
+inline size_t LowestMatch(uint64_t mask) { return __builtin_ctzll(mask) / 8; }
+
+// Whether hash<Key> can also hash the other types (e.g hash<KernelString>
+// can hash string_view).
+template <typename Hash, typename = void>
+struct IsTransparent : false_type {};
+
+template <typename Hash>
+struct IsTransparent<Hash, typename Hash::is_transparent> : true_type {};
+
+}  // namespace hash_internal
+
+// Open addressing hash table that keeps the slots inline (Swiss table style).
+// GetKey returns the key of the slot. Slots can be looked up by any type K if
+// hash<K> gives the same hash and the key can be compared with it.
+template <typename Slot, typename Key, typename GetKey>
+class FlatHashTable {
  public:
-  constexpr static size_t kInitNumSlots = 1024;
+  FlatHashTable()
+      : ctrl_(nullptr),
+        slots_(nullptr),
+        num_groups_(0),
+        num_elements_(0),
+        num_deleted_(0) {}
+
+  FlatHashTable(const FlatHashTable&) = delete;
+  FlatHashTable& operator=(const FlatHashTable&) = delete;
+
+  ~FlatHashTable() { Destroy(); }
+
+  template <typename K>
+  Slot* Find(const K& key) const {
+    if (num_elements_ == 0) {
+      return nullptr;
+    }
 
-  // Load factor = 1 / 3
-  constexpr static size_t kInverseLoadFactor = 3;
+    size_t index = FindIndex(key, std::hash<K>()(key));
+    return index == npos ? nullptr : &slots_[index];
+  }
 
-  HashSetInternal() : slots_(kInitNumSlots), num_elements_(0) {}
+  // Constructs the slot with args if the key does not exist. Returns the slot
+  // of the key and whether it is newly inserted.
+  template <typename K, typename... Args>
+  pair<Slot*, bool> Insert(const K& key, Args&&... args) {
+    size_t hash = std::hash<K>()(key);
+    if (num_elements_ > 0) {
+      size_t index = FindIndex(key, hash);
+      if (index != npos) {
+        return pair<Slot*, bool>(&slots_[index], false);
+      }
+    }
 
-  void InsertKey(Key* key) {
     RehashIfLoaded();
-    InsertKeyInternal(key, slots_);
+
+    size_t index = FindInsertIndex(hash);
+    if (Ctrl()[index] == hash_internal::kDeleted) {
+      num_deleted_--;
+    }
+    Ctrl()[index] = H2(hash);
+    ::new (static_cast<void*>(&slots_[index]))
+        Slot(std::forward<Args>(args)...);
+    num_elements_++;
+
+    return pair<Slot*, bool>(&slots_[index], true);
   }
 
-  // If found, returns the Key in the slot. Otherwise, returns nullptr.
-  Key* SearchKey(const Key* key) const {
-    size_t index = std::hash<Key>()(*key) % slots_.size();
+  // Returns false if the key does not exist.
+  template <typename K>
+  bool Erase(const K& key) {
+    if (num_elements_ == 0) {
+      return false;
+    }
 
-    // Start probing.
-    while (true) {
-      if (slots_.at(index).key != nullptr) {
-        if ((*slots_.at(index).key) == *key) {
-          return slots_.at(index).key;
-        }
-      } else if (slots_.at(index).key == nullptr && !slots_.at(index).is_tomb) {
-        return nullptr;
-      }
+    size_t index = FindIndex(key, std::hash<K>()(key));
+    if (index == npos) {
+      return false;
+    }
 
-      index++;
+    slots_[index].~Slot();
+    num_elements_--;
 
-      // Make sure it wraps around.
-      if (index >= slots_.size()) {
-        index = 0;
-      }
+    // The lookup stops at the group that has an empty slot, so the slot can
+    // be emptied if no lookup has ever passed through this group.
+    uint64_t group = ctrl_[index / hash_internal::kGroupSize];
+    if (hash_internal::MatchEmpty(group)) {
+      Ctrl()[index] = hash_internal::kEmpty;
+    } else {
+      Ctrl()[index] = hash_internal::kDeleted;
+      num_deleted_++;
     }
+    return true;
   }
 
-  // Remove the key from the set.
-  Key* RemoveKey(const Key* key) {
-    size_t index = std::hash<Key>()(*key) % slots_.size();
+  size_t size() const { return num_elements_; }
+
+ private:
+  static constexpr size_t kInitNumGroups = 2;
+
+  static uint8_t H2(size_t hash) { return hash & 0x7F; }
+  static size_t H1(size_t hash) { return hash >> 7; }
 
-    // Start probing.
-    while (true) {
-      if (slots_[index].key != nullptr) {
-        if ((*slots_[index].key) == *key) {
-          Key* found = slots_[index].key;
-          slots_[index].key = nullptr;
-          slots_[index].is_tomb = true;
+  uint8_t* Ctrl() const { return reinterpret_cast<uint8_t*>(ctrl_); }
+  size_t Capacity() const { return num_groups_ * hash_internal::kGroupSize; }
 
-          num_elements_--;
-          return found;
+  // Groups are probed quadratically (1, 2, 3, ... apart). This visits every
+  // group since the number of groups is a power of 2.
+  template <typename K>
+  size_t FindIndex(const K& key, size_t hash) const {
+    const uint8_t h2 = H2(hash);
+    size_t group_index = H1(hash) & (num_groups_ - 1);
+    for (size_t step = 1; step <= num_groups_; step++) {
+      uint64_t group = ctrl_[group_index];
+      for (uint64_t match = hash_internal::MatchByte(group, h2); match != 0;
+           match &= (match - 1)) {
+        size_t index = group_index * hash_internal::kGroupSize +
+                       hash_internal::LowestMatch(match);
+        if (GetKey()(slots_[index]) == key) {
+          return index;
         }
-      } else if (slots_[index].key == nullptr && !slots_[index].is_tomb) {
-        return nullptr;
       }
+      if (hash_internal::MatchEmpty(group)) {
+        return npos;
+      }
+      group_index = (group_index + step) & (num_groups_ - 1);
+    }
+    return npos;
+  }
 
-      index++;
-
-      // Make sure it wraps around.
-      if (index >= slots_.size()) {
-        index = 0;
+  size_t FindInsertIndex(size_t hash) const {
+    size_t group_index = H1(hash) & (num_groups_ - 1);
+    for (size_t step = 1;; step++) {
+      uint64_t match = hash_internal::MatchEmptyOrDeleted(ctrl_[group_index]);
+      if (match != 0) {
+        return group_index * hash_internal::kGroupSize +
+               hash_internal::LowestMatch(match);
       }
+      group_index = (group_index + step) & (num_groups_ - 1);
     }
   }
 
+  // Keeps the load (including the deleted ones) under 7 / 8.
   void RehashIfLoaded() {
-    if (num_elements_ * kInverseLoadFactor < slots_.size()) {
+    if (num_groups_ == 0) {
+      Rehash(kInitNumGroups);
       return;
     }
 
-    vector<HashSetSlot<Key>> new_slots(slots_.size() * 2);
-    for (size_t i = 0; i < slots_.size(); i++) {
-      Key* key = slots_[i].key;
-      if (key != nullptr) {
-        InsertKeyInternal(key, new_slots);
-      }
+    if ((num_elements_ + num_deleted_ + 1) * 8 <= Capacity() * 7) {
+      return;
     }
 
-    slots_ = std::move(new_slots);
+    // Just clean up the deleted slots if the table is not that full.
+    if (num_elements_ * 2 < Capacity()) {
+      Rehash(num_groups_);
+    } else {
+      Rehash(num_groups_ * 2);
+    }
   }
 
- private:
-  void InsertKeyInternal(Key* key, std::vector<HashSetSlot<Key>>& slots) {
-    size_t index = std::hash<Key>()(*key) % slots.size();
+  void Rehash(size_t num_groups) {
+    uint64_t* old_ctrl = ctrl_;
+    Slot* old_slots = slots_;
+    size_t old_capacity = Capacity();
 
-    // Start probing.
-    while (true) {
-      if (slots[index].key == nullptr) {
-        slots[index].key = key;
-        slots[index].is_tomb = false;
+    ctrl_ = static_cast<uint64_t*>(kmalloc(num_groups * sizeof(uint64_t)));
+    slots_ = static_cast<Slot*>(
+        kmalloc(num_groups * hash_internal::kGroupSize * sizeof(Slot)));
+    num_groups_ = num_groups;
+    num_deleted_ = 0;
+    for (size_t i = 0; i < num_groups; i++) {
+      ctrl_[i] = hash_internal::kLsbs * hash_internal::kEmpty;
+    }
 
-        num_elements_++;
-        break;
+    const uint8_t* old_ctrl_bytes = reinterpret_cast<uint8_t*>(old_ctrl);
+    for (size_t i = 0; i < old_capacity; i++) {
+      if (old_ctrl_bytes[i] & 0x80) {
+        continue;
       }
 
-      index++;
+      size_t hash = std::hash<Key>()(GetKey()(old_slots[i]));
+      size_t index = FindInsertIndex(hash);
+      Ctrl()[index] = H2(hash);
+      ::new (static_cast<void*>(&slots_[index])) Slot(std::move(old_slots[i]));
+      old_slots[i].~Slot();
+    }
+
+    if (old_ctrl != nullptr) {
+      kfree(old_ctrl);
+      kfree(old_slots);
+    }
+  }
+
+  void Destroy() {
+    if (ctrl_ == nullptr) {
+      return;
+    }
 
-      // Make sure it wraps around.
-      if (index >= slots.size()) {
-        index = 0;
+    for (size_t i = 0; i < Capacity(); i++) {
+      if (!(Ctrl()[i] & 0x80)) {
+        slots_[i].~Slot();
       }
     }
+    kfree(ctrl_);
+    kfree(slots_);
   }
 
-  vector<HashSetSlot<Key>> slots_;
+  // Control bytes. Accessed as bytes through Ctrl().
+  uint64_t* ctrl_;
+  Slot* slots_;
+
+  size_t num_groups_;
   size_t num_elements_;
+  size_t num_deleted_;
+};
+
+template <typename Key>
+struct HashSetGetKey {
+  const Key& operator()(const Key& key) const { return key; }
 };
 
 template <typename Key>
@@ -129,22 +261,35 @@ class HashSet {
  public:
   using value_type = Key;
 
-  void insert(const value_type& v) { hash_set_.InsertKey(new Key(v)); }
-  size_t erase(const value_type& v) {
-    Key* key = hash_set_.RemoveKey(&v);
-    if (key != nullptr) {
-      delete key;
-      return 1;
-    }
-    return 0;
-  }
+  void insert(const value_type& v) { hash_set_.Insert(v, v); }
+  size_t erase(const value_type& v) { return hash_set_.Erase(v) ? 1 : 0; }
 
   // Returns nullptr if Key is not found.
-  const Key* find(const value_type& v) const { return hash_set_.SearchKey(&v); }
-  Key* find(const value_type& v) { return hash_set_.SearchKey(&v); }
+  const Key* find(const value_type& v) const { return hash_set_.Find(v); }
+  Key* find(const value_type& v) { return hash_set_.Find(v); }
+
+  // Lookup by other type (e.g string_view for KernelString) without making
+  // the Key.
+  template <typename K,
+            typename = enable_if_t<
+                hash_internal::IsTransparent<std::hash<Key>>::value &&
+                !is_same<K, Key>::value>>
+  const Key* find(const K& v) const {
+    return hash_set_.Find(v);
+  }
+
+  template <typename K,
+            typename = enable_if_t<
+                hash_internal::IsTransparent<std::hash<Key>>::value &&
+                !is_same<K, Key>::value>>
+  Key* find(const K& v) {
+    return hash_set_.Find(v);
+  }
+
+  size_t size() const { return hash_set_.size(); }
 
  private:
-  HashSetInternal<Key> hash_set_;
+  FlatHashTable<Key, Key, HashSetGetKey<Key>> hash_set_;
 };
 
 }  // namespace std
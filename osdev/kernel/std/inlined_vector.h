@@ -0,0 +1,188 @@
+#ifndef INLINED_VECTOR_H
+#define INLINED_VECTOR_H
+
+#include "memory.h"
+#include "utility.h"
+#include "vector.h"
+
+namespace Kernel {
+namespace std {
+
+// Same as vector, but the first N elements are stored inside the object. Use
+// it for the small lists (e.g entries of a directory) that are created and
+// destroyed often, so that they do not touch the kernel heap.
+template <typename T, size_t N, typename Allocator = std::allocator<T>>
+class InlinedVector {
+  static_assert(N > 0, "Use vector instead.");
+
+ public:
+  using iterator = VectorIterator<T>;
+
+  InlinedVector() : size_(0), alloc_size_(N), data_(InlineData()) {}
+
+  InlinedVector(const InlinedVector& v) : InlinedVector() { CopyFrom(v); }
+  InlinedVector(InlinedVector&& v) : InlinedVector() { MoveFrom(v); }
+
+  InlinedVector& operator=(const InlinedVector& v) {
+    if (this != &v) {
+      clear();
+      CopyFrom(v);
+    }
+    return *this;
+  }
+
+  InlinedVector& operator=(InlinedVector&& v) {
+    if (this != &v) {
+      Destroy();
+      size_ = 0;
+      alloc_size_ = N;
+      data_ = InlineData();
+      MoveFrom(v);
+    }
+    return *this;
+  }
+
+  ~InlinedVector() { Destroy(); }
+
+  T& operator[](size_t index) { return data_[index]; }
+  T& back() { return data_[size_ - 1]; }
+  const T& back() const { return data_[size_ - 1]; }
+  const T& at(size_t index) const { return data_[index]; }
+  size_t size() const { return size_; }
+  size_t capacity() const { return alloc_size_; }
+  bool empty() const { return size_ == 0; }
+
+  // Whether the elements are stored in the inline storage.
+  bool IsInline() const { return data_ == InlineData(); }
+
+  void reserve(size_t sz) {
+    if (sz <= alloc_size_) {
+      return;
+    }
+
+    Resize(sz);
+  }
+
+  void push_back(const T& t) {
+    if (size_ >= alloc_size_) {
+      Resize(alloc_size_ * 2);
+    }
+
+    alloc_::construct(allocator_, &data_[size_], t);
+    size_++;
+  }
+
+  void push_back(T&& t) {
+    if (size_ >= alloc_size_) {
+      Resize(alloc_size_ * 2);
+    }
+
+    alloc_::construct(allocator_, &data_[size_], std::move(t));
+    size_++;
+  }
+
+  void pop_back() {
+    alloc_::destroy(allocator_, &data_[size_ - 1]);
+    size_--;
+  }
+
+  // Destroys every element but keeps the memory.
+  void clear() {
+    for (size_t i = 0; i < size_; i++) {
+      alloc_::destroy(allocator_, &data_[i]);
+    }
+    size_ = 0;
+  }
+
+  iterator erase(iterator pos) {
+    if (pos == end()) {
+      return end();
+    }
+
+    typename iterator::difference_type loc = pos - begin();
+    alloc_::destroy(allocator_, &data_[loc]);
+
+    // Now pull everything behind loc.
+    for (size_t i = loc; i < size_ - 1; i++) {
+      alloc_::construct(allocator_, &data_[i], std::move(data_[i + 1]));
+      alloc_::destroy(allocator_, &data_[i + 1]);
+    }
+
+    size_--;
+    return begin() + loc;
+  }
+
+  iterator begin() const { return iterator(data_); }
+  iterator end() const { return iterator(data_ + size_); }
+
+ private:
+  T* InlineData() const {
+    return reinterpret_cast<T*>(const_cast<char*>(inline_));
+  }
+
+  void Resize(size_t new_alloc_size) {
+    T* new_loc = alloc_::allocate(allocator_, sizeof(T) * new_alloc_size);
+
+    for (size_t i = 0; i < size_; i++) {
+      alloc_::construct(allocator_, &new_loc[i], std::move(data_[i]));
+      alloc_::destroy(allocator_, &data_[i]);
+    }
+    if (!IsInline()) {
+      alloc_::deallocate(allocator_, data_, sizeof(T) * alloc_size_);
+    }
+
+    alloc_size_ = new_alloc_size;
+    data_ = new_loc;
+  }
+
+  void Destroy() {
+    clear();
+    if (!IsInline()) {
+      alloc_::deallocate(allocator_, data_, sizeof(T) * alloc_size_);
+    }
+  }
+
+  // The vector must be empty.
+  void CopyFrom(const InlinedVector& v) {
+    reserve(v.size_);
+    for (size_t i = 0; i < v.size_; i++) {
+      alloc_::construct(allocator_, &data_[i], v.data_[i]);
+    }
+    size_ = v.size_;
+  }
+
+  // The vector must be empty and use the inline storage.
+  void MoveFrom(InlinedVector& v) {
+    if (v.IsInline()) {
+      // Elements in the inline storage should be moved one by one.
+      for (size_t i = 0; i < v.size_; i++) {
+        alloc_::construct(allocator_, &data_[i], std::move(v.data_[i]));
+      }
+      size_ = v.size_;
+      v.clear();
+      return;
+    }
+
+    size_ = v.size_;
+    alloc_size_ = v.alloc_size_;
+    data_ = v.data_;
+
+    v.size_ = 0;
+    v.alloc_size_ = N;
+    v.data_ = v.InlineData();
+  }
+
+  size_t size_;
+  size_t alloc_size_;
+
+  T* data_;
+  Allocator allocator_;
+
+  alignas(T) char inline_[sizeof(T) * N];
+
+  using alloc_ = std::allocator_traits<Allocator>;
+};
+
+}  // namespace std
+}  // namespace Kernel
+#endif
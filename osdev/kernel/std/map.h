@@ -66,19 +66,11 @@ class map {
 
   map() = default;
 
-  // Dump ways to copy
-  map(const map& m) {
-    for (auto itr = m.begin(); itr != m.end(); ++itr) {
-      operator[]((*itr).first) = (*itr).second;
-    }
-  }
-
-  map& operator=(const map& m) {
-    for (auto itr = m.begin(); itr != m.end(); ++itr) {
-      operator[]((*itr).first) = (*itr).second;
-    }
-    return *this;
-  }
+  // The underlying set copies the tree as is.
+  map(const map& m) = default;
+  map(map&& m) = default;
+  map& operator=(const map& m) = default;
+  map& operator=(map&& m) = default;
 
   Value& at(const Key& key) {
     iterator itr(key_val_.find(KeyVal<const Key, Value>(key)));
@@ -111,10 +103,19 @@ class map {
     return key_val_.find(KeyVal<const Key, Value>(key));
   }
 
+  iterator lower_bound(const Key& key) const {
+    return key_val_.lower_bound(KeyVal<const Key, Value>(key));
+  }
+
+  iterator upper_bound(const Key& key) const {
+    return key_val_.upper_bound(KeyVal<const Key, Value>(key));
+  }
+
   iterator begin() const { return key_val_.begin(); }
   iterator end() const { return key_val_.end(); }
 
   size_t size() const { return key_val_.size(); }
+  void clear() { key_val_.clear(); }
 
   void Print() { key_val_.Print(); }
 
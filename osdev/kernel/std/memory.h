@@ -16,8 +16,14 @@ class allocator {
  public:
   using pointer = T*;
 
-  // Allocate n bytes.
-  constexpr T* allocate(size_t n) { return reinterpret_cast<T*>(kmalloc(n)); }
+  // Allocate n bytes. Over aligned types (e.g the ones aligned to the cache
+  // line) get the memory of their alignment.
+  constexpr T* allocate(size_t n) {
+    if constexpr (alignof(T) > 16) {
+      return reinterpret_cast<T*>(kaligned_alloc(alignof(T), n));
+    }
+    return reinterpret_cast<T*>(kmalloc(n));
+  }
   constexpr void deallocate(T* p, size_t n) {
     UNUSED(n);
     kfree(p);
@@ -17,78 +17,25 @@ class SetIterator {
   using reference = typename Node::KeyType&;
   using const_reference = const typename Node::KeyType&;
 
-  SetIterator(const SetIterator& itr) : stack_(itr.stack_) {}
-  SetIterator(SetIterator&& itr) : stack_(std::move(itr.stack_)) {}
-  SetIterator(const std::vector<Node*>& stack) : stack_(stack) {}
-
-  SetIterator& operator=(const SetIterator& itr) {
-    stack_ = itr.stack_;
-    return *this;
-  }
+  // nullptr is the end.
+  SetIterator(Node* node) : node_(node) {}
 
   SetIterator& operator++() {
-    // Go up if it does not have any right element.
-    // If it is coming from right, we have to continue.
-    if (CurrentNode()->Right() == nullptr) {
-      Node* current = CurrentNode();
-      while (true) {
-        stack_.pop_back();
-        if (stack_.empty()) {
-          break;
-        }
-
-        Node* parent = CurrentNode();
-        if (parent->Left() == current) {
-          break;
-        }
-      }
-    } else {
-      // Now find the next successor.
-      Node* current = CurrentNode()->Right();
-      while (current != nullptr) {
-        stack_.push_back(current);
-        current = current->Left();
-      }
-    }
-
+    node_ = node_->Next();
     return *this;
   }
 
-  bool operator==(const SetIterator& itr) const {
-    if (stack_.size() != itr.stack_.size()) {
-      return false;
-    }
-
-    for (size_t i = 0; i < stack_.size(); i++) {
-      if (stack_.at(i) != itr.stack_.at(i)) {
-        return false;
-      }
-    }
-    return true;
-  }
-
+  bool operator==(const SetIterator& itr) const { return node_ == itr.node_; }
   bool operator!=(const SetIterator& itr) const { return !(operator==(itr)); }
-  const_reference operator*() const { return CurrentNode()->GetKey(); }
-  reference operator*() { return *CurrentNode()->MutableKey(); }
-  const_pointer operator->() const { return &CurrentNode()->GetKey(); }
-  pointer operator->() { return CurrentNode()->MutableKey(); }
-
-  pair<Node*, Node*> CurrentAndParent() const {
-    if (stack_.size() == 0) {
-      return pair<Node*, Node*>(nullptr, nullptr);
-    } else if (stack_.size() == 1) {
-      return pair<Node*, Node*>(stack_.at(0), nullptr);
-    } else {
-      return pair<Node*, Node*>(stack_.at(stack_.size() - 1),
-                                stack_.at(stack_.size() - 2));
-    }
-  }
+  const_reference operator*() const { return node_->GetKey(); }
+  reference operator*() { return *node_->MutableKey(); }
+  const_pointer operator->() const { return &node_->GetKey(); }
+  pointer operator->() { return node_->MutableKey(); }
 
- private:
-  // Current stack. (Assuming that we visit nodes in DFS).
-  std::vector<Node*> stack_;
+  Node* GetNode() const { return node_; }
 
-  Node* CurrentNode() const { return stack_.back(); }
+ private:
+  Node* node_;
 };
 
 template <typename T, typename Allocator = std::allocator<BinaryTreeNode<T>>>
@@ -98,38 +45,34 @@ class set {
   using const_iterator = const SetIterator<BinaryTreeNode<T>>;
 
   set() : num_elements_(0) {}
-  set(const set& s) {
-    // This is pretty dumb way to implement copying.
-    // TODO improve this.
-    for (auto itr = s.begin(); itr != s.end(); ++itr) {
-      insert(*itr);
-    }
+  set(const set& s) : num_elements_(0) { CopyFrom(s); }
+  set(set&& s) : tree_(std::move(s.tree_)), num_elements_(s.num_elements_) {
+    s.num_elements_ = 0;
   }
 
   set& operator=(const set& s) {
-    for (auto itr = s.begin(); itr != s.end(); ++itr) {
-      insert(*itr);
+    if (this != &s) {
+      clear();
+      CopyFrom(s);
     }
     return *this;
   }
 
-  iterator begin() const {
-    auto* current = tree_.Root();
-
-    std::vector<BinaryTreeNode<T>*> stack;
-    while (current != nullptr) {
-      stack.push_back(current);
-      current = current->Left();
+  set& operator=(set&& s) {
+    if (this != &s) {
+      clear();
+      tree_ = std::move(s.tree_);
+      num_elements_ = s.num_elements_;
+      s.num_elements_ = 0;
     }
-
-    return SetIterator<BinaryTreeNode<T>>(std::move(stack));
+    return *this;
   }
 
-  iterator end() const { return iterator(std::vector<BinaryTreeNode<T>*>()); }
+  iterator begin() const { return iterator(tree_.First()); }
+  iterator end() const { return iterator(nullptr); }
 
   size_t count(const T& t) const {
-    auto current_and_parent = tree_.SearchNode(t);
-    return current_and_parent.first == nullptr ? 0 : 1;
+    return tree_.SearchNode(t) == nullptr ? 0 : 1;
   }
 
   void insert(const T& t) {
@@ -163,8 +106,7 @@ class set {
   }
 
   void erase(iterator pos) {
-    auto [current, parent] = pos.CurrentAndParent();
-    auto* node = tree_.DeleteNode(current, parent);
+    auto* node = tree_.DeleteNode(pos.GetNode());
     if (node == nullptr) {
       return;
     }
@@ -178,20 +120,57 @@ class set {
 
   size_t size() const { return num_elements_; }
 
-  const_iterator find(const T& t) const { return iterator(tree_.FindPath(t)); }
-  iterator find(const T& t) { return iterator(tree_.FindPath(t)); }
+  const_iterator find(const T& t) const {
+    return iterator(tree_.SearchNode(t));
+  }
+  iterator find(const T& t) { return iterator(tree_.SearchNode(t)); }
+
+  // Returns the iterator to the first element that is not less than t.
+  iterator lower_bound(const T& t) const {
+    return iterator(tree_.FindBound(t, /*strict=*/false));
+  }
+
+  // Returns the iterator to the first element that is greater than t.
+  iterator upper_bound(const T& t) const {
+    return iterator(tree_.FindBound(t, /*strict=*/true));
+  }
+
+  // Only for the tests.
+  const RedBlackTree<BinaryTreeNode<T>>& GetTree() const { return tree_; }
 
   void Print() { tree_.PrintTree(); }
 
-  ~set() {
-    // TODO This is very naive implementation :(
-    while (num_elements_ > 0) {
-      erase(begin());
-    }
+  void clear() {
+    DestroyNodes(tree_.Release());
+    num_elements_ = 0;
   }
 
+  ~set() { clear(); }
+
  private:
-  BinaryTree<BinaryTreeNode<T>> tree_;
+  void CopyFrom(const set& s) {
+    tree_.CopyFrom(s.tree_, [this](const T& t) {
+      BinaryTreeNode<T>* node =
+          alloc_::allocate(allocator_, sizeof(BinaryTreeNode<T>));
+      alloc_::construct(allocator_, node, t);
+      return node;
+    });
+    num_elements_ = s.num_elements_;
+  }
+
+  // No need to rebalance since every node is going away.
+  void DestroyNodes(BinaryTreeNode<T>* node) {
+    if (node == nullptr) {
+      return;
+    }
+
+    DestroyNodes(node->Left());
+    DestroyNodes(node->Right());
+    alloc_::destroy(allocator_, node);
+    alloc_::deallocate(allocator_, node, sizeof(BinaryTreeNode<T>));
+  }
+
+  RedBlackTree<BinaryTreeNode<T>> tree_;
 
   size_t num_elements_;
   Allocator allocator_;
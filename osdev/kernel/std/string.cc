@@ -1,25 +1,146 @@
 #include "string.h"
 
+#include "../kernel/kernel_simd.h"
+
 namespace Kernel {
+namespace {
+
+// Below this, the setup cost of the rep string instructions is not worth it.
+constexpr size_t kRepThreshold = 64;
+
+// Saving and restoring XMM registers is not free. Only use SIMD for the large
+// buffers.
+constexpr size_t kSimdThreshold = 1024;
+
+// 8 bytes that may not be aligned, and may alias any other type.
+using UnalignedWord = uint64_t __attribute__((aligned(1), may_alias));
+
+// SIMD can only be used for the kernel memory (See KernelSimdGuard).
+bool IsKernelAddress(const void* addr) {
+  return reinterpret_cast<uint64_t>(addr) >= 0xFFFF'FFFF'8000'0000ULL;
+}
+
+// With ERMS (CPUID.(EAX=07H,ECX=0):EBX[bit 9]), rep movsb and rep stosb are
+// as fast as anything else for the large buffers.
+bool HasERMS() {
+  // Every CPU gives the same answer, so the race is harmless.
+  static int has_erms = -1;
+  if (has_erms < 0) {
+    uint32_t max_leaf, ebx, ecx, edx;
+    asm volatile("cpuid"
+                 : "=a"(max_leaf), "=b"(ebx), "=c"(ecx), "=d"(edx)
+                 : "a"(0));
+    has_erms = 0;
+    if (max_leaf >= 7) {
+      uint32_t eax;
+      asm volatile("cpuid"
+                   : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx)
+                   : "a"(7), "c"(0));
+      has_erms = (ebx >> 9) & 1;
+    }
+  }
+  return has_erms;
+}
+
+void RepMovsb(char* d, const char* s, size_t count) {
+  asm volatile("rep movsb" : "+D"(d), "+S"(s), "+c"(count) : : "memory");
+}
+
+void RepStosb(char* d, uint8_t ch, size_t count) {
+  asm volatile("rep stosb" : "+D"(d), "+c"(count) : "a"(ch) : "memory");
+}
+
+}  // namespace
 
 void* memcpy(void* dest, void* src, size_t count) {
-  char* s = reinterpret_cast<char*>(src);
+  const char* s = reinterpret_cast<const char*>(src);
   char* d = reinterpret_cast<char*>(dest);
-  while (count-- > 0) {
-    *d = *s;
-    d++;
-    s++;
+
+  if (count < kRepThreshold) {
+    for (; count >= 8; count -= 8, d += 8, s += 8) {
+      *reinterpret_cast<UnalignedWord*>(d) =
+          *reinterpret_cast<const UnalignedWord*>(s);
+    }
+    while (count-- > 0) {
+      *d++ = *s++;
+    }
+    return dest;
+  }
+
+  if (HasERMS()) {
+    RepMovsb(d, s, count);
+    return dest;
   }
-  return d;
+
+  if (count >= kSimdThreshold && IsKernelAddress(s) && IsKernelAddress(d)) {
+    KernelSimd::Copy(d, s, count);
+    return dest;
+  }
+
+  size_t num_words = count / 8;
+  asm volatile("rep movsq"
+               : "+D"(d), "+S"(s), "+c"(num_words)
+               :
+               : "memory");
+  RepMovsb(d, s, count % 8);
+  return dest;
 }
 
 void* memset(void* dest, int ch, size_t count) {
   char* d = reinterpret_cast<char*>(dest);
-  while (count-- > 0) {
-    *d = ch;
-    d++;
+  const uint64_t pattern = static_cast<uint8_t>(ch) * 0x0101010101010101ULL;
+
+  if (count < kRepThreshold) {
+    for (; count >= 8; count -= 8, d += 8) {
+      *reinterpret_cast<UnalignedWord*>(d) = pattern;
+    }
+    while (count-- > 0) {
+      *d++ = ch;
+    }
+    return dest;
+  }
+
+  if (HasERMS()) {
+    RepStosb(d, ch, count);
+    return dest;
+  }
+
+  if (count >= kSimdThreshold && IsKernelAddress(d)) {
+    KernelSimd::Fill32(reinterpret_cast<uint32_t*>(d), pattern, count / 4);
+    RepStosb(d + (count / 4) * 4, ch, count % 4);
+    return dest;
   }
-  return d;
+
+  size_t num_words = count / 8;
+  asm volatile("rep stosq"
+               : "+D"(d), "+c"(num_words)
+               : "a"(pattern)
+               : "memory");
+  RepStosb(d, ch, count % 8);
+  return dest;
+}
+
+int memcmp(const void* lhs, const void* rhs, size_t count) {
+  const uint8_t* l = reinterpret_cast<const uint8_t*>(lhs);
+  const uint8_t* r = reinterpret_cast<const uint8_t*>(rhs);
+
+  for (; count >= 8; count -= 8, l += 8, r += 8) {
+    uint64_t lw = *reinterpret_cast<const UnalignedWord*>(l);
+    uint64_t rw = *reinterpret_cast<const UnalignedWord*>(r);
+    if (lw != rw) {
+      // Little endian; the lowest different byte comes first.
+      int shift = __builtin_ctzll(lw ^ rw) & ~7;
+      return static_cast<int>((lw >> shift) & 0xFF) -
+             static_cast<int>((rw >> shift) & 0xFF);
+    }
+  }
+
+  for (; count > 0; count--, l++, r++) {
+    if (*l != *r) {
+      return *l - *r;
+    }
+  }
+  return 0;
 }
 
 int strncmp(const char* lhs, const char* rhs, size_t count) {
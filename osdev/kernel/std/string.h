@@ -10,85 +10,98 @@ namespace Kernel {
 
 void* memcpy(void* dest, void* src, size_t count);
 void* memset(void* dest, int ch, size_t count);
+int memcmp(const void* lhs, const void* rhs, size_t count);
 
 int strncmp(const char* lhs, const char* rhs, size_t count);
 
-// Very simple vector based kernel string. This is not efficient but very easy
-// to implement.
+// Kernel string with the small buffer optimization. Strings that are at most
+// kInlineCapacity long (most of the file names and paths) are kept inside the
+// object and never touch the kernel heap.
 template <typename CharT>
 class KernelBasicString {
  public:
-  KernelBasicString() { str_.push_back(0); }
+  static constexpr size_t kInlineCapacity = 24 / sizeof(CharT) - 1;
 
-  KernelBasicString(const CharT* str) {
+  KernelBasicString() : data_(inline_), size_(0), capacity_(kInlineCapacity) {
+    inline_[0] = 0;
+  }
+
+  KernelBasicString(const CharT* str) : KernelBasicString() {
     size_t sz = 0;
     while (str[sz]) {
       sz++;
     }
-
-    str_.reserve(sz + 1);
-
-    for (size_t i = 0; i <= sz; i++) {
-      str_.push_back(str[i]);
-    }
+    Assign(str, sz);
   }
 
-  KernelBasicString(const CharT* str, size_t sz) {
-    str_.reserve(sz + 1);
-
-    for (size_t i = 0; i < sz; i++) {
-      str_.push_back(str[i]);
-    }
-
-    str_.push_back(0);
+  KernelBasicString(const CharT* str, size_t sz) : KernelBasicString() {
+    Assign(str, sz);
   }
 
-  KernelBasicString(const std::basic_string_view<CharT>& view) {
-    str_.reserve(view.size() + 1);
-
-    for (size_t i = 0; i < view.size(); i++) {
-      str_.push_back(view[i]);
-    }
-
-    if (view.size() == 0 || str_.back() != 0) {
-      str_.push_back(0);
+  KernelBasicString(const std::basic_string_view<CharT>& view)
+      : KernelBasicString() {
+    // Do not include the null terminator of the view.
+    size_t sz = view.size();
+    if (sz > 0 && view[sz - 1] == 0) {
+      sz--;
     }
+    Assign(view.data(), sz);
   }
 
-  KernelBasicString(const KernelBasicString& s) { str_ = s.str_; }
-  KernelBasicString(KernelBasicString&& s) : str_(std::move(s.str_)) {}
+  KernelBasicString(const KernelBasicString& s) : KernelBasicString() {
+    Assign(s.data_, s.size_);
+  }
+  KernelBasicString(KernelBasicString&& s) : KernelBasicString() {
+    MoveFrom(s);
+  }
 
   KernelBasicString& operator=(const KernelBasicString& s) {
-    str_ = s.str_;
+    if (this != &s) {
+      Assign(s.data_, s.size_);
+    }
     return *this;
   }
   KernelBasicString& operator=(KernelBasicString&& s) {
-    str_ = std::move(s.str_);
+    if (this != &s) {
+      Destroy();
+      MoveFrom(s);
+    }
     return *this;
   }
 
-  // Remove last null.
-  size_t size() const { return str_.size() - 1; }
-  size_t capacity() const { return str_.capacity(); }
+  ~KernelBasicString() { Destroy(); }
+
+  size_t size() const { return size_; }
+  size_t capacity() const { return capacity_; }
+
+  CharT& operator[](size_t index) { return data_[index]; }
+  const CharT& at(size_t index) const { return data_[index]; }
 
-  CharT& operator[](size_t index) { return str_[index]; }
-  const CharT& at(size_t index) const { return str_.at(index); }
+  CharT& back() { return data_[size_ - 1]; }
 
-  CharT& back() { return str_[size() - 1]; }
+  const char* c_str() const { return data_; }
+  const CharT* data() const { return data_; }
 
-  const char* c_str() const { return &str_.at(0); }
+  // Whether the string is stored in the inline buffer.
+  bool IsInline() const { return data_ == inline_; }
+
+  void reserve(size_t sz) {
+    if (sz > capacity_) {
+      Grow(sz);
+    }
+  }
 
   KernelBasicString substr(size_t start, size_t len = npos) const {
     if (len == npos) {
       len = size() - start;
     }
 
-    return KernelBasicString(&str_.at(start), len);
+    return KernelBasicString(&data_[start], len);
   }
 
   size_t find(CharT c, size_t from = 0) const {
     for (size_t i = from; i < size(); i++) {
-      if (str_.at(i) == c) {
+      if (data_[i] == c) {
         return i;
       }
     }
@@ -96,13 +109,9 @@ class KernelBasicString {
   }
 
   size_t find_last_of(CharT c) const {
-    for (size_t i = size() - 1; i >= 0; i--) {
-      if (str_.at(i) == c) {
-        return i;
-      }
-
-      if (i == 0) {
-        break;
+    for (size_t i = size(); i > 0; i--) {
+      if (data_[i - 1] == c) {
+        return i - 1;
       }
     }
     return npos;
@@ -149,28 +158,101 @@ class KernelBasicString {
   }
 
   KernelBasicString& append(const KernelBasicString& s) {
-    int current_size = size();
-    str_.reserve(current_size + s.size() + 1);
-
-    for (size_t i = 0; i < s.size(); i++) {
-      if (i == 0) {
-        str_[current_size + i] = s.at(i);
-      } else {
-        str_.push_back(s.at(i));
-      }
+    size_t new_size = size_ + s.size_;
+    if (new_size > capacity_) {
+      // Grow at least twice to make the repeated append cheap.
+      Grow(new_size > capacity_ * 2 ? new_size : capacity_ * 2);
     }
 
-    str_.push_back(0);
+    // Note that s can be *this.
+    for (size_t i = 0; i < s.size_; i++) {
+      data_[size_ + i] = s.data_[i];
+    }
+    data_[new_size] = 0;
+    size_ = new_size;
 
     return *this;
   }
 
  private:
-  std::vector<CharT> str_;
+  void Assign(const CharT* str, size_t sz) {
+    if (sz > capacity_) {
+      Grow(sz);
+    }
+
+    for (size_t i = 0; i < sz; i++) {
+      data_[i] = str[i];
+    }
+    data_[sz] = 0;
+    size_ = sz;
+  }
+
+  // Moves to the heap memory that can hold new_capacity characters.
+  void Grow(size_t new_capacity) {
+    CharT* new_data =
+        static_cast<CharT*>(kmalloc(sizeof(CharT) * (new_capacity + 1)));
+    for (size_t i = 0; i <= size_; i++) {
+      new_data[i] = data_[i];
+    }
+
+    Destroy();
+    data_ = new_data;
+    capacity_ = new_capacity;
+  }
+
+  // Takes the memory of s. The current memory must be freed before.
+  void MoveFrom(KernelBasicString& s) {
+    if (s.IsInline()) {
+      data_ = inline_;
+      for (size_t i = 0; i <= s.size_; i++) {
+        inline_[i] = s.inline_[i];
+      }
+    } else {
+      data_ = s.data_;
+    }
+    size_ = s.size_;
+    capacity_ = s.capacity_;
+
+    s.data_ = s.inline_;
+    s.size_ = 0;
+    s.capacity_ = kInlineCapacity;
+    s.inline_[0] = 0;
+  }
+
+  void Destroy() {
+    if (!IsInline()) {
+      kfree(data_);
+    }
+  }
+
+  // Points to inline_ or the heap memory. Always null terminated.
+  CharT* data_;
+
+  size_t size_;
+
+  // Number of characters that can be stored (not including the null).
+  size_t capacity_;
+
+  CharT inline_[kInlineCapacity + 1];
 };
 
 using KernelString = KernelBasicString<char>;
 
+namespace std {
+
+// Same as hash<string_view>, so the hash tables of KernelString can be looked up
+// by string_view.
+template <>
+struct hash<KernelString> {
+  using is_transparent = void;
+
+  size_t operator()(const KernelString& s) const {
+    return HashBytes(s.c_str(), s.size());
+  }
+};
+
+}  // namespace std
+
 std::vector<KernelString> Split(const KernelString& ks, char delim);
 
 }  // namespace Kernel
@@ -1,12 +1,38 @@
 #include "string_util.h"
 
 namespace Kernel {
+namespace {
+
+using AliasedWord = uint64_t __attribute__((may_alias));
+
+// Whether any byte of the word is 0.
+bool HasZeroByte(uint64_t word) {
+  return ((word - 0x0101010101010101ULL) & ~word & 0x8080808080808080ULL) != 0;
+}
+
+}  // namespace
+
 unsigned int strlen(const char* s) {
-  unsigned int len = 0;
-  while (*s++) {
-    len++;
+  // Check byte by byte until aligned, so that reading a word never goes over
+  // to the next page.
+  const char* current = s;
+  while (reinterpret_cast<uint64_t>(current) % 8 != 0) {
+    if (*current == 0) {
+      return current - s;
+    }
+    current++;
+  }
+
+  const AliasedWord* word = reinterpret_cast<const AliasedWord*>(current);
+  while (!HasZeroByte(*word)) {
+    word++;
+  }
+
+  current = reinterpret_cast<const char*>(word);
+  while (*current) {
+    current++;
   }
-  return len;
+  return current - s;
 }
 
 int strcmp(const char* s, const char* t) {
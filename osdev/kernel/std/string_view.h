@@ -1,6 +1,7 @@
 #ifndef STRING_VIEW_H
 #define STRING_VIEW_H
 
+#include "hash.h"
 #include "string_util.h"
 #include "types.h"
 #include "vector.h"
@@ -15,6 +16,7 @@ class basic_string_view {
   basic_string_view(const CharT* s, size_t count) : str_(s), size_(count) {}
 
   constexpr size_t size() const { return size_; }
+  constexpr const CharT* data() const { return str_; }
   CharT operator[](size_t i) const { return str_[i]; }
 
   constexpr basic_string_view substr(size_t pos = 0,
@@ -92,6 +94,13 @@ class basic_string_view {
 
 using string_view = basic_string_view<char>;
 
+template <>
+struct hash<string_view> {
+  size_t operator()(string_view s) const {
+    return HashBytes(s.data(), s.size());
+  }
+};
+
 template <typename CharT>
 std::vector<basic_string_view<CharT>> Split(basic_string_view<CharT> s,
                                             char delim) {
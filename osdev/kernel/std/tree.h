@@ -3,20 +3,64 @@
 
 #include "printf.h"
 #include "utility.h"
-#include "vector.h"
 
 namespace Kernel {
 namespace std {
 
+template <typename Node>
+class RedBlackTree;
+
+// Links of the RedBlackTree node. An object can be put in the tree without
+// any allocation by inheriting RedBlackTreeHook<Itself> and having KeyType and
+// GetKey() (just like KernelListElement for KernelList).
+template <typename Node>
+class RedBlackTreeHook {
+ public:
+  RedBlackTreeHook()
+      : left_(nullptr), right_(nullptr), parent_(nullptr), is_red_(true) {}
+
+  Node* Left() const { return left_; }
+  Node* Right() const { return right_; }
+  Node* Parent() const { return parent_; }
+  bool IsRed() const { return is_red_; }
+
+  // In order successor (nullptr if it is the last one).
+  Node* Next() const {
+    if (right_ != nullptr) {
+      const RedBlackTreeHook* current = right_;
+      while (current->left_ != nullptr) {
+        current = current->left_;
+      }
+      return const_cast<Node*>(static_cast<const Node*>(current));
+    }
+
+    // Go up until we come from the left.
+    const RedBlackTreeHook* current = this;
+    const RedBlackTreeHook* parent = parent_;
+    while (parent != nullptr && parent->right_ == current) {
+      current = parent;
+      parent = parent->parent_;
+    }
+    return const_cast<Node*>(static_cast<const Node*>(parent));
+  }
+
+ protected:
+  friend class RedBlackTree<Node>;
+
+  Node* left_;
+  Node* right_;
+  Node* parent_;
+
+  bool is_red_;
+};
+
 template <typename Key>
-class BinaryTreeNode {
+class BinaryTreeNode : public RedBlackTreeHook<BinaryTreeNode<Key>> {
  public:
   using KeyType = Key;
 
-  BinaryTreeNode(const KeyType& key)
-      : key_(key), left_(nullptr), right_(nullptr) {}
-  BinaryTreeNode(KeyType&& key)
-      : key_(std::move(key)), left_(nullptr), right_(nullptr) {}
+  BinaryTreeNode(const KeyType& key) : key_(key) {}
+  BinaryTreeNode(KeyType&& key) : key_(std::move(key)) {}
 
   const KeyType& GetKey() const { return key_; }
 
@@ -24,84 +68,105 @@ class BinaryTreeNode {
   // DONT USE WHEN YOU DON'T KNOW WHAT YOU ARE DOING
   KeyType* MutableKey() { return &key_; }
 
-  BinaryTreeNode* Left() const { return left_; }
-  BinaryTreeNode* Right() const { return right_; }
-
   void SetLeft(BinaryTreeNode* left) {
-    ASSERT(left_ == nullptr);
-    left_ = left;
+    ASSERT(this->left_ == nullptr);
+    this->left_ = left;
+    left->parent_ = this;
   }
 
   void SetRight(BinaryTreeNode* right) {
-    ASSERT(right_ == nullptr);
-    right_ = right;
+    ASSERT(this->right_ == nullptr);
+    this->right_ = right;
+    right->parent_ = this;
   }
 
   int NumChild() const {
     int num = 0;
-    if (left_ != nullptr) {
+    if (this->left_ != nullptr) {
       num++;
     }
-    if (right_ != nullptr) {
+    if (this->right_ != nullptr) {
       num++;
     }
     return num;
   }
 
   BinaryTreeNode* GetOnlyChild() {
-    if (left_ != nullptr) {
-      return left_;
+    if (this->left_ != nullptr) {
+      return this->left_;
     }
-    return right_;
+    return this->right_;
   }
 
   BinaryTreeNode* AddChild(BinaryTreeNode* node) {
+    node->parent_ = this;
     if (node->GetKey() > key_) {
-      BinaryTreeNode* prev = right_;
-      right_ = node;
+      BinaryTreeNode* prev = this->right_;
+      this->right_ = node;
       return prev;
     } else {
-      BinaryTreeNode* prev = left_;
-      left_ = node;
+      BinaryTreeNode* prev = this->left_;
+      this->left_ = node;
       return prev;
     }
   }
 
   void RemoveChild(BinaryTreeNode* node) {
-    if (left_ == node) {
-      left_ = nullptr;
-    } else if (right_ == node) {
-      right_ = nullptr;
-    }
-  }
-
-  void SetChild(BinaryTreeNode* node) {
-    if (node->GetKey() > key_) {
-      right_ = node;
-    } else {
-      left_ = node;
-    }
-  }
-
-  void SwitchChild(BinaryTreeNode* from, BinaryTreeNode* to) {
-    if (left_ == from) {
-      left_ = to;
-    } else if (right_ == from) {
-      right_ = to;
+    if (this->left_ == node) {
+      this->left_ = nullptr;
+    } else if (this->right_ == node) {
+      this->right_ = nullptr;
     }
   }
 
  private:
   KeyType key_;
-
-  BinaryTreeNode* left_;
-  BinaryTreeNode* right_;
 };
 
+// Red black tree. Nodes are never copied or swapped; deleting a node only
+// relinks the others, so the pointers to the other nodes stay valid.
 template <typename Node>
-class BinaryTree {
+class RedBlackTree {
  public:
-  BinaryTree() : root_(nullptr) {}
+  using KeyType = typename Node::KeyType;
+
+  RedBlackTree() : root_(nullptr) {}
+
+  // The tree does not own the nodes, so it can only be moved.
+  RedBlackTree(const RedBlackTree&) = delete;
+  RedBlackTree& operator=(const RedBlackTree&) = delete;
+
+  RedBlackTree(RedBlackTree&& tree) : root_(tree.root_) {
+    tree.root_ = nullptr;
+  }
+
+  // The nodes of this tree must be released before.
+  RedBlackTree& operator=(RedBlackTree&& tree) {
+    ASSERT(root_ == nullptr || this == &tree);
+    root_ = tree.root_;
+    if (this != &tree) {
+      tree.root_ = nullptr;
+    }
+    return *this;
+  }
+
+  // Makes the tree empty and returns the root of the nodes that were in the
+  // tree. The links of the nodes are kept so that the owner can walk them to
+  // free.
+  Node* Release() {
+    Node* root = root_;
+    root_ = nullptr;
+    return root;
+  }
+
+  // Copies the other tree node by node. The shape and the colors are kept, so
+  // it does not need any comparison or rebalancing. make_node(key) returns the
+  // new node.
+  template <typename MakeNode>
+  void CopyFrom(const RedBlackTree& tree, MakeNode make_node) {
+    ASSERT(root_ == nullptr);
+    root_ = CopySubtree(tree.root_, nullptr, make_node);
+  }
 
   void PrintTree() {
     if (root_ == nullptr) {
@@ -110,135 +175,372 @@ class BinaryTree {
     PrintTree(root_);
   }
 
-  // Returns the previous node that occupied the new node's position.
+  // Returns the node that has the same key (and does not insert the new node
+  // then). Returns nullptr if inserted.
   Node* InsertNode(Node* node) {
-    if (root_ == nullptr) {
-      root_ = node;
-      return nullptr;
+    Node* parent = nullptr;
+    Node* current = root_;
+    while (current != nullptr) {
+      parent = current;
+      if (current->GetKey() < node->GetKey()) {
+        current = current->right_;
+      } else if (current->GetKey() > node->GetKey()) {
+        current = current->left_;
+      } else {
+        return current;
+      }
     }
 
-    auto [current, parent] = SearchNode(node->GetKey());
-    if (parent != nullptr) {
-      // This will either add new child or replace existing child.
-      Node* prev_node = parent->AddChild(node);
-      return prev_node;
-    } else {
-      Node* prev_root = root_;
+    node->left_ = nullptr;
+    node->right_ = nullptr;
+    node->parent_ = parent;
+    node->is_red_ = true;
+
+    if (parent == nullptr) {
       root_ = node;
-      return prev_root;
+    } else if (parent->GetKey() < node->GetKey()) {
+      parent->right_ = node;
+    } else {
+      parent->left_ = node;
     }
+
+    InsertFixup(node);
+    return nullptr;
   }
 
-  Node* DeleteNode(Node* current, Node* parent) {
-    if (root_ == nullptr) {
-      return nullptr;
-    }
-    if (current == nullptr) {
+  // Unlinks the node from the tree and returns it.
+  Node* DeleteNode(Node* node) {
+    if (node == nullptr) {
       return nullptr;
     }
 
-    if (current->NumChild() == 0) {
-      if (parent != nullptr) {
-        parent->RemoveChild(current);
-      } else {
-        root_ = nullptr;
-      }
-      return current;
-    } else if (current->NumChild() == 1) {
-      Node* child = current->GetOnlyChild();
-      current->RemoveChild(child);
-
-      if (parent != nullptr) {
-        parent->RemoveChild(current);
-        parent->SetChild(child);
-      } else {
-        root_ = child;
-      }
-    } else if (current->NumChild() == 2) {
-      Node* successor = FindLeftModeNodeFrom(current->Right());
-      // Delete that node from the tree.
-      DeleteNode(successor->GetKey());
-      successor->SetRight(current->Right());
-      successor->SetLeft(current->Left());
-
-      if (parent != nullptr) {
-        parent->SwitchChild(current, successor);
+    // The node that is actually removed from its position. When the node has
+    // two children, its successor takes its place.
+    Node* removed = node;
+    bool removed_was_red = removed->is_red_;
+
+    // Node that moves into the removed position and its parent (child can be
+    // nullptr).
+    Node* child;
+    Node* child_parent;
+
+    if (node->left_ == nullptr) {
+      child = node->right_;
+      child_parent = node->parent_;
+      Transplant(node, node->right_);
+    } else if (node->right_ == nullptr) {
+      child = node->left_;
+      child_parent = node->parent_;
+      Transplant(node, node->left_);
+    } else {
+      removed = Minimum(node->right_);
+      removed_was_red = removed->is_red_;
+      child = removed->right_;
+
+      if (removed->parent_ == node) {
+        child_parent = removed;
       } else {
-        root_ = successor;
+        child_parent = removed->parent_;
+        Transplant(removed, removed->right_);
+        removed->right_ = node->right_;
+        removed->right_->parent_ = removed;
       }
-    }
 
-    return current;
-  }
+      Transplant(node, removed);
+      removed->left_ = node->left_;
+      removed->left_->parent_ = removed;
+      removed->is_red_ = node->is_red_;
+    }
 
-  Node* DeleteNode(const typename Node::KeyType& key) {
-    if (root_ == nullptr) {
-      return nullptr;
+    if (!removed_was_red) {
+      DeleteFixup(child, child_parent);
     }
 
-    auto [current, parent] = SearchNode(key);
-    return DeleteNode(current, parent);
+    node->left_ = nullptr;
+    node->right_ = nullptr;
+    node->parent_ = nullptr;
+    return node;
   }
 
-  // Returns found node and its parent.
-  //   - For root node, the parent will be nullptr.
-  //   - For non-existing node, current will be nullptr.
-  pair<Node*, Node*> SearchNode(const typename Node::KeyType& key) const {
-    if (root_ == nullptr) {
-      return std::pair<Node*, Node*>(nullptr, nullptr);
-    }
+  Node* DeleteNode(const KeyType& key) { return DeleteNode(SearchNode(key)); }
 
+  // Returns nullptr if not found.
+  Node* SearchNode(const KeyType& key) const {
     Node* current = root_;
-    Node* parent = nullptr;
     while (current != nullptr) {
       if (current->GetKey() < key) {
-        parent = current;
-        current = current->Right();
+        current = current->right_;
       } else if (current->GetKey() > key) {
-        parent = current;
-        current = current->Left();
+        current = current->left_;
       } else {
-        break;
+        return current;
       }
     }
-
-    return make_pair(current, parent);
+    return nullptr;
   }
 
-  vector<Node*> FindPath(const typename Node::KeyType& key) const {
-    vector<Node*> path;
+  // Returns the first node whose key is not less than key (or greater than key
+  // if strict is set). Returns nullptr if there is no such node.
+  Node* FindBound(const KeyType& key, bool strict) const {
+    Node* bound = nullptr;
 
     Node* current = root_;
     while (current != nullptr) {
-      path.push_back(current);
-      if (current->GetKey() < key) {
-        current = current->Right();
-      } else if (current->GetKey() > key) {
-        current = current->Left();
+      if (current->GetKey() < key || (strict && !(current->GetKey() > key))) {
+        current = current->right_;
       } else {
-        // Found the key!
-        return path;
+        // Current node can be the bound. Look for the smaller one on the left.
+        bound = current;
+        current = current->left_;
       }
     }
+    return bound;
+  }
 
-    // Return an empty vector if the path is not found.
-    return vector<Node*>{};
+  Node* First() const {
+    if (root_ == nullptr) {
+      return nullptr;
+    }
+    return Minimum(root_);
   }
 
-  Node* FindLeftModeNodeFrom(Node* node) const {
+  Node* Root() const { return root_; }
+
+  // Number of nodes on the longest path from the root.
+  size_t Height() const { return Height(root_); }
+
+  // Checks the red black tree properties. Only for the tests.
+  bool Verify() const {
+    if (root_ == nullptr) {
+      return true;
+    }
+    if (root_->is_red_ || root_->parent_ != nullptr) {
+      return false;
+    }
+    return BlackHeight(root_) >= 0;
+  }
+
+ private:
+  static bool IsRed(const Node* node) {
+    return node != nullptr && node->is_red_;
+  }
+
+  template <typename MakeNode>
+  static Node* CopySubtree(const Node* node, Node* parent,
+                           MakeNode& make_node) {
     if (node == nullptr) {
       return nullptr;
     }
-    Node* current = node;
-    while (current->Left() != nullptr) {
-      current = current->Left();
+
+    Node* copied = make_node(node->GetKey());
+    copied->parent_ = parent;
+    copied->is_red_ = node->is_red_;
+    copied->left_ = CopySubtree(node->left_, copied, make_node);
+    copied->right_ = CopySubtree(node->right_, copied, make_node);
+    return copied;
+  }
+
+  static Node* Minimum(Node* node) {
+    while (node->left_ != nullptr) {
+      node = node->left_;
     }
-    return current;
+    return node;
   }
 
-  Node* Root() const { return root_; }
+  // Puts to at where from was (from's children are not touched).
+  void Transplant(Node* from, Node* to) {
+    if (from->parent_ == nullptr) {
+      root_ = to;
+    } else if (from == from->parent_->left_) {
+      from->parent_->left_ = to;
+    } else {
+      from->parent_->right_ = to;
+    }
+
+    if (to != nullptr) {
+      to->parent_ = from->parent_;
+    }
+  }
+
+  // Right child takes the place of the node, and the node becomes its left
+  // child.
+  void RotateLeft(Node* node) {
+    Node* right = node->right_;
+    node->right_ = right->left_;
+    if (right->left_ != nullptr) {
+      right->left_->parent_ = node;
+    }
+    Transplant(node, right);
+    right->left_ = node;
+    node->parent_ = right;
+  }
+
+  // Mirror of RotateLeft.
+  void RotateRight(Node* node) {
+    Node* left = node->left_;
+    node->left_ = left->right_;
+    if (left->right_ != nullptr) {
+      left->right_->parent_ = node;
+    }
+    Transplant(node, left);
+    left->right_ = node;
+    node->parent_ = left;
+  }
+
+  // Newly inserted (red) node may have the red parent.
+  void InsertFixup(Node* node) {
+    while (IsRed(node->parent_)) {
+      Node* parent = node->parent_;
+
+      // Parent is red so it is not the root.
+      Node* grand_parent = parent->parent_;
+
+      if (parent == grand_parent->left_) {
+        Node* uncle = grand_parent->right_;
+        if (IsRed(uncle)) {
+          parent->is_red_ = false;
+          uncle->is_red_ = false;
+          grand_parent->is_red_ = true;
+          node = grand_parent;
+          continue;
+        }
+
+        if (node == parent->right_) {
+          node = parent;
+          RotateLeft(node);
+          parent = node->parent_;
+        }
+        parent->is_red_ = false;
+        grand_parent->is_red_ = true;
+        RotateRight(grand_parent);
+      } else {
+        Node* uncle = grand_parent->left_;
+        if (IsRed(uncle)) {
+          parent->is_red_ = false;
+          uncle->is_red_ = false;
+          grand_parent->is_red_ = true;
+          node = grand_parent;
+          continue;
+        }
+
+        if (node == parent->left_) {
+          node = parent;
+          RotateRight(node);
+          parent = node->parent_;
+        }
+        parent->is_red_ = false;
+        grand_parent->is_red_ = true;
+        RotateLeft(grand_parent);
+      }
+    }
+    root_->is_red_ = false;
+  }
+
+  // The path through node (which can be nullptr) lacks one black node.
+  void DeleteFixup(Node* node, Node* parent) {
+    while (node != root_ && !IsRed(node)) {
+      if (node == parent->left_) {
+        Node* sibling = parent->right_;
+        if (IsRed(sibling)) {
+          sibling->is_red_ = false;
+          parent->is_red_ = true;
+          RotateLeft(parent);
+          sibling = parent->right_;
+        }
+
+        if (!IsRed(sibling->left_) && !IsRed(sibling->right_)) {
+          sibling->is_red_ = true;
+          node = parent;
+          parent = node->parent_;
+          continue;
+        }
+
+        if (!IsRed(sibling->right_)) {
+          sibling->left_->is_red_ = false;
+          sibling->is_red_ = true;
+          RotateRight(sibling);
+          sibling = parent->right_;
+        }
+        sibling->is_red_ = parent->is_red_;
+        parent->is_red_ = false;
+        sibling->right_->is_red_ = false;
+        RotateLeft(parent);
+        node = root_;
+      } else {
+        Node* sibling = parent->left_;
+        if (IsRed(sibling)) {
+          sibling->is_red_ = false;
+          parent->is_red_ = true;
+          RotateRight(parent);
+          sibling = parent->left_;
+        }
+
+        if (!IsRed(sibling->left_) && !IsRed(sibling->right_)) {
+          sibling->is_red_ = true;
+          node = parent;
+          parent = node->parent_;
+          continue;
+        }
+
+        if (!IsRed(sibling->left_)) {
+          sibling->right_->is_red_ = false;
+          sibling->is_red_ = true;
+          RotateLeft(sibling);
+          sibling = parent->left_;
+        }
+        sibling->is_red_ = parent->is_red_;
+        parent->is_red_ = false;
+        sibling->left_->is_red_ = false;
+        RotateRight(parent);
+        node = root_;
+      }
+    }
+
+    if (node != nullptr) {
+      node->is_red_ = false;
+    }
+  }
+
+  static size_t Height(const Node* node) {
+    if (node == nullptr) {
+      return 0;
+    }
+    size_t left = Height(node->left_);
+    size_t right = Height(node->right_);
+    return (left > right ? left : right) + 1;
+  }
+
+  // Returns the number of black nodes to the leaves, or -1 if the subtree is
+  // not valid.
+  static int BlackHeight(const Node* node) {
+    if (node == nullptr) {
+      return 0;
+    }
+
+    const Node* children[2] = {node->left_, node->right_};
+    for (const Node* child : children) {
+      if (child == nullptr) {
+        continue;
+      }
+      if (child->parent_ != node || (node->is_red_ && child->is_red_)) {
+        return -1;
+      }
+    }
+    if (node->left_ != nullptr && !(node->left_->GetKey() < node->GetKey())) {
+      return -1;
+    }
+    if (node->right_ != nullptr && !(node->right_->GetKey() > node->GetKey())) {
+      return -1;
+    }
+
+    int left = BlackHeight(node->left_);
+    int right = BlackHeight(node->right_);
+    if (left < 0 || left != right) {
+      return -1;
+    }
+    return left + (node->is_red_ ? 0 : 1);
+  }
 
- private:
   void PrintTree(Node* node) const {
     Node* left = node->Left();
     Node* right = node->Right();
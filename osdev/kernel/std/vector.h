@@ -119,6 +119,10 @@ class vector {
   }
 
   vector& operator=(const vector& v) {
+    if (this == &v) {
+      return *this;
+    }
+
     // If current allocated memory cannot handle v's elements, we should
     // deallocate and reallocate.
     if (alloc_size_ < v.size_) {
@@ -144,6 +148,10 @@ class vector {
   }
 
   vector& operator=(vector&& v) {
+    if (this == &v) {
+      return *this;
+    }
+
     Destroy();
 
     size_ = v.size_;
@@ -198,6 +206,14 @@ class vector {
     size_--;
   }
 
+  // Destroys every element but keeps the memory.
+  void clear() {
+    for (size_t i = 0; i < size_; i++) {
+      alloc_::destroy(allocator_, &data_[i]);
+    }
+    size_ = 0;
+  }
+
   iterator erase(iterator pos) {
     if (pos == end()) {
       return end();
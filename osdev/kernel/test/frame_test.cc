@@ -421,6 +421,25 @@ TEST(FrameTest, LargeAllocAndFree) {
     }
   }
 }
+
+TEST(FrameTest, UserFrameRefCount) {
+  auto& alloc = UserFrameAllocator::GetPhysicalFrameAllocator();
+
+  void* frame = alloc.AllocateFrame(0);
+  EXPECT_EQ(alloc.GetRefCount(frame), 1);
+
+  alloc.ShareFrame(frame);
+  alloc.ShareFrame(frame);
+  EXPECT_EQ(alloc.GetRefCount(frame), 3);
+
+  alloc.FreeFrame(frame);
+  alloc.FreeFrame(frame);
+  EXPECT_EQ(alloc.GetRefCount(frame), 1);
+
+  alloc.FreeFrame(frame);
+  EXPECT_EQ(alloc.GetRefCount(frame), 0);
+}
+
 }  // namespace
 }  // namespace kernel_test
 }  // namespace Kernel
@@ -1,6 +1,9 @@
 #include "../std/hash_set.h"
 
+#include "../kernel/cpu.h"
 #include "../std/hash_map.h"
+#include "../std/set.h"
+#include "../std/string.h"
 #include "kernel_test.h"
 
 namespace Kernel {
@@ -53,6 +56,62 @@ TEST(HashSetTest, Rehash) {
   }
 }
 
+TEST(HashSetTest, StringViewLookup) {
+  std::HashSet<KernelString> hash_set;
+  hash_set.insert(KernelString("kernel"));
+  hash_set.insert(KernelString("console"));
+
+  // No KernelString is made for the lookup.
+  EXPECT_TRUE(hash_set.find(std::string_view("kernel")) != nullptr);
+  EXPECT_TRUE(hash_set.find(std::string_view("console")) != nullptr);
+  EXPECT_TRUE(hash_set.find(std::string_view("kern")) == nullptr);
+  EXPECT_TRUE(*hash_set.find(KernelString("kernel")) == "kernel");
+
+  std::HashMap<KernelString, int> hash_map;
+  hash_map[KernelString("ls")] = 1;
+  hash_map[KernelString("cd")] = 2;
+  EXPECT_EQ(*hash_map.find(std::string_view("cd")), 2);
+  EXPECT_TRUE(hash_map.find(std::string_view("pwd")) == nullptr);
+}
+
+TEST(HashSetTest, ThroughputBenchmark) {
+  constexpr int kNum = 100000;
+
+  std::HashSet<int> hash_set;
+  uint64_t start = CPURegsAccessProvider::ReadTimeStampCounter();
+  for (int i = 0; i < kNum; i++) {
+    hash_set.insert(i);
+  }
+  uint64_t inserted = CPURegsAccessProvider::ReadTimeStampCounter();
+  size_t num_found = 0;
+  for (int i = 0; i < 2 * kNum; i++) {
+    num_found += (hash_set.find(i) != nullptr);
+  }
+  uint64_t searched = CPURegsAccessProvider::ReadTimeStampCounter();
+  EXPECT_EQ(num_found, (size_t)kNum);
+  EXPECT_EQ(hash_set.size(), (size_t)kNum);
+
+  // Same with the tree based set.
+  std::set<int> tree_set;
+  uint64_t tree_start = CPURegsAccessProvider::ReadTimeStampCounter();
+  for (int i = 0; i < kNum; i++) {
+    tree_set.insert(i);
+  }
+  uint64_t tree_inserted = CPURegsAccessProvider::ReadTimeStampCounter();
+  num_found = 0;
+  for (int i = 0; i < 2 * kNum; i++) {
+    num_found += tree_set.count(i);
+  }
+  uint64_t tree_searched = CPURegsAccessProvider::ReadTimeStampCounter();
+  EXPECT_EQ(num_found, (size_t)kNum);
+
+  kprintf("HashSet : insert %lu find %lu cycles/op\n",
+          (inserted - start) / kNum, (searched - inserted) / (2 * kNum));
+  kprintf("set     : insert %lu find %lu cycles/op\n",
+          (tree_inserted - tree_start) / kNum,
+          (tree_searched - tree_inserted) / (2 * kNum));
+}
+
 void SanityCheck(const std::HashSet<int>& s, bool* is_in, size_t num) {
   for (size_t i = 0; i < num; i++) {
     if (is_in[i]) {
@@ -2,6 +2,7 @@
 #include "kernel_test.h"
 #include "../kernel/scheduler.h"
 #include "../kernel/sync.h"
+#include "../kernel/thread_inbox.h"
 
 namespace Kernel {
 namespace kernel_test {
@@ -168,5 +169,32 @@ TEST(KernelThreadTest, Sema) {
 
   EXPECT_EQ(test_3, 12000000)
 }
+
+void empty_func() {}
+
+// Threads are never started; only the inbox links them.
+TEST(KernelThreadTest, ThreadInboxOrder) {
+  KernelThread thread1(empty_func);
+  KernelThread thread2(empty_func);
+  KernelThread thread3(empty_func);
+
+  ThreadInbox inbox;
+  EXPECT_EQ(inbox.TakeAll(), nullptr);
+
+  // Only the first push sees the empty inbox.
+  EXPECT_EQ(inbox.Push(&thread1), true);
+  EXPECT_EQ(inbox.Push(&thread2), false);
+  EXPECT_EQ(inbox.Push(&thread3), false);
+
+  // Taken out in the pushed order.
+  KernelThread* thread = inbox.TakeAll();
+  EXPECT_EQ(thread, &thread1);
+  EXPECT_EQ(thread->NextInInbox(), &thread2);
+  EXPECT_EQ(thread->NextInInbox()->NextInInbox(), &thread3);
+  EXPECT_EQ(thread3.NextInInbox(), nullptr);
+
+  EXPECT_EQ(inbox.TakeAll(), nullptr);
+  EXPECT_EQ(inbox.Push(&thread1), true);
+}
 }  // namespace kernel_test
 }  // namespace Kernel
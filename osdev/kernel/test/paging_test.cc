@@ -235,6 +235,30 @@ TEST(PagingTest, AllocUserPage) {
   EXPECT_FALSE(IsPagePresent(user_pml4e_base_addr, start_addr + size));
 }
 
+TEST(PagingTest, AllocHugeUserPage) {
+  PageTable page_table;
+  uint64_t* pml4e_base_addr = page_table.CreateEmptyPageTable();
+
+  const size_t vm_addr = 0x10000000;
+  const size_t physical_addr = 0x40200000;
+  page_table.AllocateHugePage(pml4e_base_addr, vm_addr, physical_addr);
+
+  // Every address in 2MB is mapped by the same page directory entry.
+  for (size_t addr = vm_addr; addr < vm_addr + (1 << 21); addr += (1 << 12)) {
+    uint64_t* entry = page_table.GetPageTableEntry(pml4e_base_addr, addr);
+    EXPECT_TRUE(entry != nullptr);
+    EXPECT_TRUE(IsPresent(*entry));
+    EXPECT_TRUE(*entry & 0x80);
+    EXPECT_FALSE(IsSupervisor(*entry));
+    EXPECT_EQ((uint64_t)GetBaseAddress(*entry), physical_addr);
+  }
+
+  EXPECT_TRUE(page_table.GetPageTableEntry(pml4e_base_addr,
+                                           vm_addr + (1 << 21)) == nullptr);
+  EXPECT_TRUE(page_table.GetPageTableEntry(pml4e_base_addr, vm_addr - 1) ==
+              nullptr);
+}
+
 }  // namespace
 }  // namespace kernel_test
 }  // namespace Kernel
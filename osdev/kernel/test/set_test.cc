@@ -1,5 +1,6 @@
 #include "../std/set.h"
 
+#include "../kernel/cpu.h"
 #include "../std/map.h"
 #include "kernel_test.h"
 
@@ -29,6 +30,82 @@ TEST(TreeTest, SimpleInsert) {
   EXPECT_EQ(node1.Left(), &node2);
 }
 
+TEST(TreeTest, RedBlackProperties) {
+  // Inserted as 0, 97, 194, ... (mod 500), and then removed in the same way.
+  constexpr int kNum = 500;
+  std::BinaryTreeNode<int>* nodes[kNum];
+  std::RedBlackTree<std::BinaryTreeNode<int>> tree;
+
+  for (int i = 0; i < kNum; i++) {
+    nodes[i] = new std::BinaryTreeNode<int>((i * 97) % kNum);
+    EXPECT_EQ(tree.InsertNode(nodes[i]), nullptr);
+    EXPECT_TRUE(tree.Verify());
+  }
+
+  // Same key is not inserted.
+  std::BinaryTreeNode<int> duplicate(3);
+  EXPECT_TRUE(tree.InsertNode(&duplicate) != nullptr);
+
+  int expected = 0;
+  for (auto* node = tree.First(); node != nullptr; node = node->Next()) {
+    EXPECT_EQ(node->GetKey(), expected++);
+  }
+  EXPECT_EQ(expected, kNum);
+
+  for (int i = 0; i < kNum; i++) {
+    EXPECT_EQ(tree.DeleteNode((i * 97) % kNum), nodes[i]);
+    EXPECT_TRUE(tree.Verify());
+    delete nodes[i];
+  }
+  EXPECT_EQ(tree.Root(), nullptr);
+}
+
+// Kernel object that is in the tree by itself.
+struct IntrusiveNode : public std::RedBlackTreeHook<IntrusiveNode> {
+  using KeyType = int;
+
+  explicit IntrusiveNode(int key) : key(key) {}
+  const int& GetKey() const { return key; }
+
+  int key;
+};
+
+TEST(TreeTest, IntrusiveHook) {
+  constexpr int kNum = 64;
+  IntrusiveNode* nodes[kNum];
+  for (int i = 0; i < kNum; i++) {
+    nodes[i] = new IntrusiveNode((i * 37) % kNum);
+  }
+
+  size_t num_allocs = kernel_memory_manager.GetNumAllocations();
+  std::RedBlackTree<IntrusiveNode> tree;
+  for (int i = 0; i < kNum; i++) {
+    EXPECT_EQ(tree.InsertNode(nodes[i]), nullptr);
+  }
+  EXPECT_TRUE(tree.Verify());
+
+  int expected = 0;
+  for (auto* node = tree.First(); node != nullptr; node = node->Next()) {
+    EXPECT_EQ(node->key, expected++);
+  }
+  EXPECT_EQ(expected, kNum);
+
+  for (int i = 0; i < kNum; i += 2) {
+    EXPECT_EQ(tree.DeleteNode(nodes[i]), nodes[i]);
+  }
+  EXPECT_TRUE(tree.Verify());
+  EXPECT_EQ(tree.SearchNode(nodes[0]->key), nullptr);
+  EXPECT_EQ(tree.SearchNode(nodes[1]->key), nodes[1]);
+
+  // Tree itself never allocates.
+  EXPECT_EQ(kernel_memory_manager.GetNumAllocations(), num_allocs);
+
+  tree.Release();
+  for (int i = 0; i < kNum; i++) {
+    delete nodes[i];
+  }
+}
+
 template <typename T>
 bool CheckExist(std::set<T>& s, T* data, int num_data) {
   for (int i = 0; i < num_data; i++) {
@@ -89,6 +166,46 @@ TEST(SetTest, SimpleCopy) {
   EXPECT_TRUE(s2.count(0) == 0);
 }
 
+TEST(SetTest, CopyAndMove) {
+  std::set<int> s;
+  for (int i = 0; i < 100; i++) {
+    s.insert((i * 7) % 100);
+  }
+
+  // Copy has the same shape.
+  std::set<int> copied(s);
+  EXPECT_TRUE(copied.GetTree().Verify());
+  EXPECT_EQ(copied.GetTree().Height(), s.GetTree().Height());
+  EXPECT_EQ(copied.size(), 100u);
+
+  // Assignment replaces the elements.
+  std::set<int> assigned;
+  assigned.insert(1000);
+  assigned = s;
+  EXPECT_EQ(assigned.size(), 100u);
+  EXPECT_EQ(assigned.count(1000), 0u);
+
+  // Copies are independent.
+  copied.erase(3);
+  EXPECT_EQ(s.count(3), 1u);
+
+  size_t num_allocs = kernel_memory_manager.GetNumAllocations();
+  std::set<int> moved(std::move(s));
+  EXPECT_EQ(kernel_memory_manager.GetNumAllocations(), num_allocs);
+  EXPECT_EQ(moved.size(), 100u);
+  EXPECT_EQ(s.size(), 0u);
+  EXPECT_TRUE(s.begin() == s.end());
+
+  assigned = std::move(moved);
+  EXPECT_EQ(assigned.size(), 100u);
+  EXPECT_EQ(moved.size(), 0u);
+
+  int expected = 0;
+  for (auto itr = assigned.begin(); itr != assigned.end(); ++itr) {
+    EXPECT_EQ(*itr, expected++);
+  }
+}
+
 TEST(SetTest, SimpleEraseTest) {
   std::set<int> s;
   s.insert(2);
@@ -152,6 +269,72 @@ TEST(SetTest, EraseTest) {
   EXPECT_TRUE(CheckExist(s, data6, 3));
 }
 
+TEST(SetTest, IterateAndBound) {
+  std::set<int> s;
+  s.insert(2);
+  s.insert(1);
+  s.insert(4);
+  s.insert(3);
+  s.insert(10);
+  s.insert(6);
+  s.insert(12);
+  s.insert(7);
+
+  int data[] = {1, 2, 3, 4, 6, 7, 10, 12};
+  int i = 0;
+  for (auto itr = s.begin(); itr != s.end(); ++itr, ++i) {
+    EXPECT_EQ(*itr, data[i]);
+  }
+  EXPECT_EQ(i, 8);
+
+  EXPECT_EQ(*s.lower_bound(0), 1);
+  EXPECT_EQ(*s.lower_bound(5), 6);
+  EXPECT_EQ(*s.lower_bound(7), 7);
+  EXPECT_EQ(*s.upper_bound(7), 10);
+  EXPECT_TRUE(s.lower_bound(13) == s.end());
+  EXPECT_TRUE(s.upper_bound(12) == s.end());
+
+  i = 4;
+  for (auto itr = s.lower_bound(5); itr != s.end(); ++itr, ++i) {
+    EXPECT_EQ(*itr, data[i]);
+  }
+  EXPECT_EQ(i, 8);
+}
+
+TEST(SetTest, SequentialInsertBenchmark) {
+  // Thread ids and such keep increasing. The tree must stay balanced.
+  constexpr int kNum = 100000;
+  std::set<int> s;
+
+  uint64_t start = CPURegsAccessProvider::ReadTimeStampCounter();
+  for (int i = 0; i < kNum; i++) {
+    s.insert(i);
+  }
+  uint64_t inserted = CPURegsAccessProvider::ReadTimeStampCounter();
+
+  size_t num_found = 0;
+  for (int i = 0; i < kNum; i++) {
+    num_found += s.count(i);
+  }
+  uint64_t searched = CPURegsAccessProvider::ReadTimeStampCounter();
+
+  EXPECT_EQ(s.size(), (size_t)kNum);
+  EXPECT_EQ(num_found, (size_t)kNum);
+
+  // Red black tree is at most 2 * log2(n + 1) high.
+  EXPECT_TRUE(s.GetTree().Verify());
+  EXPECT_TRUE(s.GetTree().Height() <= 2 * 17);
+
+  kprintf("%d sequential keys : insert %lu cycles/op, find %lu cycles/op\n",
+          kNum, (inserted - start) / kNum, (searched - inserted) / kNum);
+
+  for (int i = 0; i < kNum; i += 2) {
+    s.erase(i);
+  }
+  EXPECT_EQ(s.size(), (size_t)kNum / 2);
+  EXPECT_TRUE(s.GetTree().Verify());
+}
+
 static int A_dest_cnt = 0;
 
 struct A {
@@ -1,5 +1,8 @@
 #include "string.h"
 
+#include "../kernel/cpu.h"
+#include "../kernel/kmalloc.h"
+#include "../std/string_util.h"
 #include "kernel_test.h"
 
 namespace Kernel {
@@ -35,5 +38,88 @@ TEST(KernelStringTest, TestSplit) {
   EXPECT_EQ(sp[3], KernelString("text"));
 }
 
+TEST(KernelStringTest, MemoryFunctions) {
+  char src[300];
+  char dest[300];
+  for (int i = 0; i < 300; i++) {
+    src[i] = i;
+  }
+
+  // Every size and alignment around the word and the rep thresholds.
+  for (size_t offset = 0; offset < 8; offset++) {
+    for (size_t count = 0; count < 200; count++) {
+      memset(dest, 0x5A, sizeof(dest));
+      EXPECT_TRUE(memcpy(dest + offset, src + 3, count) == dest + offset);
+      EXPECT_EQ(memcmp(dest + offset, src + 3, count), 0);
+      EXPECT_EQ(dest[offset + count], 0x5A);
+
+      memset(dest + offset, 0x11, count);
+      bool all_set = true;
+      for (size_t i = 0; i < count; i++) {
+        all_set &= (dest[offset + i] == 0x11);
+      }
+      EXPECT_TRUE(all_set);
+      EXPECT_EQ(dest[offset + count], 0x5A);
+    }
+  }
+
+  // Returns the difference of the first different byte (as unsigned).
+  memcpy(dest, src, 100);
+  dest[37] = static_cast<char>(0xF0);
+  EXPECT_TRUE(memcmp(dest, src, 100) > 0);
+  EXPECT_TRUE(memcmp(src, dest, 100) < 0);
+  EXPECT_EQ(memcmp(src, dest, 37), 0);
+
+  const char* str = "some string that is longer than a word";
+  for (size_t i = 0; i < 39; i++) {
+    EXPECT_EQ(strlen(str + i), 38 - i);
+  }
+}
+
+namespace {
+
+void ByteCopy(char* dest, const char* src, size_t count) {
+  while (count-- > 0) {
+    *dest++ = *src++;
+  }
+}
+
+}  // namespace
+
+TEST(KernelStringTest, MemcpyBenchmark) {
+  constexpr size_t kMaxSize = 1 << 20;
+  char* src = static_cast<char*>(kmalloc(kMaxSize));
+  char* dest = static_cast<char*>(kmalloc(kMaxSize));
+
+  const size_t sizes[] = {64, 4096, kMaxSize};
+  for (size_t size : sizes) {
+    // Touch around 16 MB for each.
+    const size_t num_iter = (1 << 24) / size;
+
+    uint64_t start = CPURegsAccessProvider::ReadTimeStampCounter();
+    for (size_t i = 0; i < num_iter; i++) {
+      memcpy(dest, src, size);
+    }
+    uint64_t copied = CPURegsAccessProvider::ReadTimeStampCounter();
+    for (size_t i = 0; i < num_iter; i++) {
+      memset(dest, i, size);
+    }
+    uint64_t set = CPURegsAccessProvider::ReadTimeStampCounter();
+    for (size_t i = 0; i < num_iter; i++) {
+      ByteCopy(dest, src, size);
+    }
+    uint64_t byte_copied = CPURegsAccessProvider::ReadTimeStampCounter();
+
+    kprintf("%lu bytes : memcpy %lu memset %lu byte loop %lu cycles\n", size,
+            (copied - start) / num_iter, (set - copied) / num_iter,
+            (byte_copied - set) / num_iter);
+  }
+
+  EXPECT_EQ(memcmp(dest, src, kMaxSize), 0);
+
+  kfree(src);
+  kfree(dest);
+}
+
 }  // namespace kernel_test
 }  // namespace Kernel
@@ -1,7 +1,9 @@
 #include "../kernel/kernel_list.h"
 #include "../std/algorithm.h"
 #include "../std/bitmap.h"
+#include "../std/inlined_vector.h"
 #include "../std/list.h"
+#include "../std/string.h"
 #include "../std/vector.h"
 #include "kernel_test.h"
 
@@ -335,5 +337,72 @@ TEST(AlgorithmTest, UpperBound) {
   EXPECT_EQ(*std::upper_bound(vec.begin(), vec.end(), 8), 11);
 }
 
+TEST(InlinedVectorTest, NoAllocationWhenSmall) {
+  size_t num_allocs = kernel_memory_manager.GetNumAllocations();
+  {
+    std::InlinedVector<int, 4> vec;
+    for (int i = 0; i < 4; i++) {
+      vec.push_back(i);
+    }
+    EXPECT_TRUE(vec.IsInline());
+
+    std::InlinedVector<int, 4> copied = vec;
+    std::InlinedVector<int, 4> moved = std::move(copied);
+    EXPECT_EQ(moved.size(), 4u);
+    EXPECT_EQ(copied.size(), 0u);
+    for (int i = 0; i < 4; i++) {
+      EXPECT_EQ(moved[i], i);
+    }
+  }
+  EXPECT_EQ(kernel_memory_manager.GetNumAllocations(), num_allocs);
+}
+
+TEST(InlinedVectorTest, GrowToHeap) {
+  std::InlinedVector<KernelString, 2> vec;
+  vec.push_back("a");
+  vec.push_back("b");
+
+  size_t num_allocs = kernel_memory_manager.GetNumAllocations();
+  vec.push_back("c");
+  EXPECT_EQ(kernel_memory_manager.GetNumAllocations(), num_allocs + 1);
+  EXPECT_FALSE(vec.IsInline());
+
+  // Moving the heap storage just takes the pointer.
+  std::InlinedVector<KernelString, 2> moved = std::move(vec);
+  EXPECT_EQ(kernel_memory_manager.GetNumAllocations(), num_allocs + 1);
+  EXPECT_EQ(moved.size(), 3u);
+  EXPECT_TRUE(vec.IsInline());
+
+  moved.erase(moved.begin());
+  EXPECT_EQ(moved[0], KernelString("b"));
+  EXPECT_EQ(moved[1], KernelString("c"));
+}
+
+TEST(KernelStringTest, ShortStringNoAllocation) {
+  size_t num_allocs = kernel_memory_manager.GetNumAllocations();
+  {
+    KernelString path("/usr/bin");
+    path.append("/");
+    path.append("ls");
+    EXPECT_TRUE(path.IsInline());
+    EXPECT_TRUE(path == "/usr/bin/ls");
+
+    KernelString copied = path;
+    KernelString name = copied.substr(copied.find_last_of('/') + 1);
+    EXPECT_TRUE(name == "ls");
+  }
+  EXPECT_EQ(kernel_memory_manager.GetNumAllocations(), num_allocs);
+
+  // Only the long one goes to the heap.
+  KernelString long_path("/usr/share/some/very/long/path");
+  EXPECT_EQ(kernel_memory_manager.GetNumAllocations(), num_allocs + 1);
+  EXPECT_FALSE(long_path.IsInline());
+
+  KernelString moved = std::move(long_path);
+  EXPECT_EQ(kernel_memory_manager.GetNumAllocations(), num_allocs + 1);
+  EXPECT_TRUE(moved == "/usr/share/some/very/long/path");
+  EXPECT_EQ(long_path.size(), 0u);
+}
+
 }  // namespace kernel_test
 }  // namespace Kernel
@@ -14,7 +14,15 @@ typedef struct _File_IO {
   // Current (reading/writing) location in buffer.
   int buf_pos;
 
+  // One of _IO_UNBUFFERED, _IO_LINE_BUFFERED and _IO_BLOCK_BUFFERED.
   int mode;
+
+  // Whether the buffer holds the data to be written. Otherwise it holds the
+  // data that is read ahead from the file.
+  int is_writing;
+
+  // Opened files are linked so that they can be flushed at exit.
+  struct _File_IO* next;
 } FILE;
 
 #endif
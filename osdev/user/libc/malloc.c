@@ -1,309 +1,319 @@
 #include "malloc.h"
 
 #include "printf.h"
+#include "string.h"
 #include "syscall.h"
 
 #define FOUR_KB (1 << 12)
-#define END_OF_LIST 0xBBBBBBBB
 
 /*
- * Occupied Block
+ * Small blocks (<= MAX_SMALL_SIZE) are served from the runs. A run is a
+ * RUN_SIZE aligned chunk of the sbrk heap that is split into the slots of the
+ * same size class. The run header is at the start of the run, so the run of
+ * the block is just the block address rounded down to RUN_SIZE.
+ *
+ * Run
  * --------------------------------------------------------------------------
- * | MetaFieldFront (4 b) |  (data) .....  | MetaFieldBackOccupied (4 b)    |
+ * | struct Run (free bitmap ...) | slot 0 | slot 1 | ...        | slot N-1 |
  * --------------------------------------------------------------------------
- *                        |<---- size ---->|
  *
- * Free Block
+ * Large blocks are mmap-ed one by one and are unmapped when they are freed, so
+ * the memory is returned to the kernel. Mmap never returns the memory inside
+ * of the sbrk heap, so the block that is outside of the runs' range
+ * [runs_start, runs_end) is the large block.
+ *
+ * Large Block
  * --------------------------------------------------------------------------
- * |MetaFieldFront(4)|....|MetaFieldBackFreeList(4)|MetaFieldBackOccupied(4)|
+ * | struct LargeBlock (32 b) |  (data) .....                               |
  * --------------------------------------------------------------------------
- *                   |<----------- size ---------->|
  */
 
-static size_t allocated_size = 0;
+#define RUN_SIZE (1 << 16)
+#define MIN_SLOT_SIZE 16
+#define MAX_SMALL_SIZE 8192
+#define NUM_BITMAP_WORDS (RUN_SIZE / MIN_SLOT_SIZE / 64)
 
-// Pre-defined heap start address.
-static char* heap_start = (char*)0x10000004;
+// Four classes per power of two (which bounds the internal fragmentation to
+// 25%).
+static const uint32_t size_classes[] = {
+    16,   32,   48,   64,   80,   96,   112,  128,  160,  192,  224,
+    256,  320,  384,  448,  512,  640,  768,  896,  1024, 1280, 1536,
+    1792, 2048, 2560, 3072, 3584, 4096, 5120, 6144, 7168, 8192};
 
-static size_t free_block_list_start = END_OF_LIST;
+#define NUM_SIZE_CLASSES (sizeof(size_classes) / sizeof(size_classes[0]))
 
-struct MetaFieldFront {
-  uint32_t is_free : 1;
-  uint32_t sz : 31;
-};
+struct Run {
+  // Runs of the same class that have a free slot (or the runs that are not
+  // used at all).
+  struct Run* prev;
+  struct Run* next;
 
-struct MetaFieldBack {
-  uint32_t is_free : 1;
-  uint32_t sz : 31;
-};
+  // Every run that is ever created.
+  struct Run* next_run;
 
-struct MetaFieldBackFreeList {
-  uint32_t prev_free;
-  uint32_t next_free;
-};
+  uint32_t size_class;
+  uint32_t slot_size;
+  uint32_t num_slots;
+  uint32_t num_free;
 
-#define META_BLOCK_SZ \
-  (sizeof(struct MetaFieldFront) + sizeof(struct MetaFieldBack))
+  // There is no free slot in the bitmap words before this.
+  uint32_t first_free_word;
 
-size_t RoundUpToMultipleOfFourKb(size_t bytes) {
-  if (bytes % FOUR_KB == 0) {
-    return bytes;
-  }
-  return ((bytes / FOUR_KB) + 1) * FOUR_KB;
-}
-
-size_t RoundUpToMultipleOf8(size_t bytes) {
-  if (bytes % 8 == 0) {
-    return bytes;
-  }
-  return ((bytes / 8) + 1) * 8;
-}
+  // The bit is set if the slot is free.
+  uint64_t free_bitmap[NUM_BITMAP_WORDS];
+};
 
-void SetMetaField(int is_free, uint32_t sz, uint32_t* meta) {
-  *meta = (is_free | (sz << 1));
-}
+// Slots start at the 16 bytes aligned offset.
+#define RUN_DATA_OFFSET ((sizeof(struct Run) + 15) & ~(size_t)15)
 
-struct MetaFieldFront* GetMetaFieldFront(size_t current) {
-  return (struct MetaFieldFront*)(heap_start + current);
-}
+struct LargeBlock {
+  struct LargeBlock* prev;
+  struct LargeBlock* next;
 
-struct MetaFieldFront* GetRightNeighborMetaFront(size_t offset) {
-  struct MetaFieldFront* front = GetMetaFieldFront(offset);
-  return GetMetaFieldFront(offset + sizeof(struct MetaFieldFront) + front->sz +
-                           sizeof(struct MetaFieldBack));
-}
+  // Size of the entire mapping (including this header).
+  size_t mapped_size;
+  size_t magic;
+};
 
-size_t GetRightNeighborOffset(size_t offset) {
-  struct MetaFieldFront* front = GetMetaFieldFront(offset);
-  return offset + sizeof(struct MetaFieldFront) + front->sz +
-         sizeof(struct MetaFieldBack);
-}
+#define LARGE_BLOCK_MAGIC 0x4C41524745424C4BUL
 
-struct MetaFieldBack* GetMetaFieldBack(size_t current) {
-  return (struct MetaFieldBack*)(heap_start + current);
-}
+// Maps (size + 15) / 16 to the size class.
+static uint8_t class_of_size[MAX_SMALL_SIZE / MIN_SLOT_SIZE + 1];
 
-// Return the start block.
-size_t GetLeftNeighborOffset(size_t offset) {
-  struct MetaFieldBack* back =
-      GetMetaFieldBack(offset - sizeof(struct MetaFieldBack));
-  return offset - META_BLOCK_SZ - back->sz;
-}
+// Runs that have at least one free slot.
+static struct Run* partial_runs[NUM_SIZE_CLASSES];
 
-struct MetaFieldBack* GetMetaFieldBackFromStart(size_t offset) {
-  struct MetaFieldFront* front = GetMetaFieldFront(offset);
-  return GetMetaFieldBack(offset + sizeof(struct MetaFieldFront) + front->sz);
-}
+// Runs that are not used by any class. Memory of the sbrk heap can not be
+// returned, so the empty runs are kept here and reused by any class.
+static struct Run* free_runs = NULL;
 
-struct MetaFieldBackFreeList* GetMetaFieldBackFreeList(
-    size_t free_list_offset) {
-  return (struct MetaFieldBackFreeList*)(heap_start + free_list_offset);
-}
+static struct Run* all_runs = NULL;
 
-struct MetaFieldBackFreeList* GetMetaFieldBackFreeListFromStart(size_t offset) {
-  struct MetaFieldFront* front = GetMetaFieldFront(offset);
-  return GetMetaFieldBackFreeList(offset + sizeof(struct MetaFieldFront) +
-                                  front->sz -
-                                  sizeof(struct MetaFieldBackFreeList));
-}
+// Every run is in [runs_start, runs_end).
+static size_t runs_start = 0;
+static size_t runs_end = 0;
+static struct LargeBlock* large_blocks = NULL;
 
-// Add to the free list.
-void AddToFreeList(size_t offset) {
-  struct MetaFieldBackFreeList* back =
-      GetMetaFieldBackFreeListFromStart(offset);
+static struct malloc_stats stats;
 
-  back->next_free = free_block_list_start;
-  back->prev_free = END_OF_LIST;
+static size_t RoundUpToMultipleOfFourKb(size_t bytes) {
+  return (bytes + FOUR_KB - 1) & ~(size_t)(FOUR_KB - 1);
+}
 
-  if (free_block_list_start != END_OF_LIST) {
-    struct MetaFieldBackFreeList* next_free =
-        GetMetaFieldBackFreeListFromStart(free_block_list_start);
-    next_free->prev_free = offset;
+static void InitMalloc() {
+  size_t current_class = 0;
+  for (size_t i = 0; i < sizeof(class_of_size); i++) {
+    while (size_classes[current_class] < i * MIN_SLOT_SIZE) {
+      current_class++;
+    }
+    class_of_size[i] = current_class;
   }
-
-  free_block_list_start = offset;
 }
 
-// Remove free block from the list.
-void RemoveFromFreeList(size_t offset) {
-  struct MetaFieldBackFreeList* free_list =
-      GetMetaFieldBackFreeListFromStart(offset);
-  if (free_block_list_start == offset) {
-    free_block_list_start = free_list->next_free;
+static void PushRun(struct Run** list, struct Run* run) {
+  run->prev = NULL;
+  run->next = *list;
+  if (*list) {
+    (*list)->prev = run;
   }
+  *list = run;
+}
 
-  if (free_list->prev_free != END_OF_LIST) {
-    struct MetaFieldBackFreeList* prev_free =
-        GetMetaFieldBackFreeListFromStart(free_list->prev_free);
-    prev_free->next_free = free_list->next_free;
+static void RemoveRun(struct Run** list, struct Run* run) {
+  if (run->prev) {
+    run->prev->next = run->next;
+  } else {
+    *list = run->next;
   }
-
-  if (free_list->next_free != END_OF_LIST) {
-    struct MetaFieldBackFreeList* next_free =
-        GetMetaFieldBackFreeListFromStart(free_list->next_free);
-    next_free->prev_free = free_list->prev_free;
+  if (run->next) {
+    run->next->prev = run->prev;
   }
+  run->prev = run->next = NULL;
 }
 
-void MarkOccupied(size_t offset) {
-  struct MetaFieldFront* front = GetMetaFieldFront(offset);
-  front->is_free = 0;
-
-  // Rewire prev and next free blocks.
-  struct MetaFieldBack* back = GetMetaFieldBackFromStart(offset);
-  back->is_free = 0;
-
-  RemoveFromFreeList(offset);
+static struct Run* GetRunOf(void* ptr) {
+  return (struct Run*)((size_t)ptr & ~(size_t)(RUN_SIZE - 1));
 }
 
-void MergeTwoBlocks(size_t left, size_t right) {
-  // 1. Remove left block from the list.
-  RemoveFromFreeList(left);
-
-  // 2. Modify the size of the left chunk.
-  struct MetaFieldFront* left_front = GetMetaFieldFront(left);
-  struct MetaFieldFront* right_front = GetMetaFieldFront(right);
-  left_front->sz += (right_front->sz + META_BLOCK_SZ);
+static char* GetRunData(struct Run* run) {
+  return (char*)run + RUN_DATA_OFFSET;
+}
 
-  // Since left's size has updated, we can get the correct Back.
-  struct MetaFieldBack* back = GetMetaFieldBackFromStart(left);
-  back->sz = left_front->sz;
+// Get the new run from the heap (or the unused runs).
+static struct Run* AllocateRun() {
+  if (free_runs) {
+    struct Run* run = free_runs;
+    RemoveRun(&free_runs, run);
+    return run;
+  }
 
-  // This free list is actually right's free list.
-  struct MetaFieldBackFreeList* free_list =
-      GetMetaFieldBackFreeListFromStart(left);
-  if (free_list->prev_free != END_OF_LIST) {
-    struct MetaFieldBackFreeList* prev_free =
-        GetMetaFieldBackFreeListFromStart(free_list->prev_free);
-    prev_free->next_free = left;
+  // Someone else may have moved the break (e.g by calling sbrk directly), so
+  // do not assume that it is aligned.
+  size_t brk = (size_t)sbrk(0);
+  size_t padding = ((brk + RUN_SIZE - 1) & ~(size_t)(RUN_SIZE - 1)) - brk;
+  if (sbrk(padding + RUN_SIZE) == (void*)-1) {
+    return NULL;
   }
+  stats.heap_bytes += padding + RUN_SIZE;
 
-  if (free_list->next_free != END_OF_LIST) {
-    struct MetaFieldBackFreeList* next_free =
-        GetMetaFieldBackFreeListFromStart(free_list->next_free);
-    next_free->prev_free = left;
+  struct Run* run = (struct Run*)(brk + padding);
+  if (runs_start == 0) {
+    runs_start = (size_t)run;
   }
+  runs_end = (size_t)run + RUN_SIZE;
 
-  if (free_block_list_start == right) {
-    free_block_list_start = left;
+  run->next_run = all_runs;
+  all_runs = run;
+  return run;
+}
+
+static void InitRun(struct Run* run, uint32_t size_class) {
+  run->size_class = size_class;
+  run->slot_size = size_classes[size_class];
+  run->num_slots = (RUN_SIZE - RUN_DATA_OFFSET) / run->slot_size;
+  run->num_free = run->num_slots;
+  run->first_free_word = 0;
+
+  uint32_t num_full_words = run->num_slots / 64;
+  for (uint32_t i = 0; i < NUM_BITMAP_WORDS; i++) {
+    if (i < num_full_words) {
+      run->free_bitmap[i] = ~0UL;
+    } else if (i == num_full_words && run->num_slots % 64) {
+      run->free_bitmap[i] = (1UL << (run->num_slots % 64)) - 1;
+    } else {
+      run->free_bitmap[i] = 0;
+    }
   }
 }
 
-void MarkFree(size_t offset) {
-  struct MetaFieldFront* front = GetMetaFieldFront(offset);
-  struct MetaFieldBack* back = GetMetaFieldBackFromStart(offset);
+static void* TakeSlot(struct Run* run) {
+  uint32_t word = run->first_free_word;
+  while (run->free_bitmap[word] == 0) {
+    word++;
+  }
 
-  front->is_free = 1;
-  back->is_free = 1;
+  uint32_t bit = __builtin_ctzl(run->free_bitmap[word]);
+  run->free_bitmap[word] &= (run->free_bitmap[word] - 1);
+  run->first_free_word = word;
+  run->num_free--;
 
-  AddToFreeList(offset);
+  return GetRunData(run) + (word * 64 + bit) * run->slot_size;
+}
 
-  // Now consider merging nearby free blocks (if exist).
-  size_t right_neighbor = GetRightNeighborOffset(offset);
-  if (right_neighbor < allocated_size) {
-    struct MetaFieldFront* right_neighbor_front =
-        GetMetaFieldFront(right_neighbor);
-    if (right_neighbor_front->is_free) {
-      MergeTwoBlocks(offset, right_neighbor);
-    }
-  }
+static void* MallocSmall(size_t bytes) {
+  uint32_t size_class =
+      class_of_size[(bytes + MIN_SLOT_SIZE - 1) / MIN_SLOT_SIZE];
 
-  if (offset > 0) {
-    size_t left_neighbor = GetLeftNeighborOffset(offset);
-    struct MetaFieldFront* left_neighbor_front =
-        GetMetaFieldFront(left_neighbor);
-    if (left_neighbor_front->is_free) {
-      MergeTwoBlocks(left_neighbor, offset);
+  struct Run* run = partial_runs[size_class];
+  if (run == NULL) {
+    run = AllocateRun();
+    if (run == NULL) {
+      return NULL;
     }
+    InitRun(run, size_class);
+    PushRun(&partial_runs[size_class], run);
   }
-}
 
-size_t FindFreeBlock(size_t sz) {
-  size_t current = free_block_list_start;
-  while (current != END_OF_LIST) {
-    struct MetaFieldFront* front = GetMetaFieldFront(current);
-    if (front->sz >= sz) {
-      return current;
-    }
-    struct MetaFieldBackFreeList* back =
-        GetMetaFieldBackFreeListFromStart(current);
-    current = back->next_free;
+  void* slot = TakeSlot(run);
+  if (run->num_free == 0) {
+    RemoveRun(&partial_runs[size_class], run);
   }
 
-  return -1;
+  stats.allocated_bytes += run->slot_size;
+  return slot;
 }
 
-// Split the block.
-// ---------------------------
-// |    L    |      R        |
-// ---------------------------
-//
-void SplitFreeBlock(size_t offset, size_t bytes) {
-  struct MetaFieldFront* front = GetMetaFieldFront(offset);
-  // Check whether the size of the free block is large enough to be splitted.
-  if (front->sz <
-      bytes + META_BLOCK_SZ + sizeof(struct MetaFieldBackFreeList)) {
+static void FreeSmall(void* mem) {
+  struct Run* run = GetRunOf(mem);
+  uint32_t slot = ((char*)mem - GetRunData(run)) / run->slot_size;
+  uint32_t word = slot / 64;
+  uint64_t mask = 1UL << (slot % 64);
+
+  if (run->free_bitmap[word] & mask) {
+    printf("Double free of %lx \n", (size_t)mem);
     return;
   }
 
-  int new_free_block_size = front->sz - (bytes + META_BLOCK_SZ);
-  front->sz = bytes;
-
-  struct MetaFieldBack* back = GetMetaFieldBackFromStart(offset);
-  back->is_free = 1;
-  back->sz = bytes;
-
-  size_t neighbor = GetRightNeighborOffset(offset);
-
-  // Adjust current free list to point Right block if it were already pointing
-  // the offset.
-  if (free_block_list_start == offset) {
-    free_block_list_start = neighbor;
+  run->free_bitmap[word] |= mask;
+  run->num_free++;
+  if (word < run->first_free_word) {
+    run->first_free_word = word;
   }
+  stats.allocated_bytes -= run->slot_size;
 
-  struct MetaFieldFront* splitted_front = GetMetaFieldFront(neighbor);
-
-  splitted_front->is_free = 1;
-  splitted_front->sz = new_free_block_size;
+  struct Run** list = &partial_runs[run->size_class];
+  if (run->num_free == 1) {
+    PushRun(list, run);
+  }
 
-  struct MetaFieldBack* splitted_back = GetMetaFieldBackFromStart(neighbor);
-  splitted_back->is_free = 1;
-  splitted_back->sz = new_free_block_size;
+  // Keep at least one run per class so that the class that goes back and forth
+  // between empty and non empty does not keep re-initializing the run.
+  if (run->num_free == run->num_slots && (run->prev || run->next)) {
+    RemoveRun(list, run);
+    PushRun(&free_runs, run);
+  }
+}
 
-  // Need to adjust Right block's size to make sure Left block to be added to
-  // free list properly.
-  AddToFreeList(offset);
+static void* MallocLarge(size_t bytes) {
+  size_t mapped_size =
+      RoundUpToMultipleOfFourKb(bytes + sizeof(struct LargeBlock));
+  if (mapped_size < bytes) {
+    return NULL;
+  }
 
-  struct MetaFieldBackFreeList* splitted_free_list =
-      GetMetaFieldBackFreeListFromStart(neighbor);
-  if (splitted_free_list->prev_free != END_OF_LIST) {
-    struct MetaFieldBackFreeList* prev_free =
-        GetMetaFieldBackFreeListFromStart(splitted_free_list->prev_free);
-    prev_free->next_free = neighbor;
+  struct LargeBlock* block = mmap(NULL, mapped_size, PROT_READ | PROT_WRITE,
+                                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (block == MAP_FAILED) {
+    return NULL;
   }
 
-  if (splitted_free_list->next_free != END_OF_LIST) {
-    struct MetaFieldBackFreeList* next_free =
-        GetMetaFieldBackFreeListFromStart(splitted_free_list->next_free);
-    next_free->prev_free = neighbor;
+  block->mapped_size = mapped_size;
+  block->magic = LARGE_BLOCK_MAGIC;
+  block->prev = NULL;
+  block->next = large_blocks;
+  if (large_blocks) {
+    large_blocks->prev = block;
   }
+  large_blocks = block;
+
+  stats.mapped_bytes += mapped_size;
+  stats.allocated_bytes += mapped_size - sizeof(struct LargeBlock);
+  return block + 1;
 }
 
-void InitMalloc() {
-  if (allocated_size != 0) {
+static void FreeLarge(void* mem) {
+  struct LargeBlock* block = (struct LargeBlock*)mem - 1;
+  if (block->magic != LARGE_BLOCK_MAGIC) {
+    printf("Invalid free of %lx \n", (size_t)mem);
     return;
   }
+  block->magic = 0;
 
-  sbrk(FOUR_KB);
-  allocated_size = FOUR_KB - 4;
+  if (block->prev) {
+    block->prev->next = block->next;
+  } else {
+    large_blocks = block->next;
+  }
+  if (block->next) {
+    block->next->prev = block->prev;
+  }
 
-  struct MetaFieldFront* front = GetMetaFieldFront(0);
-  front->sz = FOUR_KB - 4 - META_BLOCK_SZ;
+  stats.mapped_bytes -= block->mapped_size;
+  stats.allocated_bytes -= block->mapped_size - sizeof(struct LargeBlock);
+  munmap(block, block->mapped_size);
+}
 
-  struct MetaFieldBack* back = GetMetaFieldBackFromStart(0);
-  back->sz = front->sz;
+static bool IsLargeBlock(void* mem) {
+  return (size_t)mem < runs_start || (size_t)mem >= runs_end;
+}
 
-  MarkFree(0);
+// Number of bytes that can be used from the block.
+static size_t GetUsableSize(void* mem) {
+  if (IsLargeBlock(mem)) {
+    return ((struct LargeBlock*)mem - 1)->mapped_size -
+           sizeof(struct LargeBlock);
+  }
+  return GetRunOf(mem)->slot_size;
 }
 
 void* malloc(unsigned long int bytes) {
@@ -311,48 +321,14 @@ void* malloc(unsigned long int bytes) {
     return NULL;
   }
 
-  if (allocated_size == 0) {
+  if (class_of_size[sizeof(class_of_size) - 1] == 0) {
     InitMalloc();
   }
 
-  bytes = RoundUpToMultipleOf8(bytes);
-
-  // Try finding a free block.
-  int free_block_offset = FindFreeBlock(bytes);
-  if (free_block_offset != -1) {
-    SplitFreeBlock(free_block_offset, bytes);
-    MarkOccupied(free_block_offset);
-    return heap_start + free_block_offset + 4;
+  if (bytes <= MAX_SMALL_SIZE) {
+    return MallocSmall(bytes);
   }
-
-  // If unable to find, then fetch more memory.
-  size_t needed_mem = RoundUpToMultipleOfFourKb(bytes + META_BLOCK_SZ);
-
-  // Add more memory.
-  sbrk(needed_mem);
-
-  size_t new_free_mem = allocated_size;
-
-  allocated_size += needed_mem;
-
-  // Add new "Free" node from acquired memory.
-  struct MetaFieldFront* front = GetMetaFieldFront(new_free_mem);
-  front->sz = needed_mem - META_BLOCK_SZ;
-
-  struct MetaFieldBack* back = GetMetaFieldBackFromStart(new_free_mem);
-  back->sz = front->sz;
-
-  MarkFree(new_free_mem);
-
-  // If left block has been merged, then we have to update new_free_mem.
-  struct MetaFieldBack* merged_back =
-      GetMetaFieldBack(allocated_size - sizeof(struct MetaFieldBack));
-  new_free_mem = allocated_size - META_BLOCK_SZ - merged_back->sz;
-
-  SplitFreeBlock(new_free_mem, bytes);
-  MarkOccupied(new_free_mem);
-
-  return heap_start + new_free_mem + 4;
+  return MallocLarge(bytes);
 }
 
 void* realloc(void* ptr, unsigned long int bytes) {
@@ -360,26 +336,34 @@ void* realloc(void* ptr, unsigned long int bytes) {
     return malloc(bytes);
   }
 
-  size_t offset = (char*)(ptr)-heap_start - 4;
-  struct MetaFieldFront* front = GetMetaFieldFront(offset);
-  if (front->sz >= bytes) {
+  size_t usable_size = GetUsableSize(ptr);
+  if (usable_size >= bytes) {
     return ptr;
   }
 
+  void* new_ptr = malloc(bytes);
+  if (new_ptr == NULL) {
+    return NULL;
+  }
+  memcpy(new_ptr, ptr, usable_size);
   free(ptr);
-  return malloc(bytes);
+  return new_ptr;
 }
 
 void* calloc(unsigned long int num, unsigned long int size) {
+  if (size != 0 && num > (size_t)-1 / size) {
+    return NULL;
+  }
+
   char* data = (char*)malloc(num * size);
   if (data == NULL) {
     return NULL;
   }
 
-  for (size_t i = 0; i < num * size; i++) {
-    data[i] = 0;
+  // Mmap-ed memory is already zero filled.
+  if (!IsLargeBlock(data)) {
+    memset(data, 0, num * size);
   }
-
   return data;
 }
 
@@ -387,65 +371,114 @@ void free(void* mem) {
   if (mem == 0) {
     return;
   }
-  size_t offset = (char*)(mem)-heap_start - 4;
-  MarkFree(offset);
+
+  if (IsLargeBlock(mem)) {
+    FreeLarge(mem);
+  } else {
+    FreeSmall(mem);
+  }
 }
 
+void __malloc_get_stats(struct malloc_stats* out) { *out = stats; }
+
 void __print_free_list() {
-  size_t current = free_block_list_start;
-  while (current != END_OF_LIST) {
-    struct MetaFieldFront* front = GetMetaFieldFront(current);
-    struct MetaFieldBack* back = GetMetaFieldBackFromStart(current);
-    struct MetaFieldBackFreeList* free_list =
-        GetMetaFieldBackFreeListFromStart(current);
-
-    int sanity_check =
-        (front->sz == back->sz) && (front->is_free == back->is_free);
-    printf("sz [%x] [Is free? : %d] [Prev : %x] [Next %x] [Sanity : %d]\n",
-           front->sz, front->is_free, free_list->prev_free,
-           free_list->next_free, sanity_check);
-    current = free_list->next_free;
+  for (size_t i = 0; i < NUM_SIZE_CLASSES; i++) {
+    if (partial_runs[i] == NULL) {
+      continue;
+    }
+
+    printf("Class [%d] :", size_classes[i]);
+    for (struct Run* run = partial_runs[i]; run; run = run->next) {
+      printf(" [%lx %d/%d]", (size_t)run, run->num_free, run->num_slots);
+    }
+    printf("\n");
+  }
+
+  int num_free_runs = 0;
+  for (struct Run* run = free_runs; run; run = run->next) {
+    num_free_runs++;
   }
+  printf("Unused runs : %d \n", num_free_runs);
 }
 
 void __malloc_show_status() {
-  size_t current = 0;
-  printf("Free list start : %x \n", free_block_list_start);
-  while (current < allocated_size) {
-    struct MetaFieldFront* front = GetMetaFieldFront(current);
-    struct MetaFieldBack* back = GetMetaFieldBackFromStart(current);
-
-    printf("[Offset : %x] [Free? %d] Size : %x [=%x] \n", current,
-           front->is_free, front->sz, back->sz);
-
-    if (front->is_free) {
-      struct MetaFieldBackFreeList* free_list =
-          GetMetaFieldBackFreeListFromStart(current);
-      printf("Free list : prev %lx next : %lx \n", free_list->prev_free,
-             free_list->next_free);
+  printf("Heap : %lx Mapped : %lx Allocated : %lx \n", stats.heap_bytes,
+         stats.mapped_bytes, stats.allocated_bytes);
+  __print_free_list();
+  for (struct LargeBlock* block = large_blocks; block; block = block->next) {
+    printf("Large block [%lx] Size : %lx \n", (size_t)block,
+           block->mapped_size);
+  }
+}
+
+static bool IsInList(struct Run* list, struct Run* run) {
+  for (; list; list = list->next) {
+    if (list == run) {
+      return true;
     }
-    current += (front->sz + META_BLOCK_SZ);
   }
+  return false;
 }
 
-// Iterate entire memory block.
+// Check every run and the large blocks.
 bool __malloc_sanity_check() {
-  size_t current = 0;
-  while (current < allocated_size) {
-    struct MetaFieldFront* front = GetMetaFieldFront(current);
-    struct MetaFieldBack* back = GetMetaFieldBackFromStart(current);
-
-    if (front->sz != back->sz) {
-      printf("Malloc mismatch at %lx [front sz : %x] [back sz : %x] \n",
-             current, front->sz, back->sz);
+  size_t allocated_bytes = 0;
+  for (struct Run* run = all_runs; run; run = run->next_run) {
+    if (IsInList(free_runs, run)) {
+      continue;
+    }
+
+    if (run->size_class >= NUM_SIZE_CLASSES ||
+        run->slot_size != size_classes[run->size_class]) {
+      printf("Malloc corrupted run at %lx [class : %d] \n", (size_t)run,
+             run->size_class);
       return false;
-    } else if (front->is_free != back->is_free) {
-      printf("Malloc mismatch at %lx [front free? %x] [back free? %x] \n",
-             current, front->is_free, back->is_free);
+    }
+
+    uint32_t num_free = 0;
+    for (uint32_t i = 0; i < NUM_BITMAP_WORDS; i++) {
+      if (i < run->first_free_word && run->free_bitmap[i]) {
+        printf("Malloc wrong first free word at %lx \n", (size_t)run);
+        return false;
+      }
+      for (uint64_t bits = run->free_bitmap[i]; bits; bits &= (bits - 1)) {
+        num_free++;
+      }
+    }
+    if (num_free != run->num_free || num_free > run->num_slots) {
+      printf("Malloc mismatch at %lx [bitmap : %d] [num free : %d] \n",
+             (size_t)run, num_free, run->num_free);
+      return false;
+    }
+
+    if ((run->num_free > 0) !=
+        IsInList(partial_runs[run->size_class], run)) {
+      printf("Malloc run %lx [num free : %d] is not in the right list \n",
+             (size_t)run, run->num_free);
+      return false;
+    }
+    allocated_bytes += (run->num_slots - run->num_free) * run->slot_size;
+  }
+
+  size_t mapped_bytes = 0;
+  for (struct LargeBlock* block = large_blocks; block; block = block->next) {
+    if (block->magic != LARGE_BLOCK_MAGIC) {
+      printf("Malloc corrupted large block at %lx \n", (size_t)block);
       return false;
     }
-    current += (front->sz + META_BLOCK_SZ);
+    if (!IsLargeBlock(block + 1)) {
+      printf("Malloc large block %lx is inside of the runs \n", (size_t)block);
+      return false;
+    }
+    mapped_bytes += block->mapped_size;
+    allocated_bytes += block->mapped_size - sizeof(struct LargeBlock);
   }
 
+  if (mapped_bytes != stats.mapped_bytes ||
+      allocated_bytes != stats.allocated_bytes) {
+    printf("Malloc stats mismatch [mapped : %lx] [allocated : %lx] \n",
+           mapped_bytes, allocated_bytes);
+    return false;
+  }
   return true;
 }
@@ -2,12 +2,26 @@
 #define LIBC_MALLOC_H
 
 #include <stdbool.h>
+#include <stddef.h>
 
 void* malloc(unsigned long int bytes);
 void* calloc(unsigned long int num, unsigned long int size);
 void* realloc(void* ptr, unsigned long int bytes);
 void free(void* mem);
 
+struct malloc_stats {
+  // Bytes taken from the sbrk heap (never returned).
+  size_t heap_bytes;
+
+  // Bytes mmap-ed for the large blocks.
+  size_t mapped_bytes;
+
+  // Bytes handed out to the user (rounded up to the size of the slot).
+  size_t allocated_bytes;
+};
+
+void __malloc_get_stats(struct malloc_stats* stats);
+
 void __print_free_list();
 bool __malloc_sanity_check();
 void __malloc_show_status();
@@ -35,6 +35,7 @@
 
 #include "float.h"
 #include "stdint.h"
+#include "stdio.h"
 #include "syscall.h"
 #include "unistd.h"
 
@@ -918,7 +919,10 @@ int printf_(const char* format, ...) {
   buffer[ret] = 0;
   va_end(va);
 
-  write(STDOUT_FILENO, buffer, ret);
+  // Goes through stdout so that it is not reordered with what is buffered,
+  // but is not held back.
+  fwrite(buffer, 1, ret, stdout);
+  fflush(stdout);
   return ret;
 }
 
@@ -930,7 +934,7 @@ int fprintf_(FILE* stream, const char* format, ...) {
   buffer[ret] = 0;
   va_end(va);
 
-  write(stream->fd, buffer, ret);
+  fwrite(buffer, 1, ret, stream);
   return ret;
 }
 
@@ -10,13 +10,73 @@
 #define O_DIRECTORY 4
 #define O_TRUNC 8
 
-FILE _f_stdin = {.fd = 0};
-FILE _f_stdout = {.fd = 1};
-FILE _f_stderr = {.fd = 2};
+FILE _f_stdin = {.fd = 0, .mode = _IO_LINE_BUFFERED};
+FILE _f_stdout = {.fd = 1, .mode = _IO_LINE_BUFFERED};
+FILE _f_stderr = {.fd = 2, .mode = _IO_UNBUFFERED};
+
+// Files opened by fopen (that are not closed yet).
+static FILE *opened_files = NULL;
+
+// Write everything in the buffer. Returns -1 if it could not.
+static int flush_write_buffer(FILE *stream) {
+  int written = 0;
+  while (written < stream->buf_size) {
+    int64_t num_write = write(stream->fd, (char *)stream->buffer + written,
+                              stream->buf_size - written);
+    if (num_write <= 0) {
+      break;
+    }
+    written += num_write;
+  }
 
-FILE *fopen(const char *pathname, const char *mode) {
-  FILE *file = (FILE *)malloc(sizeof(FILE));
+  int ret = (written == stream->buf_size) ? 0 : -1;
+  stream->buf_size = 0;
+  stream->buf_pos = 0;
+  return ret;
+}
+
+// Drop the read ahead data. The file offset is moved back to where the user
+// actually read.
+static void drop_read_buffer(FILE *stream) {
+  if (stream->buf_pos < stream->buf_size) {
+    lseek(stream->fd, stream->buf_pos - stream->buf_size, SEEK_CUR);
+  }
+  stream->buf_size = 0;
+  stream->buf_pos = 0;
+}
+
+static void switch_to_write(FILE *stream) {
+  if (!stream->is_writing) {
+    drop_read_buffer(stream);
+    stream->is_writing = 1;
+  }
+}
+
+static void switch_to_read(FILE *stream) {
+  if (stream->is_writing) {
+    flush_write_buffer(stream);
+    stream->is_writing = 0;
+  }
+
+  // The user should see the prompt before typing.
+  if (stream == stdin) {
+    fflush(stdout);
+  }
+}
 
+// Returns the number of bytes that are ready in the buffer (0 on EOF).
+static int fill_read_buffer(FILE *stream) {
+  if (stream->buf_pos < stream->buf_size) {
+    return stream->buf_size - stream->buf_pos;
+  }
+
+  int64_t read_cnt = read(stream->fd, (char *)stream->buffer, BUF_SIZE);
+  stream->buf_size = read_cnt > 0 ? read_cnt : 0;
+  stream->buf_pos = 0;
+  return stream->buf_size;
+}
+
+FILE *fopen(const char *pathname, const char *mode) {
   int fd;
   if (strcmp(mode, "w") == 0) {
     fd = open(pathname, O_TRUNC);
@@ -28,47 +88,138 @@ FILE *fopen(const char *pathname, const char *mode) {
     return NULL;
   }
 
+  FILE *file = (FILE *)malloc(sizeof(FILE));
   file->fd = fd;
   file->buf_size = 0;
   file->buf_pos = 0;
+  file->mode = _IO_BLOCK_BUFFERED;
+  file->is_writing = 0;
 
-  (void)mode;
+  file->next = opened_files;
+  opened_files = file;
 
   return file;
 }
 
+// Flush and release the stream. The descriptor is not closed since there is
+// no close syscall.
 int fclose(FILE *stream) {
-  (void)stream;
-  return 0;
+  if (stream == NULL) {
+    return EOF;
+  }
+
+  int ret = fflush(stream);
+  if (stream == stdin || stream == stdout || stream == stderr) {
+    return ret;
+  }
+
+  for (FILE **file = &opened_files; *file; file = &(*file)->next) {
+    if (*file == stream) {
+      *file = stream->next;
+      break;
+    }
+  }
+  free(stream);
+  return ret;
 }
 
+// If stream is NULL, flushes every stream.
 int fflush(FILE *stream) {
-  (void)stream;
+  if (stream == NULL) {
+    int ret = 0;
+    for (FILE *file = opened_files; file; file = file->next) {
+      ret |= fflush(file);
+    }
+    ret |= fflush(stdout);
+    ret |= fflush(stderr);
+    return ret;
+  }
+
+  if (stream->is_writing) {
+    return flush_write_buffer(stream);
+  }
+  drop_read_buffer(stream);
   return 0;
 }
 
 size_t fread(void *ptr, size_t size, size_t count, FILE *stream) {
-  if (size == 0 || count == 0) {
+  if (size == 0 || count == 0 || stream == NULL) {
     return 0;
   }
+  switch_to_read(stream);
+
+  char *dest = (char *)ptr;
+  size_t total = size * count;
+  size_t done = 0;
+
+  // First take whatever is already in the buffer.
+  size_t buffered = stream->buf_size - stream->buf_pos;
+  if (buffered > 0) {
+    done = buffered < total ? buffered : total;
+    memcpy(dest, stream->buffer + stream->buf_pos, done);
+    stream->buf_pos += done;
+  }
 
-  for (size_t index = 0; index < count; index++) {
-    for (size_t i = 0; i < size; i++) {
-      int c = fgetc(stream);
-      if (c == EOF) {
-        return index;
+  while (done < total) {
+    size_t left = total - done;
+
+    // Large reads go directly to the user buffer.
+    if (left >= BUF_SIZE) {
+      int64_t read_cnt = read(stream->fd, dest + done, left);
+      if (read_cnt <= 0) {
+        break;
       }
-      ((char *)ptr)[index * size + i] = c;
+      done += read_cnt;
+      continue;
+    }
+
+    int ready = fill_read_buffer(stream);
+    if (ready == 0) {
+      break;
     }
+    size_t copy = (size_t)ready < left ? (size_t)ready : left;
+    memcpy(dest + done, stream->buffer + stream->buf_pos, copy);
+    stream->buf_pos += copy;
+    done += copy;
   }
 
-  return count;
+  return done / size;
 }
 
 size_t fwrite(const void *ptr, size_t size, size_t count, FILE *stream) {
-  int fd = stream->fd;
-  int num_write = write(fd, (char *)ptr, size * count);
-  return num_write / size;
+  if (size == 0 || count == 0 || stream == NULL) {
+    return 0;
+  }
+  switch_to_write(stream);
+
+  size_t total = size * count;
+
+  // Fits in the buffer.
+  if (!(stream->mode & _IO_UNBUFFERED) &&
+      stream->buf_size + total < BUF_SIZE) {
+    memcpy(stream->buffer + stream->buf_size, ptr, total);
+    stream->buf_size += total;
+    stream->buf_pos = stream->buf_size;
+
+    if ((stream->mode & _IO_LINE_BUFFERED) && memchr(ptr, '\n', total)) {
+      flush_write_buffer(stream);
+    }
+    return count;
+  }
+
+  // Whatever is buffered must go out first. Both are written in a single
+  // syscall.
+  struct iovec iov[2] = {{stream->buffer, stream->buf_size},
+                         {(void *)ptr, total}};
+  int buffered = stream->buf_size;
+  int64_t num_write = writev(stream->fd, iov, 2);
+  stream->buf_size = 0;
+  stream->buf_pos = 0;
+
+  if (num_write < buffered) {
+    return 0;
+  }
+  return (num_write - buffered) / size;
 }
 
 int fgetc(FILE *stream) {
@@ -76,17 +227,11 @@ int fgetc(FILE *stream) {
     return EOF;
   }
 
-  // If the buffer is all read.
-  if (stream->buf_size == stream->buf_pos) {
-    // Then we need to fill up the buffer.
-    int read_cnt = read(stream->fd, (char *)stream->buffer, BUF_SIZE);
-    stream->buf_size = read_cnt;
-    stream->buf_pos = 0;
-  }
-
-  // Even after try filling the buffer, if the buffer is still empty.
-  if (stream->buf_size == 0) {
-    return EOF;
+  if (stream->buf_pos == stream->buf_size) {
+    switch_to_read(stream);
+    if (fill_read_buffer(stream) == 0) {
+      return EOF;
+    }
   }
 
   return stream->buffer[stream->buf_pos++];
@@ -100,28 +245,41 @@ char *fgets(char *str, int count, FILE *stream) {
   if (count < 1) {
     return NULL;
   }
+  switch_to_read(stream);
+
+  // Copy the buffer up to the new line at once.
+  int i = 0;
+  while (i < count - 1) {
+    int ready = fill_read_buffer(stream);
+    if (ready == 0) {
+      break;
+    }
 
-  for (int i = 0; i < count - 1; i++) {
-    int ch = fgetc(stream);
-    if (ch == EOF) {
-      // No bytes are read.
-      if (i == 0) {
-        return NULL;
-      }
+    if (ready > count - 1 - i) {
+      ready = count - 1 - i;
+    }
 
-      str[i] = 0;
-      return str;
-    } else {
-      str[i] = ch;
+    const unsigned char *start = stream->buffer + stream->buf_pos;
+    const unsigned char *new_line = memchr(start, '\n', ready);
+    if (new_line) {
+      ready = new_line - start + 1;
     }
 
-    if (ch == '\n') {
-      str[i + 1] = 0;
-      return str;
+    memcpy(str + i, start, ready);
+    stream->buf_pos += ready;
+    i += ready;
+
+    if (new_line) {
+      break;
     }
   }
 
-  str[count - 1] = 0;
+  // No bytes are read.
+  if (i == 0) {
+    return NULL;
+  }
+
+  str[i] = 0;
   return str;
 }
 
@@ -129,35 +287,26 @@ int fputc(int ch, FILE *stream) {
   if (!stream) {
     return EOF;
   }
+  switch_to_write(stream);
 
-  // If the buffer is full, then we should flush.
-  if (stream->buf_size == BUF_SIZE) {
-    write(stream->fd, (char *)stream->buffer, stream->buf_size);
-    stream->buf_size = 0;
-    stream->buf_pos = 0;
-  }
-
-  stream->buffer[stream->buf_pos] = ch;
+  stream->buffer[stream->buf_size] = ch;
   stream->buf_size++;
-  stream->buf_pos++;
+  stream->buf_pos = stream->buf_size;
 
   bool should_flush = false;
   if (stream->mode & _IO_UNBUFFERED) {
     should_flush = true;
   } else if ((stream->mode & _IO_LINE_BUFFERED) && ch == '\n') {
     should_flush = true;
-  } else if ((stream->mode & _IO_BLOCK_BUFFERED) &&
-             stream->buf_size == BUF_SIZE) {
+  } else if (stream->buf_size == BUF_SIZE) {
     should_flush = true;
   }
 
-  if (should_flush) {
-    write(stream->fd, (char*)stream->buffer, stream->buf_size);
-    stream->buf_size = 0;
-    stream->buf_pos = 0;
+  if (should_flush && flush_write_buffer(stream) == -1) {
+    return EOF;
   }
 
-  return ch;
+  return (unsigned char)ch;
 }
 
 long ftell(FILE *stream) {
@@ -165,20 +314,25 @@ long ftell(FILE *stream) {
     return EOF;
   }
 
-  return lseek(stream->fd, 0, SEEK_CUR);
+  long pos = lseek(stream->fd, 0, SEEK_CUR);
+  if (pos < 0) {
+    return pos;
+  }
+
+  // The file offset is ahead (or behind) of the user by the buffer.
+  if (stream->is_writing) {
+    return pos + stream->buf_size;
+  }
+  return pos - (stream->buf_size - stream->buf_pos);
 }
 
 int fseek(FILE *stream, long offset, int origin) {
-  // Empty the buffer.
-  stream->buf_pos = 0;
-  stream->buf_size = 0;
+  // Empty the buffer. This also moves the file offset to where the user is.
+  fflush(stream);
 
-  return lseek(stream->fd, offset, origin);
+  return lseek(stream->fd, offset, origin) < 0 ? -1 : 0;
 }
 
-int putchar(int ch) {
-  printf("%c", ch);
-  return ch;
-}
+int putchar(int ch) { return fputc(ch, stdout); }
 
-int puts(const char *str) { return printf("%s", str); }
+int puts(const char *str) { return fwrite(str, 1, strlen(str), stdout); }
@@ -21,10 +21,11 @@
 
 FILE *fopen(const char *pathname, const char *mode);
 
-// Do nothing.
+// Flushes the stream. The descriptor is kept open.
 int fclose(FILE *stream);
 
-// Do nothing.
+// Writes out the buffered data (or drops the read ahead data). Flushes every
+// stream if stream is NULL.
 int fflush(FILE *stream);
 
 size_t fread(void *ptr, size_t size, size_t count, FILE *stream);
@@ -32,6 +33,7 @@ size_t fwrite(const void *ptr, size_t size, size_t count, FILE *stream);
 
 int fgetc(FILE *stream);
 char *fgets(char *str, int count, FILE *stream);
+int fputc(int ch, FILE *stream);
 
 long ftell(FILE *stream);
 int fseek(FILE *stream, long offset, int origin);
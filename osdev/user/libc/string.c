@@ -5,19 +5,87 @@
 #include <stdio.h>
 #include <stdlib.h>
 
-void* memcpy(void* dest, const void* src, size_t count) {
-  const char* s = src;
-  char* d = dest;
+// 16 bytes in the XMM register. The user space can always use SSE2.
+typedef char v16qi __attribute__((vector_size(16), may_alias));
+typedef char v16qi_u __attribute__((vector_size(16), aligned(1), may_alias));
+typedef uint64_t v2du __attribute__((vector_size(16)));
+typedef uint64_t uint64_u __attribute__((aligned(1), may_alias));
+
+// Above this, rep movsb (or stosb) is faster if the CPU has ERMS.
+#define REP_THRESHOLD 2048
+
+// CPUID.(EAX=07H,ECX=0):EBX.ERMS[bit 9].
+static int has_erms() {
+  static int erms = -1;
+  if (erms < 0) {
+    uint32_t max_leaf, ebx, ecx, edx;
+    asm volatile("cpuid"
+                 : "=a"(max_leaf), "=b"(ebx), "=c"(ecx), "=d"(edx)
+                 : "a"(0));
+    erms = 0;
+    if (max_leaf >= 7) {
+      uint32_t eax;
+      asm volatile("cpuid"
+                   : "=a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx)
+                   : "a"(7), "c"(0));
+      erms = (ebx >> 9) & 1;
+    }
+  }
+  return erms;
+}
+
+// Copies from the front. Safe even if dest is below the overlapping src.
+static void copy_forward(char* d, const char* s, size_t count) {
+  if (count >= REP_THRESHOLD && has_erms()) {
+    asm volatile("rep movsb" : "+D"(d), "+S"(s), "+c"(count) : : "memory");
+    return;
+  }
+
+  for (; count >= 16; count -= 16, d += 16, s += 16) {
+    *(v16qi_u*)d = *(const v16qi_u*)s;
+  }
+  for (; count >= 8; count -= 8, d += 8, s += 8) {
+    *(uint64_u*)d = *(const uint64_u*)s;
+  }
   while (count-- > 0) {
-    *d = *s;
-    d++;
-    s++;
+    *d++ = *s++;
   }
+}
+
+// Copies from the back. Safe even if dest is above the overlapping src.
+static void copy_backward(char* d, const char* s, size_t count) {
+  d += count;
+  s += count;
+  for (; count >= 16; count -= 16) {
+    d -= 16;
+    s -= 16;
+    *(v16qi_u*)d = *(const v16qi_u*)s;
+  }
+  while (count-- > 0) {
+    *--d = *--s;
+  }
+}
+
+void* memcpy(void* dest, const void* src, size_t count) {
+  copy_forward(dest, src, count);
   return dest;
 }
 
 void* memset(void* dest, int ch, size_t count) {
   unsigned char* d = dest;
+  if (count >= REP_THRESHOLD && has_erms()) {
+    asm volatile("rep stosb" : "+D"(d), "+c"(count) : "a"(ch) : "memory");
+    return dest;
+  }
+
+  const uint64_t pattern = (unsigned char)ch * 0x0101010101010101ULL;
+  const v16qi fill = (v16qi)((v2du){pattern, pattern});
+  for (; count >= 16; count -= 16, d += 16) {
+    *(v16qi_u*)d = fill;
+  }
+  for (; count >= 8; count -= 8, d += 8) {
+    *(uint64_u*)d = pattern;
+  }
   while (count-- > 0) {
     *d = (unsigned char)(ch);
     d++;
@@ -29,24 +97,28 @@ void* memmove(void* dest, const void* src, size_t count) {
   size_t srcp = (size_t)src;
   size_t destp = (size_t)dest;
 
-  // They do not overlap.
-  if (destp > srcp && destp - srcp >= count) {
-    return memcpy(dest, src, count);
-  } else if (srcp > destp && srcp - destp >= count) {
-    return memcpy(dest, src, count);
+  // Copying from the front only breaks when dest is inside of src.
+  if (destp > srcp && destp - srcp < count) {
+    copy_backward(dest, src, count);
+  } else {
+    copy_forward(dest, src, count);
   }
-
-  char* mem = malloc(count);
-  memcpy(mem, src, count);
-  dest = memcpy(dest, mem, count);
-  free(mem);
-
   return dest;
 }
 
 int memcmp(const void* lhs, const void* rhs, size_t count) {
-  const char* lhs_p = lhs;
-  const char* rhs_p = rhs;
+  const unsigned char* lhs_p = lhs;
+  const unsigned char* rhs_p = rhs;
+
+  for (; count >= 16; count -= 16, lhs_p += 16, rhs_p += 16) {
+    v16qi eq = __builtin_ia32_pcmpeqb128(*(const v16qi_u*)lhs_p,
+                                         *(const v16qi_u*)rhs_p);
+    int mask = __builtin_ia32_pmovmskb128(eq);
+    if (mask != 0xFFFF) {
+      int index = __builtin_ctz(~mask);
+      return lhs_p[index] - rhs_p[index];
+    }
+  }
 
   while (count--) {
     if (*lhs_p != *rhs_p) {
@@ -60,6 +132,30 @@ int memcmp(const void* lhs, const void* rhs, size_t count) {
   return 0;
 }
 
+void* memchr(const void* ptr, int ch, size_t count) {
+  const char* s = (const char*)ptr;
+  const char c = ch;
+  v16qi target;
+  for (int i = 0; i < 16; i++) {
+    target[i] = c;
+  }
+
+  size_t i = 0;
+  for (; i + 16 <= count; i += 16) {
+    int mask = __builtin_ia32_pmovmskb128(
+        __builtin_ia32_pcmpeqb128(*(const v16qi_u*)(s + i), target));
+    if (mask) {
+      return (void*)(s + i + __builtin_ctz(mask));
+    }
+  }
+  for (; i < count; i++) {
+    if (s[i] == c) {
+      return (void*)(s + i);
+    }
+  }
+  return 0;
+}
+
 int strcmp(const char* lhs, const char* rhs) {
   while (*lhs && (*lhs == *rhs)) {
     lhs++;
@@ -84,12 +180,21 @@ int strncmp(const char* lhs, const char* rhs, size_t count) {
 }
 
 size_t strlen(const char* str) {
-  size_t sz = 0;
-  while (*str) {
-    str++;
-    sz++;
+  // Aligned 16 bytes never go over to the next page. The bytes before str are
+  // masked out.
+  size_t offset = (size_t)str % 16;
+  const v16qi* current = (const v16qi*)(str - offset);
+  const v16qi zero = {0};
+
+  int mask = __builtin_ia32_pmovmskb128(
+      __builtin_ia32_pcmpeqb128(*current, zero));
+  mask &= (0xFFFF << offset);
+  while (mask == 0) {
+    current++;
+    mask = __builtin_ia32_pmovmskb128(
+        __builtin_ia32_pcmpeqb128(*current, zero));
   }
-  return sz;
+  return (const char*)current + __builtin_ctz(mask) - str;
 }
 
 char* strchr(const char* str, int ch) {
@@ -1,5 +1,6 @@
 #include "syscall.h"
 
+#include <stdio.h>
 #include <string.h>
 
 int64_t syscall_0(int64_t sysnum) {
@@ -105,6 +106,32 @@ int64_t syscall_4(int64_t sysnum, int64_t arg1, int64_t arg2, int64_t arg3,
   return ret;
 }
 
+int64_t syscall_6(int64_t sysnum, int64_t arg1, int64_t arg2, int64_t arg3,
+                  int64_t arg4, int64_t arg5, int64_t arg6) {
+  int64_t ret;
+  register long r10 __asm__("r10") = arg4;
+  register long r8 __asm__("r8") = arg5;
+  register long r9 __asm__("r9") = arg6;
+
+  asm volatile(
+      "push %%rbx\n"
+      "push %%r12\n"
+      "push %%r13\n"
+      "push %%r14\n"
+      "push %%r15\n"
+      "syscall\n"
+      "pop %%r15\n"
+      "pop %%r14\n"
+      "pop %%r13\n"
+      "pop %%r12\n"
+      "pop %%rbx\n"
+      : "=a"(ret)
+      : "a"(sysnum), "D"(arg1), "S"(arg2), "d"(arg3), "r"(r10), "r"(r8),
+        "r"(r9)
+      :);
+  return ret;
+}
+
 int open(const char* pathname, int flag) {
   return syscall_2(7, (int64_t)pathname, flag);
 }
@@ -121,6 +148,18 @@ size_t write(int fd, const char* s, size_t count) {
   return syscall_3(2, /*stdout*/ fd, (int64_t)s, count);
 }
 
+void exit(int exit_code) {
+  // Buffered writes would be lost otherwise.
+  fflush(NULL);
+  syscall_1(0, exit_code);
+
+  // Should never reach here.
+  while (1) {
+  }
+}
+
+pid_t fork() { return syscall_0(3); }
+
 int spawn(pid_t* pid, const char* s) {
   return syscall_2(5, (int64_t)pid, (int64_t)s);
 }
@@ -156,8 +195,145 @@ int screen(enum ScreenCommands command, void* arg1, void* arg2) {
 
 int usleep(size_t microseconds) { return syscall_1(16, (int64_t)microseconds); }
 
-size_t mstick() { return syscall_0(17); }
+static const struct ClockPage* clock_page() {
+  return (const struct ClockPage*)CLOCK_PAGE_ADDR;
+}
+
+// Read the tick and the TSC at the tick consistently.
+static void read_clock_page(uint64_t* tick, uint64_t* tsc_at_tick) {
+  const struct ClockPage* page = clock_page();
+  while (1) {
+    uint64_t seq = page->sequence;
+    if (seq & 1) {
+      continue;
+    }
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    *tick = page->timer_tick;
+    *tsc_at_tick = page->tsc_at_tick;
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (page->sequence == seq) {
+      return;
+    }
+  }
+}
+
+static uint64_t rdtsc() {
+  uint32_t lo, hi;
+  asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+  return ((uint64_t)hi << 32) | lo;
+}
+
+size_t mstick() {
+  const struct ClockPage* page = clock_page();
+  uint64_t ten_ns = page->num_10nanosec_per_tick;
+
+  // Timer is not calibrated yet.
+  if (ten_ns == 0) {
+    return syscall_0(17);
+  }
+
+  // Same as Timer::GetMsTick().
+  return (page->timer_tick / 10) * ten_ns / 10000;
+}
+
+size_t ustick() {
+  const struct ClockPage* page = clock_page();
+  uint64_t ten_ns = page->num_10nanosec_per_tick;
+  if (ten_ns == 0) {
+    return syscall_0(17) * 1000;
+  }
+
+  uint64_t tick, tsc_at_tick;
+  read_clock_page(&tick, &tsc_at_tick);
+
+  // TSC of this CPU can be slightly behind CPU 0's. Also never go past the
+  // next tick.
+  uint64_t tsc_per_tick = page->tsc_per_tick;
+  uint64_t tsc_delta = rdtsc() - tsc_at_tick;
+  if ((int64_t)tsc_delta < 0) {
+    tsc_delta = 0;
+  } else if (tsc_delta > tsc_per_tick) {
+    tsc_delta = tsc_per_tick;
+  }
+
+  uint64_t us = tick * ten_ns / 100;
+  if (tsc_per_tick != 0) {
+    us += tsc_delta * ten_ns / tsc_per_tick / 100;
+  }
+  return us;
+}
 
 off_t lseek(int fd, off_t offset, int whence) {
   return syscall_3(19, fd, offset, whence);
 }
+
+void* mmap(void* addr, size_t length, int prot, int flags, int fd,
+           off_t offset) {
+  int64_t ret = syscall_6(20, (int64_t)addr, length, prot, flags, fd, offset);
+  if (ret == -1) {
+    return MAP_FAILED;
+  }
+  return (void*)ret;
+}
+
+int munmap(void* addr, size_t length) {
+  return syscall_2(21, (int64_t)addr, length);
+}
+
+int64_t readv(int fd, const struct iovec* iov, int iovcnt) {
+  return syscall_3(22, fd, (int64_t)iov, iovcnt);
+}
+
+int64_t writev(int fd, const struct iovec* iov, int iovcnt) {
+  return syscall_3(23, fd, (int64_t)iov, iovcnt);
+}
+
+int io_batch(struct io_batch_op* ops, int num_ops) {
+  return syscall_2(24, (int64_t)ops, num_ops);
+}
+
+int io_ring_setup(struct io_ring* ring, uint32_t num_entries, size_t buf_size) {
+  int64_t addr = syscall_2(25, num_entries, buf_size);
+  if (addr == -1) {
+    return -1;
+  }
+
+  char* base = (char*)addr;
+  ring->header = (struct io_ring_header*)base;
+  ring->sq = (struct io_ring_sqe*)(base + ring->header->sq_offset);
+  ring->cq = (struct io_ring_cqe*)(base + ring->header->cq_offset);
+  ring->buf = base + ring->header->buf_offset;
+  return 0;
+}
+
+int io_ring_submit(struct io_ring* ring, const struct io_ring_sqe* sqe) {
+  struct io_ring_header* header = ring->header;
+  uint32_t tail = header->sq_tail;
+  if (tail - __atomic_load_n(&header->sq_head, __ATOMIC_ACQUIRE) ==
+      header->num_entries) {
+    return -1;
+  }
+
+  ring->sq[tail & (header->num_entries - 1)] = *sqe;
+  __atomic_store_n(&header->sq_tail, tail + 1, __ATOMIC_RELEASE);
+  return 0;
+}
+
+int io_ring_peek(struct io_ring* ring, struct io_ring_cqe* cqe) {
+  struct io_ring_header* header = ring->header;
+  uint32_t head = header->cq_head;
+  if (head == __atomic_load_n(&header->cq_tail, __ATOMIC_ACQUIRE)) {
+    return 0;
+  }
+
+  *cqe = ring->cq[head & (header->num_entries - 1)];
+  __atomic_store_n(&header->cq_head, head + 1, __ATOMIC_RELEASE);
+  return 1;
+}
+
+int io_ring_wait(struct io_ring* ring, uint32_t min_complete) {
+  (void)ring;
+  return syscall_1(26, min_complete);
+}
@@ -11,6 +11,9 @@ size_t pread(int64_t fd, char* buf, size_t count, off_t offset);
 
 size_t write(int fd, const char* s, size_t count);
 
+// Returns the pid of the child to the parent and 0 to the child.
+pid_t fork();
+
 int spawn(pid_t* pid, const char* s);
 pid_t waitpid(pid_t pid, int* status);
 
@@ -51,7 +54,15 @@ enum ConsoleCommand {
 
 int console(enum ConsoleCommand command);
 
-enum ScreenCommands { GET_SCREEN_INFO, COPY_FRAME_BUFFER };
+// MAP_FRAME_BUFFER(FrameBufferInfo*) returns the address of the frame buffer
+// that is shared with the kernel (0 on failure). Draw to it and then call
+// PRESENT_FRAME_BUFFER to show it on the screen.
+enum ScreenCommands {
+  GET_SCREEN_INFO,
+  COPY_FRAME_BUFFER,
+  MAP_FRAME_BUFFER,
+  PRESENT_FRAME_BUFFER
+};
 
 struct ScreenInfo {
   int width;
@@ -72,6 +83,126 @@ struct FrameBufferInfo {
 int screen(enum ScreenCommands command, void* arg1, void* arg2);
 
 int usleep(size_t microseconds);
+
+// Milliseconds since the boot. Read from the clock page without the syscall.
 size_t mstick();
 
+// Same as mstick() but in microseconds. Interpolated with the TSC between
+// the timer ticks.
+size_t ustick();
+
+// Page that the kernel maps (read only) to every process. Must match
+// ClockPageData in kernel/clock_page.h.
+#define CLOCK_PAGE_ADDR 0x3F7FF000
+
+struct ClockPage {
+  volatile uint64_t sequence;
+  volatile uint64_t timer_tick;
+  volatile uint64_t tsc_at_tick;
+  volatile uint64_t num_10nanosec_per_tick;
+  volatile uint64_t tsc_per_tick;
+};
+
 off_t lseek(int fd, off_t offset, int whence);
+
+#define PROT_NONE 0x0
+#define PROT_READ 0x1
+#define PROT_WRITE 0x2
+#define PROT_EXEC 0x4
+
+#define MAP_SHARED 0x1
+#define MAP_PRIVATE 0x2
+#define MAP_FIXED 0x10
+#define MAP_ANONYMOUS 0x20
+
+#define MAP_FAILED ((void*)-1)
+
+// Map the file (or zero filled memory if MAP_ANONYMOUS is set). Only read only
+// or MAP_PRIVATE file mappings are supported.
+void* mmap(void* addr, size_t length, int prot, int flags, int fd,
+           off_t offset);
+int munmap(void* addr, size_t length);
+
+struct iovec {
+  void* iov_base;
+  size_t iov_len;
+};
+
+// Read (or write) the buffers in order with one syscall. Stops at the first
+// short read (or write). Returns the total bytes or -1 on failure.
+int64_t readv(int fd, const struct iovec* iov, int iovcnt);
+int64_t writev(int fd, const struct iovec* iov, int iovcnt);
+
+enum IOBatchOpType { IO_BATCH_READ, IO_BATCH_WRITE, IO_BATCH_PREAD };
+
+struct io_batch_op {
+  int op;  // IOBatchOpType
+  int fd;
+  void* buf;
+  size_t count;
+  off_t offset;  // Only for IO_BATCH_PREAD.
+
+  // Set by the kernel. Same as what read/write/pread would return.
+  int64_t result;
+};
+
+// Run the operations in order with one syscall. Returns the number of the
+// operations that are run.
+int io_batch(struct io_batch_op* ops, int num_ops);
+
+// Asynchronous I/O ring that is shared with the kernel. Same as IORingHeader,
+// IORingSubmission and IORingCompletion in kernel/io_ring.h.
+struct io_ring_header {
+  uint32_t sq_head;
+  uint32_t sq_tail;
+  uint32_t cq_head;
+  uint32_t cq_tail;
+  uint32_t num_entries;
+  uint32_t sq_offset;
+  uint32_t cq_offset;
+  uint32_t buf_offset;
+  uint64_t buf_size;
+};
+
+struct io_ring_sqe {
+  int32_t op;  // IOBatchOpType
+  int32_t fd;
+
+  // The data is read to (or written from) ring->buf + buf_offset.
+  uint64_t buf_offset;
+  uint64_t count;
+  int64_t offset;  // Only for IO_BATCH_PREAD.
+
+  uint64_t user_data;
+};
+
+struct io_ring_cqe {
+  uint64_t user_data;
+  int64_t result;
+};
+
+struct io_ring {
+  struct io_ring_header* header;
+  struct io_ring_sqe* sq;
+  struct io_ring_cqe* cq;
+
+  // The buffer area that the submissions read to (or write from). Only this
+  // is accessible from the kernel worker.
+  char* buf;
+};
+
+// Creates the ring of the process. num_entries must be a power of 2 and at
+// most 256. buf_size can be at most 1MB. Returns 0 on success.
+int io_ring_setup(struct io_ring* ring, uint32_t num_entries, size_t buf_size);
+
+// Queue the submission without the syscall. The kernel runs it once
+// io_ring_wait() is called. Returns -1 if the ring is full.
+int io_ring_submit(struct io_ring* ring, const struct io_ring_sqe* sqe);
+
+// Reap one completion if there is any. Returns 1 if reaped and 0 otherwise.
+int io_ring_peek(struct io_ring* ring, struct io_ring_cqe* cqe);
+
+// Starts the queued submissions and waits until there are at least
+// min_complete completions to reap (or nothing is in flight). Returns the
+// number of completions to reap.
+int io_ring_wait(struct io_ring* ring, uint32_t min_complete);
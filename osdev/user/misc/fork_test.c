@@ -0,0 +1,34 @@
+#include <printf.h>
+#include <stdlib.h>
+#include <syscall.h>
+
+// Measures how long it takes to fork a child that exits immediately and wait
+// for it.
+int main(int argc, char* argv[]) {
+  int num_fork = 1000;
+  if (argc >= 2) {
+    num_fork = atoi(argv[1]);
+  }
+
+  // Touch some heap so that the fork has something to share.
+  char* heap = sbrk(4096 * 16);
+  for (int i = 0; i < 4096 * 16; i++) {
+    heap[i] = i;
+  }
+
+  size_t start = mstick();
+  for (int i = 0; i < num_fork; i++) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      exit(0);
+    }
+
+    int status;
+    waitpid(pid, &status);
+  }
+  size_t end = mstick();
+
+  printf("fork + exit + waitpid x %d : %d ms (%d us per fork)\n", num_fork,
+         end - start, (end - start) * 1000 / num_fork);
+  return 0;
+}
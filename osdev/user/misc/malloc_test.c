@@ -230,12 +230,120 @@ void test_random_large() {
   __malloc_show_status();
 }
 
+void test_realloc_keeps_data() {
+  char* s = malloc(20);
+  for (int i = 0; i < 20; i++) {
+    s[i] = i;
+  }
+
+  // Still fits in the same slot.
+  ASSERT_TRUE(realloc(s, 30) == s);
+
+  s = realloc(s, 20000);
+  for (int i = 0; i < 20; i++) {
+    ASSERT_TRUE(s[i] == i);
+  }
+  free(s);
+  ASSERT_TRUE(__malloc_sanity_check());
+}
+
+void test_large_block_is_returned() {
+  struct malloc_stats before;
+  __malloc_get_stats(&before);
+
+  char* mem = malloc(1 << 20);
+  memset(mem, 0xDD, 1 << 20);
+
+  struct malloc_stats after;
+  __malloc_get_stats(&after);
+  ASSERT_TRUE(after.mapped_bytes >= before.mapped_bytes + (1 << 20));
+
+  free(mem);
+  __malloc_get_stats(&after);
+  ASSERT_TRUE(after.mapped_bytes == before.mapped_bytes);
+  ASSERT_TRUE(__malloc_sanity_check());
+}
+
+static uint32_t bench_rand_state = 1;
+
+static uint32_t bench_rand() {
+  bench_rand_state = bench_rand_state * 1103515245 + 12345;
+  return bench_rand_state >> 8;
+}
+
+// Mostly small objects with the occasional large one.
+static size_t bench_size() {
+  uint32_t r = bench_rand();
+  if (r % 16 == 0) {
+    return r % 16384 + 1;
+  }
+  return r % 256 + 1;
+}
+
+void test_benchmark() {
+  const int num_slots = 2000;
+  const int num_ops = 200000;
+
+  void* mem[num_slots];
+  size_t mem_size[num_slots];
+  for (int i = 0; i < num_slots; i++) {
+    mem[i] = 0;
+  }
+
+  size_t requested = 0;
+  size_t peak_requested = 0;
+  struct malloc_stats peak;
+  __malloc_get_stats(&peak);
+
+  size_t start = ustick();
+  for (int i = 0; i < num_ops; i++) {
+    int index = bench_rand() % num_slots;
+    if (mem[index]) {
+      free(mem[index]);
+      mem[index] = 0;
+      requested -= mem_size[index];
+      continue;
+    }
+
+    mem_size[index] = bench_size();
+    mem[index] = malloc(mem_size[index]);
+    *(char*)mem[index] = 1;
+    requested += mem_size[index];
+
+    if (requested > peak_requested) {
+      peak_requested = requested;
+      __malloc_get_stats(&peak);
+    }
+  }
+  size_t elapsed = ustick() - start;
+  if (elapsed == 0) {
+    elapsed = 1;
+  }
+
+  for (int i = 0; i < num_slots; i++) {
+    free(mem[i]);
+  }
+  ASSERT_TRUE(__malloc_sanity_check());
+
+  // Fragmentation is the portion of the memory taken from the kernel that is
+  // not requested by the user at the peak.
+  size_t footprint = peak.heap_bytes + peak.mapped_bytes;
+  printf("%d ops in %d us : %d ops/sec \n", num_ops, (int)elapsed,
+         (int)((size_t)num_ops * 1000000 / elapsed));
+  printf("Peak requested %d KB, footprint %d KB : fragmentation %d%% \n",
+         (int)(peak_requested >> 10), (int)(footprint >> 10),
+         (int)(100 - peak_requested * 100 / footprint));
+}
+
 int main() {
   REGISTER_TEST(test_simple_malloc);
   REGISTER_TEST(test_couple_of_mallocs);
   REGISTER_TEST(test_small_random);
   REGISTER_TEST(test_medium_random);
   REGISTER_TEST(test_random_large);
+  REGISTER_TEST(test_realloc_keeps_data);
+  REGISTER_TEST(test_large_block_is_returned);
+  REGISTER_TEST(test_benchmark);
 
   RunTest();
 
@@ -0,0 +1,64 @@
+#include <printf.h>
+#include <stdlib.h>
+#include <syscall.h>
+
+// Counts the lines of the file by mapping it and by reading it into the heap,
+// and compares how long each takes.
+int count_lines(const char* buf, size_t size) {
+  int lines = 0;
+  for (size_t i = 0; i < size; i++) {
+    if (buf[i] == '\n') {
+      lines++;
+    }
+  }
+  return lines;
+}
+
+int main(int argc, char* argv[]) {
+  const char* file_name = "/misc/shakespeares.txt";
+  if (argc >= 2) {
+    file_name = argv[1];
+  }
+
+  struct stat file_stat;
+  if (stat(file_name, &file_stat) != 0 || file_stat.file_size == 0) {
+    printf("Cannot stat %s\n", file_name);
+    return 1;
+  }
+  size_t size = file_stat.file_size;
+
+  int fd = open(file_name, 0);
+
+  size_t start = mstick();
+  char* mapped = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (mapped == MAP_FAILED) {
+    printf("mmap failed\n");
+    return 1;
+  }
+  int mapped_lines = count_lines(mapped, size);
+  munmap(mapped, size);
+  size_t mmap_time = mstick() - start;
+
+  start = mstick();
+  char* buf = malloc(size);
+  pread(fd, buf, size, 0);
+  int read_lines = count_lines(buf, size);
+  free(buf);
+  size_t read_time = mstick() - start;
+
+  // Anonymous memory must be zero filled.
+  char* anon = mmap(NULL, 4096 * 4, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  for (int i = 0; i < 4096 * 4; i++) {
+    if (anon[i] != 0) {
+      printf("Anonymous page is not zero filled\n");
+      return 1;
+    }
+    anon[i] = i;
+  }
+  munmap(anon, 4096 * 4);
+
+  printf("Lines : %d (mmap : %d ms) %d (read : %d ms)\n", mapped_lines,
+         mmap_time, read_lines, read_time);
+  return 0;
+}
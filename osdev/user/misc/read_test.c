@@ -1,5 +1,7 @@
+#include <malloc.h>
 #include <stdio.h>
 #include <string.h>
+#include <syscall.h>
 
 #include "../test/ctest.h"
 
@@ -31,8 +33,94 @@ void test_ftell() {
   char line[100];
   fgets(line, sizeof(line), file);
 
-  // We read the size of the buffer already.
-  ASSERT_TRUE(ftell(file) == BUF_SIZE);
+  // The file offset is ahead by the buffer, but ftell tells where the user
+  // is.
+  ASSERT_TRUE(ftell(file) == (long)strlen(line));
+
+  fseek(file, 5, SEEK_CUR);
+  ASSERT_TRUE(ftell(file) == (long)strlen(line) + 5);
+}
+
+void test_fread() {
+  FILE* file = fopen("/misc/shakespeares.txt", "r");
+  char small[10] = {0};
+  ASSERT_TRUE(fread(small, 1, 9, file) == 9);
+  ASSERT_TRUE(strcmp(small, "Romeo and") == 0);
+
+  // Larger than the buffer; goes directly to the user memory after taking
+  // what is in the buffer.
+  const int size = 3 * BUF_SIZE;
+  char* large = malloc(size);
+  ASSERT_TRUE(fread(large, 1, size, file) == (size_t)size);
+  ASSERT_TRUE(strncmp(large, " Juliet\n", 8) == 0);
+  ASSERT_TRUE(ftell(file) == 9 + size);
+
+  // Only the remaining ones are read.
+  ASSERT_TRUE(fread(large, 1, size, file) == (size_t)(141695 - 9 - size));
+  ASSERT_TRUE(fread(large, 1, size, file) == 0);
+  free(large);
+}
+
+void test_fwrite() {
+  FILE* file = fopen("/misc/temp", "w");
+  for (int i = 0; i < 1000; i++) {
+    fputc('a' + i % 26, file);
+  }
+  ASSERT_TRUE(fwrite("hello", 1, 5, file) == 5);
+  ASSERT_TRUE(ftell(file) == 1005);
+  fclose(file);
+
+  file = fopen("/misc/temp", "r");
+  char buf[1006] = {0};
+  ASSERT_TRUE(fread(buf, 1, 1005, file) == 1005);
+  ASSERT_TRUE(buf[27] == 'b');
+  ASSERT_TRUE(strcmp(buf + 1000, "hello") == 0);
+  fclose(file);
+}
+
+// Reads the whole shakespeares.txt in a few different ways.
+void test_read_benchmark() {
+  const size_t file_size = 141695;
+
+  size_t start = ustick();
+  int fd = open("/misc/shakespeares.txt", 0);
+  char c;
+  size_t num_read = 0;
+  while (read(fd, &c, 1) == 1) {
+    num_read++;
+  }
+  size_t read_done = ustick();
+  ASSERT_TRUE(num_read == file_size);
+
+  FILE* file = fopen("/misc/shakespeares.txt", "r");
+  num_read = 0;
+  while (fgetc(file) != EOF) {
+    num_read++;
+  }
+  size_t fgetc_done = ustick();
+  ASSERT_TRUE(num_read == file_size);
+
+  fseek(file, 0, SEEK_SET);
+  char line[128];
+  num_read = 0;
+  while (fgets(line, sizeof(line), file)) {
+    num_read += strlen(line);
+  }
+  size_t fgets_done = ustick();
+  ASSERT_TRUE(num_read == file_size);
+
+  fseek(file, 0, SEEK_SET);
+  char* all = malloc(file_size);
+  num_read = fread(all, 1, file_size, file);
+  size_t fread_done = ustick();
+  ASSERT_TRUE(num_read == file_size);
+
+  free(all);
+  fclose(file);
+
+  printf("read(1 byte) %d us fgetc %d us fgets %d us fread %d us \n",
+         (int)(read_done - start), (int)(fgetc_done - read_done),
+         (int)(fgets_done - fgetc_done), (int)(fread_done - fgets_done));
 }
 
 void test_filesize() {
@@ -41,6 +129,78 @@ void test_filesize() {
   ASSERT_TRUE(ftell(stream) == 141695);
 }
 
+void test_readv() {
+  int fd = open("/misc/short_text.txt", 0);
+  char first[2];
+  char second[10];
+  struct iovec iov[2] = {{first, sizeof(first)}, {second, sizeof(second)}};
+
+  // "some\n" is split to the two buffers.
+  ASSERT_TRUE(readv(fd, iov, 2) == 5);
+  ASSERT_TRUE(first[0] == 's' && first[1] == 'o');
+  ASSERT_TRUE(second[0] == 'm' && second[1] == 'e' && second[2] == '\n');
+}
+
+void test_io_batch() {
+  int fd = open("/misc/shakespeares.txt", 0);
+  char line[10] = {0};
+  char word[7] = {0};
+
+  struct io_batch_op ops[3] = {
+      {IO_BATCH_PREAD, fd, line, 9, 0, 0},
+      {IO_BATCH_PREAD, fd, word, 6, 10, 0},
+      {IO_BATCH_READ, /*fd=*/-1, line, 9, 0, 0},
+  };
+  ASSERT_TRUE(io_batch(ops, 3) == 3);
+  ASSERT_TRUE(ops[0].result == 9);
+  ASSERT_TRUE(strcmp(line, "Romeo and") == 0);
+  ASSERT_TRUE(ops[1].result == 6);
+  ASSERT_TRUE(strcmp(word, "Juliet") == 0);
+
+  // Not opened descriptor.
+  ASSERT_TRUE(ops[2].result == 0);
+}
+
+void test_io_ring() {
+  int fd = open("/misc/shakespeares.txt", 0);
+
+  struct io_ring ring;
+  ASSERT_TRUE(io_ring_setup(&ring, 8, 4096) == 0);
+
+  // Only one ring per process.
+  struct io_ring another;
+  ASSERT_TRUE(io_ring_setup(&another, 8, 4096) == -1);
+
+  struct io_ring_sqe sqe[2] = {
+      {IO_BATCH_PREAD, fd, /*buf_offset=*/0, 9, /*offset=*/0, 1},
+      {IO_BATCH_PREAD, fd, /*buf_offset=*/100, 6, /*offset=*/10, 2},
+  };
+  ASSERT_TRUE(io_ring_submit(&ring, &sqe[0]) == 0);
+  ASSERT_TRUE(io_ring_submit(&ring, &sqe[1]) == 0);
+  ASSERT_TRUE(io_ring_wait(&ring, 2) == 2);
+
+  struct io_ring_cqe cqe;
+  for (int i = 0; i < 2; i++) {
+    ASSERT_TRUE(io_ring_peek(&ring, &cqe) == 1);
+    if (cqe.user_data == 1) {
+      ASSERT_TRUE(cqe.result == 9);
+      ASSERT_TRUE(strncmp(ring.buf, "Romeo and", 9) == 0);
+    } else {
+      ASSERT_TRUE(cqe.user_data == 2);
+      ASSERT_TRUE(cqe.result == 6);
+      ASSERT_TRUE(strncmp(ring.buf + 100, "Juliet", 6) == 0);
+    }
+  }
+  ASSERT_TRUE(io_ring_peek(&ring, &cqe) == 0);
+
+  // Outside of the buffer area.
+  struct io_ring_sqe bad = {IO_BATCH_READ, fd, 4000, 100, 0, 3};
+  ASSERT_TRUE(io_ring_submit(&ring, &bad) == 0);
+  ASSERT_TRUE(io_ring_wait(&ring, 1) == 1);
+  ASSERT_TRUE(io_ring_peek(&ring, &cqe) == 1);
+  ASSERT_TRUE(cqe.user_data == 3 && cqe.result == -1);
+}
+
 void test_doomwad() {
   FILE* stream = fopen("/DOOM1.WAD", "r");
   fseek(stream, -4096, SEEK_END);
@@ -53,7 +213,13 @@ int main() {
   REGISTER_TEST(test_fgetc);
   REGISTER_TEST(test_fgets);
   REGISTER_TEST(test_ftell);
+  REGISTER_TEST(test_fread);
+  REGISTER_TEST(test_fwrite);
   REGISTER_TEST(test_filesize);
+  REGISTER_TEST(test_readv);
+  REGISTER_TEST(test_io_batch);
+  REGISTER_TEST(test_io_ring);
+  REGISTER_TEST(test_read_benchmark);
 
   test_doomwad();
   RunTest();
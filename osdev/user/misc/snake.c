@@ -23,6 +23,10 @@ struct Snake {
   struct Pos food;
 };
 
+// If the frame buffer is shared with the kernel, then it only needs to be
+// presented.
+bool is_shared_buffer = false;
+
 void Draw(struct Snake* snake, int* vm) {
   for (int i = 0; i < MAP_WIDTH * MAP_HEIGHT; i++) {
     vm[i] = 0;
@@ -54,7 +58,11 @@ void Draw(struct Snake* snake, int* vm) {
   binfo.buffer_width = MAP_WIDTH;
   binfo.buffer_height = MAP_HEIGHT;
 
-  screen(COPY_FRAME_BUFFER, vm, &binfo);
+  if (is_shared_buffer) {
+    screen(PRESENT_FRAME_BUFFER, NULL, NULL);
+  } else {
+    screen(COPY_FRAME_BUFFER, vm, &binfo);
+  }
 }
 
 bool MoveSnake(struct Snake* snake, enum Direction dir) {
@@ -123,7 +131,17 @@ bool MakeLonger(struct Snake* snake) {
 int main() {
   console(SET_NO_BUFFER | SET_NON_BLOCKING_IO);
 
-  int* vm = (int*)malloc(MAP_WIDTH * MAP_HEIGHT * sizeof(int));
+  struct FrameBufferInfo binfo;
+  binfo.screen_row = 10;
+  binfo.screen_col = 10;
+  binfo.buffer_width = MAP_WIDTH;
+  binfo.buffer_height = MAP_HEIGHT;
+
+  int* vm = (int*)(size_t)screen(MAP_FRAME_BUFFER, &binfo, NULL);
+  is_shared_buffer = (vm != NULL);
+  if (!is_shared_buffer) {
+    vm = (int*)malloc(MAP_WIDTH * MAP_HEIGHT * sizeof(int));
+  }
 
   struct Snake snake;
   snake.pos[0].row = 4;
@@ -1,5 +1,7 @@
 
 #include <printf.h>
+#include <stdint.h>
+#include <stdlib.h>
 #include <string.h>
 #include <syscall.h>
 
@@ -41,6 +43,78 @@ void test_memmove() {
   ASSERT_TRUE(memcmp(lhs, "defd", 4) == 0);
 }
 
+void test_memmove_large() {
+  // Overlaps in both directions with the sizes that take the vector loops.
+  char buf[300];
+  for (int i = 0; i < 300; i++) {
+    buf[i] = i;
+  }
+
+  ASSERT_TRUE(memmove(buf + 5, buf, 200) == buf + 5);
+  int moved = 1;
+  for (int i = 0; i < 200; i++) {
+    moved &= (buf[i + 5] == (char)i);
+  }
+  ASSERT_TRUE(moved);
+
+  ASSERT_TRUE(memmove(buf, buf + 5, 200) == buf);
+  moved = 1;
+  for (int i = 0; i < 200; i++) {
+    moved &= (buf[i] == (char)i);
+  }
+  ASSERT_TRUE(moved);
+}
+
+static uint64_t rdtsc() {
+  uint32_t lo, hi;
+  asm volatile("rdtsc" : "=a"(lo), "=d"(hi));
+  return ((uint64_t)hi << 32) | lo;
+}
+
+static void byte_copy(char* dest, const char* src, size_t count) {
+  while (count-- > 0) {
+    *dest++ = *src++;
+  }
+}
+
+void test_memcpy_benchmark() {
+  const size_t max_size = 1 << 20;
+  char* src = malloc(max_size);
+  char* dest = malloc(max_size);
+  memset(src, 'a', max_size);
+
+  size_t sizes[] = {64, 4096, max_size};
+  for (int i = 0; i < 3; i++) {
+    size_t size = sizes[i];
+
+    // Touch around 16 MB for each.
+    size_t num_iter = (1 << 24) / size;
+
+    uint64_t start = rdtsc();
+    for (size_t j = 0; j < num_iter; j++) {
+      memcpy(dest, src, size);
+    }
+    uint64_t copied = rdtsc();
+    for (size_t j = 0; j < num_iter; j++) {
+      memset(dest, j, size);
+    }
+    uint64_t set = rdtsc();
+    for (size_t j = 0; j < num_iter; j++) {
+      byte_copy(dest, src, size);
+    }
+    uint64_t byte_copied = rdtsc();
+
+    printf("%d bytes : memcpy %d memset %d byte loop %d cycles\n", (int)size,
+           (int)((copied - start) / num_iter), (int)((set - copied) / num_iter),
+           (int)((byte_copied - set) / num_iter));
+  }
+
+  ASSERT_TRUE(memcmp(dest, src, max_size) == 0);
+
+  free(src);
+  free(dest);
+}
+
 void test_strcmp() {
   char lhs[] = "abcdefg";
   char rhs[] = "abcdfg";
@@ -66,6 +140,12 @@ void test_strncmp() {
 void test_strlen() {
   ASSERT_TRUE(strlen("") == 0);
   ASSERT_TRUE(strlen("abc") == 3);
+
+  // Every alignment of the start and the end.
+  const char* s = "strlen reads 16 bytes at a time from here";
+  for (int i = 0; i < 41; i++) {
+    ASSERT_TRUE(strlen(s + i) == (size_t)(41 - i));
+  }
 }
 
 void test_strchr() {
@@ -122,6 +202,7 @@ int main() {
   REGISTER_TEST(test_memcmp);
   REGISTER_TEST(test_memcpy);
   REGISTER_TEST(test_memmove);
+  REGISTER_TEST(test_memmove_large);
   REGISTER_TEST(test_strcmp);
   REGISTER_TEST(test_strncmp);
   REGISTER_TEST(test_strlen);
@@ -129,6 +210,7 @@ int main() {
   REGISTER_TEST(test_strncasecmp);
   REGISTER_TEST(test_strdup);
   REGISTER_TEST(test_utf8_to_unicode);
+  REGISTER_TEST(test_memcpy_benchmark);
 
   RunTest();
 